@@ -0,0 +1,133 @@
+/*  Copyright 2008-2022 Carsten Elton Sorensen and contributors
+
+    This file is part of ASMotor.
+
+    ASMotor is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ASMotor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Microbenchmark for the ROM finalization kernels. Compares the checksum kernels in
+ * xlink/checksum.c and memset fills against plain byte loops on an 8 MiB image.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "checksum.h"
+
+#define IMAGE_SIZE (8u * 1024u * 1024u)
+#define REPEAT 50
+
+static volatile uint32_t g_sink;
+
+static uint32_t
+loopSumBytes(const uint8_t* data, size_t length) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < length; ++i)
+        sum += data[i];
+    return sum;
+}
+
+static uint16_t
+loopSumBigEndianWords(const uint8_t* data, size_t length) {
+    uint16_t sum = 0;
+    for (size_t i = 0; i + 1 < length; i += 2)
+        sum += (uint16_t) (data[i] << 8u | data[i + 1]);
+    return sum;
+}
+
+static void
+loopFill(uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; ++i)
+        data[i] = 0xFF;
+}
+
+static void
+report(const char* name, clock_t start) {
+    double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+    double megabytes = (double) IMAGE_SIZE * REPEAT / (1024.0 * 1024.0);
+
+    printf("%-24s %8.3f s %10.1f MiB/s\n", name, seconds, seconds > 0 ? megabytes / seconds : 0.0);
+}
+
+static bool
+verify(const uint8_t* data) {
+    // Include unaligned starts and lengths that leave a tail for the scalar loops
+    for (size_t offset = 0; offset < 4; ++offset) {
+        for (size_t length = IMAGE_SIZE - 64; length < IMAGE_SIZE - offset; length += 7) {
+            if (loopSumBytes(&data[offset], length) != checksum_SumBytes(&data[offset], length)
+            ||  loopSumBigEndianWords(&data[offset], length) != checksum_SumBigEndianWords(&data[offset], length)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int
+main(int argc, char* argv[]) {
+    uint8_t* image = malloc(IMAGE_SIZE);
+    if (image == NULL)
+        return EXIT_FAILURE;
+
+    uint32_t seed = 12345;
+    for (uint32_t i = 0; i < IMAGE_SIZE; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        image[i] = (uint8_t) (seed >> 16u);
+    }
+
+    if (!verify(image)) {
+        printf("Checksum kernels disagree with the reference loops\n");
+        return EXIT_FAILURE;
+    }
+
+    clock_t start = clock();
+    for (int i = 0; i < REPEAT; ++i)
+        g_sink += loopSumBytes(image, IMAGE_SIZE);
+    report("byte sum, loop", start);
+
+    start = clock();
+    for (int i = 0; i < REPEAT; ++i)
+        g_sink += checksum_SumBytes(image, IMAGE_SIZE);
+    report("byte sum, kernel", start);
+
+    start = clock();
+    for (int i = 0; i < REPEAT; ++i)
+        g_sink += loopSumBigEndianWords(image, IMAGE_SIZE);
+    report("word sum, loop", start);
+
+    start = clock();
+    for (int i = 0; i < REPEAT; ++i)
+        g_sink += checksum_SumBigEndianWords(image, IMAGE_SIZE);
+    report("word sum, kernel", start);
+
+    start = clock();
+    for (int i = 0; i < REPEAT; ++i) {
+        loopFill(image, IMAGE_SIZE);
+        g_sink += image[i];
+    }
+    report("fill, loop", start);
+
+    start = clock();
+    for (int i = 0; i < REPEAT; ++i) {
+        memset(image, 0xFF, IMAGE_SIZE);
+        g_sink += image[i];
+    }
+    report("fill, memset", start);
+
+    free(image);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,54 @@
+#!/bin/sh
+# Patch throughput benchmark for xlink.
+#
+# Generates a Game Boy program with many small sections referencing each other through
+# the common patch shapes (symbol, symbol+constant, PC relative, BANK and compound
+# expressions), assembles it once and links it a number of times, reporting patches/sec.
+# The time is the total link time reported by xlink -v.
+#
+# Usage: patches.sh [sections] [repeat]
+
+SECTIONS=${1:-4000}
+REPEAT=${2:-5}
+BIN=${BIN:-../build/cmake/release}
+WORK=${WORK:-patches.tmp}
+
+# Each section contributes this many patches, see the generator below
+PATCHES_PER_SECTION=7
+
+mkdir -p $WORK
+
+awk -v sections=$SECTIONS 'BEGIN {
+	for (i = 0; i < sections; ++i) {
+		j = (i * 7 + 3) % sections
+		printf "\tSECTION \"Section%d\",CODE\n", i
+		printf "Label%d::\n", i
+		printf "\tdw\tLabel%d\n", j
+		printf "\tdw\tLabel%d+2\n", j
+		printf "\tdw\tLabel%d-1\n", j
+		printf "\tjr\tLabel%d\n", i
+		printf "\tld\ta,BANK(Label%d)\n", j
+		printf "\tld\ta,(Label%d>>8)&$FF\n", j
+		printf "\tld\thl,(Label%d^$55AA)|1\n", j
+	}
+}' >$WORK/patches.asm
+
+$BIN/xasm/z80/motorz80 -mcg -o$WORK/patches.obj $WORK/patches.asm || exit 1
+
+PATCHES=$((SECTIONS * PATCHES_PER_SECTION * REPEAT))
+
+TOTAL_MS=0
+i=0
+while [ $i -lt $REPEAT ]; do
+	$BIN/xlink/xlink -cngb -fngb -v -o$WORK/patches.gb $WORK/patches.obj >$WORK/link.out || exit 1
+	TOTAL_MS=$(awk -v sum=$TOTAL_MS '$1 == "total" { sum += $2 } END { printf "%.3f", sum }' $WORK/link.out)
+	i=$((i + 1))
+done
+
+awk -v total=$TOTAL_MS -v patches=$PATCHES -v repeat=$REPEAT 'BEGIN {
+	seconds = total / 1000
+	printf "links: %d\n", repeat
+	printf "patches: %d\n", patches
+	printf "seconds: %.3f\n", seconds
+	printf "patches/sec: %.0f\n", patches / seconds
+}'
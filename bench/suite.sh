@@ -0,0 +1,151 @@
+#!/bin/sh
+# Assembler and linker benchmark suite.
+#
+# Generates synthetic workloads for every assembler backend - macro heavy, REPT heavy, label
+# dense and INCBIN heavy sources - and a link of many objects for the banked targets xlink has a
+# machine definition for. Each workload is run a number of times and one line is printed per
+# workload with the mean time, lines/sec, patches/sec and peak resident memory as reported by
+# the tools' own -p and -v options. The time is the total the tools report, so process startup is
+# not included and no timer is needed from the shell. The format is stable so results can be
+# compared across commits.
+#
+# Usage: suite.sh [scale] [repeat]
+
+SCALE=${1:-2000}
+REPEAT=${2:-5}
+BIN=${BIN:-../build/cmake/release}
+WORK=${WORK:-suite.tmp}
+
+# Backend name, assembler and assembler options
+BACKENDS="
+6502 xasm/6502/motor6502
+6809 xasm/6809/motor6809
+680x0 xasm/680x0/motor68k
+dcpu-16 xasm/dcpu-16/motordcpu16
+mips xasm/mips/motormips
+rc8 xasm/rc8/motorrc8
+schip xasm/schip/motorschip
+z80 xasm/z80/motorz80 -mcg
+"
+
+# Backend name and xlink options for the many objects link. Only banked targets are used, so the
+# link scales with SCALE without running out of space.
+LINKS="
+z80 -cngb -fngb
+"
+
+# Modules in the many objects link, each with SCALE / MODULES labels
+MODULES=$((SCALE / 50 > 2 ? SCALE / 50 : 2))
+
+mkdir -p $WORK
+BIN=$(cd $BIN && pwd)
+WORK=$(cd $WORK && pwd)
+
+dd if=/dev/zero of=$WORK/data.bin bs=1024 count=1 2>/dev/null
+
+generate() {
+	awk -v workload=$1 -v scale=$SCALE -v modules=$MODULES -v module=$2 'BEGIN {
+		if (workload == "macro") {
+			print "Emit:\tMACRO"
+			print "Label\\@:"
+			print "\t__DCW\t\\1,\\2"
+			print "\t__DCW\tLabel\\@+\\3"
+			print "\tENDM"
+			for (i = 0; i < scale; ++i) {
+				if (i % 256 == 0)
+					printf "\tSECTION \"Macro%d\",CODE\n", i
+				printf "\tEmit\t%d,%d*2,%d\n", i % 1000, i % 77, i % 3
+			}
+		} else if (workload == "rept") {
+			print "Count\tSET\t0"
+			for (i = 0; i < scale; i += 256) {
+				printf "\tSECTION \"Rept%d\",CODE\n", i
+				print "\tREPT\t16"
+				print "\tREPT\t16"
+				print "\t__DCW\tCount*3+1"
+				print "Count\tSET\tCount+1"
+				print "\tENDR"
+				print "\tENDR"
+			}
+		} else if (workload == "labels") {
+			for (i = 0; i < scale; ++i) {
+				if (i % 256 == 0)
+					printf "\tSECTION \"Labels%d\",CODE\n", i
+				printf "Label%d:\n", i
+				printf "\t__DCW\tLabel%d\n", (i * 7 + 3) % scale
+			}
+		} else if (workload == "incbin") {
+			for (i = 0; i < scale / 8; ++i) {
+				if (i % 2 == 0)
+					printf "\tSECTION \"Incbin%d\",CODE\n", i
+				print "\tINCBIN\t\"data.bin\""
+			}
+		} else if (workload == "module") {
+			labels = int(scale / modules)
+			next_module = (module + 1) % modules
+			for (i = 0; i < labels; ++i) {
+				printf "\tEXPORT\tModule%d_Label%d\n", module, i
+				printf "\tIMPORT\tModule%d_Label%d\n", next_module, i
+			}
+			printf "\tSECTION \"Module%d\",CODE\n", module
+			for (i = 0; i < labels; ++i) {
+				printf "Module%d_Label%d:\n", module, i
+				printf "\t__DCW\tModule%d_Label%d\n", next_module, i
+				printf "\t__DCW\tModule%d_Label%d+2\n", next_module, (i * 7 + 3) % labels
+			}
+		}
+	}'
+}
+
+# Prints the value preceding or following a word in the output of the last run
+statistic() {
+	awk -v pattern="$1" -v field=$2 '$0 ~ pattern { print $field; exit }' $WORK/run.out
+}
+
+# Runs a command REPEAT times in the work directory, keeping the output of the last run and
+# adding up the total milliseconds reported by each run
+run() {
+	TOTAL_MS=0
+	i=0
+	while [ $i -lt $REPEAT ]; do
+		(cd $WORK && "$@") >$WORK/run.out 2>&1 || { cat $WORK/run.out; exit 1; }
+		TOTAL_MS=$(awk -v sum=$TOTAL_MS '$1 == "total" { sum += $2 } END { printf "%.3f", sum }' $WORK/run.out)
+		i=$((i + 1))
+	done
+}
+
+report() {
+	awk -v name=$1 -v total=$TOTAL_MS -v repeat=$REPEAT -v lines=${2:--} -v patches=${3:--} -v peak=${4:--} 'BEGIN {
+		seconds = total / 1000 / repeat
+		printf "%-20s %10.4f %12s %12s %10s\n", name, seconds,
+			lines == "-" ? "-" : sprintf("%.0f", lines / seconds),
+			patches == "-" ? "-" : sprintf("%.0f", patches / seconds), peak
+	}'
+}
+
+printf "%-20s %10s %12s %12s %10s\n" benchmark seconds lines/sec patches/sec peakKiB
+
+echo "$BACKENDS" | while read BACKEND ASSEMBLER OPTIONS; do
+	[ -z "$BACKEND" ] && continue
+	for WORKLOAD in macro rept labels incbin; do
+		generate $WORKLOAD >$WORK/$WORKLOAD.asm
+		run $BIN/$ASSEMBLER $OPTIONS -p -o$WORKLOAD.obj $WORKLOAD.asm
+		report $BACKEND/$WORKLOAD "$(statistic ' lines, ' 1)" - "$(statistic '^Peak memory' 3)"
+	done
+done || exit 1
+
+echo "$LINKS" | while read BACKEND OPTIONS; do
+	[ -z "$BACKEND" ] && continue
+	ASSEMBLER=$(echo "$BACKENDS" | awk -v backend=$BACKEND '$1 == backend { print $2 }')
+	ASSEMBLER_OPTIONS=$(echo "$BACKENDS" | awk -v backend=$BACKEND '$1 == backend { print $3 }')
+	OBJECTS=
+	i=0
+	while [ $i -lt $MODULES ]; do
+		generate module $i >$WORK/module$i.asm
+		(cd $WORK && $BIN/$ASSEMBLER $ASSEMBLER_OPTIONS -omodule$i.obj module$i.asm) || exit 1
+		OBJECTS="$OBJECTS module$i.obj"
+		i=$((i + 1))
+	done
+	run $BIN/xlink/xlink $OPTIONS -v -olink.bin $OBJECTS
+	report $BACKEND/link - "$(statistic ' patches$' 7)" "$(statistic '^Peak memory' 3)"
+done || exit 1
@@ -0,0 +1,46 @@
+; Constant expressions in macros and REPT blocks are cached, but must be evaluated again when
+; the symbols they use change
+	SECTION	"Cache",HOME[$100]
+
+Scale	EQU	3
+Offset	SET	1
+
+Table:	MACRO
+	DB	\1*Scale+Offset,(\1+Offset)&$0F
+	ENDM
+
+	REPT	3
+	Table	2
+Offset	SET	Offset+4
+	ENDR
+
+	PURGE	Scale
+Scale	EQU	5
+	Table	2
+
+Entry:	MACRO
+	DB	DEF(Later),\1
+	dw	Here\@
+Here\@:
+	ENDM
+
+	Entry	1
+Later	EQU	7
+	Entry	Later
+
+Operand	EQUS	"Offset*2"
+	REPT	2
+	DB	Operand,Offset
+Offset	SET	Offset+1
+	ENDR
+
+	PURGE	Operand
+Operand	EQUS	"Offset-1"
+	REPT	2
+	DB	Operand
+	ENDR
+
+	REPT	4
+	DB	Scale*2+1,Operand
+Offset	SET	Offset+1
+	ENDR
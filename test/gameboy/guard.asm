@@ -0,0 +1,15 @@
+; A file whose include guard symbol is defined is not entered again
+Value	SET	$40
+	INCLUDE	"guard.inc"
+	SECTION	"Guard",HOME[$100]
+	INCLUDE	"guard.inc"
+	ld	a,Value
+	INCLUDE	"guard.inc"	; Comment
+	REPT	2
+	INCLUDE	"guard.inc"
+	nop
+	ENDR
+	PURGE	GUARD_INC
+	INCLUDE	"guard.inc"
+	ld	b,Value
+	WARN	"Line 15"
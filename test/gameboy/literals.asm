@@ -0,0 +1,12 @@
+; Code literals with identical contents share storage
+	SECTION	"Literals",HOME[$100]
+	ld	hl,{ DB "Hello",0 }
+	ld	de,{ DB "Hello",0 }
+	ld	bc,{ DB "World",0 }
+	call	{ ld a,1
+		  ret }
+	call	{ ld a,1
+		  ret }
+	call	{ ld a,2
+		  ret }
+	ld	hl,{ DB "Hel" }
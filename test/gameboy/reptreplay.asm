@@ -0,0 +1,62 @@
+; REPT blocks are replayed from recorded tokens after their first iteration, and constant
+; expressions in macros and REPT blocks are cached. The values must follow SET symbols.
+	SECTION	"Replay",CODE
+
+Count	SET	0
+	REPT	4
+	DB	Count,Count*2+1
+Count	SET	Count+1
+	ENDR
+
+Emit:	MACRO
+	DB	\1+Count,(\2)&$FF
+Count	SET	Count+\1
+	ENDM
+
+	REPT	3
+	Emit	1,Count*3
+	Emit	2,Count<<1
+	ENDR
+
+Outer	SET	0
+	REPT	2
+Inner	SET	0
+	REPT	3
+	DB	Outer*16+Inner
+Inner	SET	Inner+1
+	ENDR
+Outer	SET	Outer+1
+	ENDR
+
+Odd	SET	0
+	REPT	4
+	IF	Odd&1
+	DB	$F0+Odd
+	ELSE
+	DB	$E0+Odd
+	ENDC
+Odd	SET	Odd+1
+	ENDR
+
+Base	EQU	$10
+	REPT	2
+	DB	Base+1
+	ENDR
+	PURGE	Base
+Base	EQU	$20
+	REPT	2
+	DB	Base+1
+	ENDR
+
+Next	EQUS	"Count+1"
+	REPT	2
+	DB	Next
+Count	SET	Count+1
+	ENDR
+
+	REPT	3
+	PRINTV	Count
+	PRINTT	" \@\n"
+	REXIT
+	ENDR
+	PRINTT	"\n"
@@ -0,0 +1,6 @@
+; Code literals are numbered the same when assembled alone or in a batch
+	IMPORT	Print
+	SECTION	"Hello",HOME
+Hello::
+	ld	hl,{ DB "Hello",0 }
+	jp	Print
@@ -0,0 +1,6 @@
+; The second source file for batch1.asm
+	SECTION	"Print",HOME
+Print::
+	ld	de,{ DB "World",0 }
+	ld	a,[hl+]
+	ret
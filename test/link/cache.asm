@@ -0,0 +1,25 @@
+; Macros, REPT blocks and code literals that must assemble the same with the
+; object and expression caches
+Count	SET	0
+	INCLUDE	"cache.inc"
+	INCLUDE	"cache.inc"
+
+Scale	EQU	3
+
+	SECTION	"Cached",HOME
+Start::
+	Fill	$10,4
+	REPT	3
+	ld	hl,{ DB "Cached",Count }
+	ld	a,Scale*Count+1
+	call	Routine
+Count	SET	Count+1
+	ENDR
+	Fill	$20,2
+	ret
+
+Routine:
+	REPT	2
+	Fill	Scale*2,Count&3
+	ENDR
+	ret
@@ -0,0 +1,35 @@
+; Sections, symbols, patches and debug information for the object format round trip
+	SECTION	"Entry",HOME[$0]
+Entry::
+	jp	Start
+
+	SECTION	"Code",HOME
+Start::
+	ld	hl,Table
+	ld	de,Table+3
+	ld	bc,Table.End-Table
+	ld	a,Table&$FF
+	ld	a,Table.End>>8
+	ld	a,[Variable]
+	ld	[Variable+1],a
+	ld	a,BANK(Table)
+.loop	jr	.loop
+	call	Routine
+	ret
+
+	SECTION	"Table",DATA,ALIGN[$10]
+Table::
+	DB	-1,2,-3,4
+	DW	Start,Table-1,-1000
+	DW	(Routine-Start)/2
+.End
+
+	SECTION	"Routine",CODE
+Routine:
+	ld	b,(Table.End-Table)&$F
+	ld	c,Table>>4
+	ret
+
+	SECTION	"Variables",BSS
+Variable::
+	DS	2
@@ -0,0 +1,7 @@
+; A library member exporting an EQU symbol and a label
+	EXPORT	Answer
+Answer	EQU	42
+
+	SECTION	"AnswerTable",HOME
+AnswerTable::
+	DB	Answer
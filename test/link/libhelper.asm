@@ -0,0 +1,5 @@
+; A library member exporting a label
+	SECTION	"Helper",HOME
+Helper::
+	ld	a,1
+	ret
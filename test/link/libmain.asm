@@ -0,0 +1,7 @@
+; Imports symbols that are exported by library members
+	IMPORT	Helper,Answer
+	SECTION	"Main",HOME
+Start::
+	ld	a,Answer
+	call	Helper
+	ret
@@ -0,0 +1,5 @@
+; A library member exporting the same label as libhelper.asm
+	SECTION	"OtherHelper",HOME
+Helper::
+	ld	a,2
+	ret
@@ -0,0 +1,5 @@
+; A library member nothing imports
+	SECTION	"Unused",HOME
+Unused::
+	ld	a,3
+	ret
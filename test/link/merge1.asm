@@ -0,0 +1,24 @@
+; Identical MERGEABLE sections, code literals and code in two objects
+	IMPORT	Table2,Caller2,Greet
+	SECTION	"Main",HOME
+Start::
+	ld	hl,Table1
+	ld	de,Table2
+	ld	bc,{ DB "Hello",0 }
+	call	Caller1
+	call	Caller2
+	jp	Greet
+
+	SECTION	"Table1",HOME,MERGEABLE
+Table1:
+	DB	1,2,3,4
+
+	SECTION	"Caller1",HOME
+Caller1:
+	call	Helper1
+	ret
+
+	SECTION	"Helper1",HOME
+Helper1:
+	ld	a,[hl]
+	ret
@@ -0,0 +1,19 @@
+; The second object for merge1.asm
+	SECTION	"Table2",HOME,MERGEABLE
+Table2::
+	DB	1,2,3,4
+
+	SECTION	"Greet",HOME
+Greet::
+	ld	de,{ DB "Hello",0 }
+	ret
+
+	SECTION	"Caller2",HOME
+Caller2::
+	call	Helper2
+	ret
+
+	SECTION	"Helper2",HOME
+Helper2:
+	ld	a,[hl]
+	ret
@@ -0,0 +1,14 @@
+; A hole before a fixed section that only the larger section fits exactly
+	SECTION	"Fixed",HOME[$10]
+	DB	$FF
+
+	SECTION	"Small",HOME
+Small::
+	DB	1,2,3,4
+
+	SECTION	"Big",HOME
+Big::
+	DW	Small
+	REPT	14
+	DB	$BB
+	ENDR
@@ -0,0 +1,154 @@
+#!/bin/sh
+XASM=../../build/cmake/debug/xasm/z80/motorz80
+XLINK=../../build/cmake/debug/xlink/xlink
+XLIB=../../build/cmake/debug/xlib/xlib
+
+assemble() {
+	for i in $*; do
+		$XASM -mcg -o$i.obj $i.asm
+	done
+}
+
+phases() {
+	sed -n 's/^    \([a-z][a-z ]*[a-z]\)  *[0-9.]* ms$/\1/p'
+}
+
+dump() {
+	od -t x1 $1 | sed 's/  */ /g' | sed -e '$a\'
+}
+
+# Indexed libraries only link the members that export an imported symbol,
+# and only one member for each symbol
+library() {
+	assemble libmain libhelper libother libanswer libunused
+	$XLIB lib.xlb a libunused.obj libanswer.obj libhelper.obj
+	$XLIB lib.xlb l
+	$XLINK -cngbs -fbin -olib.bin -mlib.map libmain.obj lib.xlb
+	dump lib.bin
+	cat lib.map
+	$XLIB dup.xlb a libhelper.obj libother.obj libanswer.obj
+	$XLINK -cngbs -fbin -odup.bin -mdup.map libmain.obj dup.xlb
+	dump dup.bin
+	cat dup.map
+	$XLINK -cngbs -fbin -onested.bin libmain.obj nested.xlb0
+}
+
+# Best fit placement fills the hole before a fixed section with the larger
+# section, and the report lists the sections kept and stripped
+placement() {
+	assemble place
+	for i in first best; do
+		$XLINK -cngbs -fbin -p$i -oplace.bin -mplace.map -rplace.report place.obj
+		dump place.bin
+		cat place.map place.report
+	done
+	$XLINK -cngbs -fbin -sBig -oplace.bin -rplace.report place.obj
+	cat place.report
+}
+
+# The link cache skips the second link, and a changed object is linked
+# again
+linkcache() {
+	assemble libmain libhelper libanswer
+	for i in 1 2; do
+		$XLINK -cngbs -fbin -v -ilink.cache -olink.bin libmain.obj libhelper.obj libanswer.obj | phases
+		dump link.bin
+	done
+	$XASM -mcg -olibhelper.obj libother.asm
+	$XLINK -cngbs -fbin -v -ilink.cache -olink.bin libmain.obj libhelper.obj libanswer.obj | phases
+	dump link.bin
+}
+
+# Machine readable maps give bank usage, section placement and symbol sizes,
+# symbols of folded sections are given at the address they resolve to
+maps() {
+	assemble libmain libhelper libanswer libunused
+	$XLINK -cngbs -fbin -sStart -omaps.bin -mmaps.json libmain.obj libhelper.obj libanswer.obj libunused.obj
+	cat maps.json
+	$XLINK -cngbs -fbin -omaps.bin -mmaps.csv libmain.obj libhelper.obj libanswer.obj libunused.obj
+	cat maps.csv
+	assemble merge1 merge2
+	$XLINK -cngbs -fbin -d -omaps.bin -mmaps.json merge1.obj merge2.obj
+	cat maps.json
+}
+
+# Assembling several files at once gives the same objects as assembling
+# them one by one, and two sources may not share an output file
+batch() {
+	assemble batch1 batch2
+	mkdir batch
+	$XASM -mcg -obatch batch1.asm batch2.asm
+	cmp batch1.obj batch/batch1.obj
+	cmp batch2.obj batch/batch2.obj
+	$XASM -mcg -obatch batch1.asm batch1.asm
+	$XLINK -cngbs -fbin -obatch.bin batch/batch1.obj batch/batch2.obj
+	dump batch.bin
+}
+
+# Identical MERGEABLE sections and code literals from two objects are
+# placed once
+merge() {
+	assemble merge1 merge2
+	$XLINK -cngbs -fbin -omerge.bin -mmerge.map -rmerge.report merge1.obj merge2.obj
+	dump merge.bin
+	cat merge.map merge.report
+}
+
+# With -d, identical code is folded as well, including routines that only
+# call identical routines
+fold() {
+	assemble merge1 merge2
+	$XLINK -cngbs -fbin -d -ofold.bin -mfold.map -rfold.report merge1.obj merge2.obj
+	dump fold.bin
+	cat fold.map fold.report
+}
+
+# XOB v4, v5 and v6 objects of the same source with debug information link
+# to the same image
+formats() {
+	$XASM -mcg -g -oformat.xob6 format.asm
+	for i in 4 5 6; do
+		$XLINK -cngbs -fbin -oformat$i.bin -mformat$i.map format.xob$i
+	done
+	cmp format4.bin format5.bin
+	cmp format4.map format5.map
+	cmp format4.bin format6.bin
+	cmp format4.map format6.map
+	dump format4.bin
+	cat format4.map
+}
+
+# Macros, REPT blocks and includes assemble to the same object with the
+# object and expression caches, and the second assembly is restored from
+# the object cache
+cache() {
+	mkdir cache
+	for i in 1 2; do
+		$XASM -mcg -v -ccache -ocache.obj cache.asm | grep -v Success
+	done
+	$XASM -mcg -ouncached.obj cache.asm
+	cmp cache.obj uncached.obj
+	$XLINK -cngbs -fbin -ocache.bin cache.obj
+	dump cache.bin
+}
+
+test() {
+	echo Testing $1
+	$1 >$1.output 2>&1
+	rm -f format.xob6 *.obj *.xlb *.bin *.map *.json *.csv *.report *.cache 2>/dev/null
+	rm -rf batch cache 2>/dev/null
+	diff -Z $1.output $1.answer
+	if [ $? -eq 0 ]; then
+		rm $1.output
+	fi
+}
+
+test library
+test placement
+test linkcache
+test maps
+test batch
+test merge
+test fold
+test formats
+test cache
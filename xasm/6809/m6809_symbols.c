@@ -19,6 +19,8 @@
 #include "xasm.h"
 #include "symbol.h"
 
+#include "m6809_parse.h"
+
 static void
 createGroup(const char* name, EGroupType type) {
     string* nameStr = str_Create(name);
@@ -31,6 +33,9 @@ m6809_DefineSymbols(void) {
     createGroup("CODE", GROUP_TEXT);
     createGroup("DATA", GROUP_TEXT);
     createGroup("BSS", GROUP_BSS);
+
+    // The symbols are defined for every source file, which starts with an unknown direct page
+    g_dp_base = DP_BASE_UNKNOWN;
 }
 
 extern bool
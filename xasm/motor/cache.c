@@ -0,0 +1,346 @@
+/*  Copyright 2008-2022 Carsten Elton Sorensen and contributors
+
+    This file is part of ASMotor.
+
+    ASMotor is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ASMotor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The object cache is enabled with -c. Each entry is the output of assembling a source file,
+ * together with the files it depended on, so an unchanged source file is not assembled again.
+ *
+ * An entry's file name is the CRC32 of its key, the key is the assembler version, the command
+ * line options that affect the output and the source file name. An entry is used if its key
+ * is the same and all its dependencies are intact. A dependency with the same size and
+ * modification time as recorded is not read again, otherwise its CRC32 must match.
+ *
+ * Format:
+ *
+ * "XAC" BYTE Version (0)
+ * ASCIIZ  Key
+ * LONG    NumberOfDependencies   ; the main source file first
+ * REPT    NumberOfDependencies
+ *         ASCIIZ  FileName
+ *         LONG    Size
+ *         LONG    ModificationTime ; 0 if not known
+ *         LONG    CRC32
+ * ENDR
+ * LONG    ObjectSize
+ * REPT    ObjectSize
+ *         BYTE    Data
+ * ENDR
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+// From util
+#include "crc32.h"
+#include "file.h"
+#include "mem.h"
+#include "strbuf.h"
+#include "strcoll.h"
+
+// From xasm
+#include "xasm.h"
+#include "cache.h"
+#include "dependency.h"
+
+#define CACHE_VERSION 0
+
+typedef struct {
+	uint32_t size;
+	uint32_t modified;
+	uint32_t crc32;
+} SFileState;
+
+static string* g_directory = NULL;
+static string_buffer* g_options = NULL;
+static bool g_bypass = false;
+static time_t g_startTime = 0;
+
+
+static bool
+readFile(const char* fileName, uint8_t** data, size_t* size) {
+	FILE* fileHandle = fopen(fileName, "rb");
+	if (fileHandle == NULL)
+		return false;
+
+	*size = fsize(fileHandle);
+	*data = mem_Alloc(*size + 1);
+	bool result = fread(*data, 1, *size, fileHandle) == *size;
+	fclose(fileHandle);
+
+	if (!result)
+		mem_Free(*data);
+
+	return result;
+}
+
+static bool
+hashFile(const char* fileName, uint32_t* crc) {
+	uint8_t* data;
+	size_t size;
+	if (!readFile(fileName, &data, &size))
+		return false;
+
+	*crc = crc32(data, size);
+	mem_Free(data);
+
+	return true;
+}
+
+// The modification time of a file modified after the assembly started is not recorded, it could
+// be modified again within the same second
+static bool
+getFileState(const char* fileName, SFileState* state) {
+	struct stat status;
+	if (stat(fileName, &status) != 0)
+		return false;
+
+	state->size = (uint32_t) status.st_size;
+	state->modified = status.st_mtime < g_startTime ? (uint32_t) status.st_mtime : 0;
+
+	return hashFile(fileName, &state->crc32);
+}
+
+static bool
+fileIntact(const char* fileName, const SFileState* state) {
+	struct stat status;
+	if (stat(fileName, &status) != 0 || (uint32_t) status.st_size != state->size)
+		return false;
+
+	if (state->modified != 0 && (uint32_t) status.st_mtime == state->modified)
+		return true;
+
+	uint32_t crc;
+	return hashFile(fileName, &crc) && crc == state->crc32;
+}
+
+static string*
+createKey(string* sourcePath) {
+	string_buffer* buffer = strbuf_Create();
+	strbuf_AppendFormat(buffer, "ASMotor %s\n%s %s\n", ASMOTOR_VERSION, xasm_Configuration->executableName, xasm_Configuration->backendVersion);
+	if (g_options != NULL)
+		strbuf_AppendChars(buffer, g_options->data, g_options->size);
+	strbuf_AppendString(buffer, sourcePath);
+
+	string* key = strbuf_String(buffer);
+	strbuf_Free(buffer);
+
+	return key;
+}
+
+static string*
+entryFilename(string* key) {
+	return str_CreateFormat("%s/%08X.xac", str_String(g_directory), crc32((const uint8_t*) str_String(key), str_Length(key)));
+}
+
+static bool
+writeObject(string* outputFilename, const uint8_t* data, size_t size) {
+	FILE* fileHandle = fopen(str_String(outputFilename), "wb");
+	if (fileHandle == NULL)
+		return false;
+
+	bool result = fwrite(data, 1, size, fileHandle) == size;
+	if (fclose(fileHandle) != 0 || !result) {
+		remove(str_String(outputFilename));
+		return false;
+	}
+
+	return true;
+}
+
+static bool
+readEntry(FILE* fileHandle, string* key, string* outputFilename) {
+	size_t fileSize = fsize(fileHandle);
+
+	char id[4];
+	if (fread(id, 1, sizeof(id), fileHandle) != sizeof(id) || memcmp(id, "XAC", 3) != 0 || id[3] != CACHE_VERSION)
+		return false;
+
+	string* entryKey = fgetstr(fileHandle);
+	bool sameKey = str_Equal(entryKey, key);
+	str_Free(entryKey);
+	if (!sameKey)
+		return false;
+
+	vec_t* dependencies = strvec_Create();
+	uint32_t totalDependencies = fgetll(fileHandle);
+	bool intact = totalDependencies != 0;
+	for (uint32_t i = 0; i < totalDependencies && intact; ++i) {
+		string* fileName = fgetstr(fileHandle);
+		SFileState state;
+		state.size = fgetll(fileHandle);
+		state.modified = fgetll(fileHandle);
+		state.crc32 = fgetll(fileHandle);
+
+		intact = !feof(fileHandle) && fileIntact(str_String(fileName), &state);
+		strvec_PushBack(dependencies, fileName);
+		str_Free(fileName);
+	}
+
+	if (intact) {
+		size_t objectSize = fgetll(fileHandle);
+		intact = objectSize <= fileSize;
+		if (intact) {
+			uint8_t* object = mem_Alloc(objectSize + 1);
+			intact = fread(object, 1, objectSize, fileHandle) == objectSize && writeObject(outputFilename, object, objectSize);
+			mem_Free(object);
+		}
+	}
+
+	if (intact) {
+		for (size_t i = 0; i < strvec_Count(dependencies); ++i)
+			dep_AddDependency(strvec_StringAt(dependencies, i));
+	}
+
+	strvec_Free(dependencies);
+	return intact;
+}
+
+static void
+collectDependency(string* fileName, intptr_t data) {
+	strvec_PushBack((vec_t*) data, fileName);
+}
+
+static bool
+writeEntry(FILE* fileHandle, string* key, const uint8_t* object, size_t objectSize) {
+	vec_t* dependencies = strvec_Create();
+	dep_ForEachDependency(collectDependency, (intptr_t) dependencies);
+
+	fwrite("XAC", 1, 3, fileHandle);
+	fputc(CACHE_VERSION, fileHandle);
+	fputsz(str_String(key), fileHandle);
+
+	bool result = strvec_Count(dependencies) != 0;
+	fputll((uint32_t) strvec_Count(dependencies), fileHandle);
+	for (size_t i = 0; i < strvec_Count(dependencies); ++i) {
+		const char* fileName = str_String(strvec_StringAt(dependencies, i));
+		SFileState state;
+		if (!getFileState(fileName, &state)) {
+			result = false;
+			break;
+		}
+
+		fputsz(fileName, fileHandle);
+		fputll(state.size, fileHandle);
+		fputll(state.modified, fileHandle);
+		fputll(state.crc32, fileHandle);
+	}
+
+	fputll((uint32_t) objectSize, fileHandle);
+	fwrite(object, 1, objectSize, fileHandle);
+
+	strvec_Free(dependencies);
+	return result && !ferror(fileHandle);
+}
+
+
+extern void
+cache_Open(const char* directory) {
+	str_Free(g_directory);
+
+	size_t length = strlen(directory);
+	while (length > 1 && (directory[length - 1] == '/' || directory[length - 1] == '\\'))
+		--length;
+
+	g_directory = str_CreateLength(directory, length);
+}
+
+extern void
+cache_Close(void) {
+	str_Free(g_directory);
+	if (g_options != NULL)
+		strbuf_Free(g_options);
+
+	g_directory = NULL;
+	g_options = NULL;
+}
+
+extern bool
+cache_Enabled(void) {
+	return g_directory != NULL;
+}
+
+extern void
+cache_AddOption(const char* option) {
+	if (g_options == NULL)
+		g_options = strbuf_Create();
+
+	strbuf_AppendFormat(g_options, "%s\n", option);
+}
+
+extern void
+cache_Bypass(void) {
+	g_bypass = true;
+}
+
+extern bool
+cache_Restore(string* sourcePath, string* outputFilename) {
+	g_bypass = false;
+	g_startTime = time(NULL);
+
+	if (g_directory == NULL || outputFilename == NULL)
+		return false;
+
+	string* key = createKey(sourcePath);
+	string* entryName = entryFilename(key);
+
+	bool restored = false;
+	FILE* fileHandle = fopen(str_String(entryName), "rb");
+	if (fileHandle != NULL) {
+		restored = readEntry(fileHandle, key, outputFilename);
+		fclose(fileHandle);
+	}
+
+	str_Free(entryName);
+	str_Free(key);
+
+	return restored;
+}
+
+extern void
+cache_Store(string* sourcePath, string* outputFilename) {
+	if (g_directory == NULL || g_bypass || xasm_TotalWarnings != 0)
+		return;
+
+	uint8_t* object;
+	size_t objectSize;
+	if (!readFile(str_String(outputFilename), &object, &objectSize))
+		return;
+
+	string* key = createKey(sourcePath);
+	string* entryName = entryFilename(key);
+	string* temporaryName = str_CreateFormat("%s.tmp", str_String(entryName));
+
+	// The entry is written to a temporary file first, so an interrupted write never leaves a damaged entry
+	FILE* fileHandle = fopen(str_String(temporaryName), "wb");
+	if (fileHandle != NULL) {
+		bool result = writeEntry(fileHandle, key, object, objectSize);
+		if (fclose(fileHandle) == 0 && result) {
+			remove(str_String(entryName));
+			rename(str_String(temporaryName), str_String(entryName));
+		} else {
+			remove(str_String(temporaryName));
+		}
+	}
+
+	str_Free(temporaryName);
+	str_Free(entryName);
+	str_Free(key);
+	mem_Free(object);
+}
@@ -0,0 +1,52 @@
+/*  Copyright 2008-2022 Carsten Elton Sorensen and contributors
+
+    This file is part of ASMotor.
+
+    ASMotor is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ASMotor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef XASM_MOTOR_CACHE_H_INCLUDED_
+#define XASM_MOTOR_CACHE_H_INCLUDED_
+
+#include "str.h"
+
+// Enables the object cache, entries are kept in directory
+extern void
+cache_Open(const char* directory);
+
+extern void
+cache_Close(void);
+
+extern bool
+cache_Enabled(void);
+
+// Adds a command line option that affects the output to the key of every entry, options may be
+// added before the cache is opened
+extern void
+cache_AddOption(const char* option);
+
+// Prevents the output of the current assembly from being stored, as it depends on more than its inputs
+extern void
+cache_Bypass(void);
+
+// Writes the output of a previous assembly of sourcePath with the same inputs to outputFilename,
+// and adds its dependencies. Returns false if there is no such entry.
+extern bool
+cache_Restore(string* sourcePath, string* outputFilename);
+
+// Stores outputFilename as the output of assembling sourcePath with the dependencies collected
+extern void
+cache_Store(string* sourcePath, string* outputFilename);
+
+#endif
@@ -29,6 +29,11 @@ static string* g_mainOutput = NULL;
 static string* g_mainDependency = NULL;
 static set_t * g_dependencySet = NULL;
 
+typedef struct {
+    void (*visit)(string* filename, intptr_t data);
+    intptr_t data;
+} SVisitor;
+
 
 /* Internal functions */
 
@@ -39,6 +44,14 @@ writeDependency(set_t* set, intptr_t element, intptr_t data) {
     fprintf(fileHandle, " %s", str_String(str));
 }
 
+static void
+visitDependency(set_t* set, intptr_t element, intptr_t data) {
+    SVisitor* visitor = (SVisitor*) data;
+    string* str = (string*) element;
+    if (!str_Equal(str, g_mainDependency))
+        visitor->visit(str, visitor->data);
+}
+
 static void
 writeTarget(set_t* set, intptr_t element, intptr_t data) {
     FILE* fileHandle = (FILE*) data;
@@ -51,7 +64,7 @@ writeTarget(set_t* set, intptr_t element, intptr_t data) {
 
 extern void
 dep_Initialize(const char* outputFileName) {
-    g_outputFilename = str_Create(outputFileName);
+    g_outputFilename = outputFileName != NULL ? str_Create(outputFileName) : NULL;
     g_dependencySet = strset_Create();
 }
 
@@ -62,6 +75,11 @@ dep_Exit(void) {
 	str_Free(g_mainDependency);
 	if (g_dependencySet != NULL)
 		strset_Free(g_dependencySet);
+
+	g_mainOutput = NULL;
+	g_outputFilename = NULL;
+	g_mainDependency = NULL;
+	g_dependencySet = NULL;
 }
 
 extern void
@@ -79,9 +97,18 @@ dep_AddDependency(string* filename) {
     }
 }
 
+extern void
+dep_ForEachDependency(void (*visit)(string* filename, intptr_t data), intptr_t data) {
+    if (g_dependencySet != NULL && g_mainDependency != NULL) {
+        SVisitor visitor = { visit, data };
+        visit(g_mainDependency, data);
+        set_ForEachElement(g_dependencySet, visitDependency, (intptr_t) &visitor);
+    }
+}
+
 extern void
 dep_WriteDependencyFile(void) {
-    if (g_dependencySet != NULL) {
+    if (g_dependencySet != NULL && g_outputFilename != NULL) {
         FILE* fileHandle = fopen(str_String(g_outputFilename), "wt");
         if (fileHandle != NULL) {
             fprintf(fileHandle, "%s:", str_String(g_mainOutput));
@@ -90,6 +117,7 @@ dep_WriteDependencyFile(void) {
             fprintf(fileHandle, "\n\n");
             strset_Remove(g_dependencySet, g_mainDependency);
             set_ForEachElement(g_dependencySet, writeTarget, (intptr_t) fileHandle);
+            fclose(fileHandle);
         }
     }
 }
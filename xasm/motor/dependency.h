@@ -19,6 +19,8 @@
 #ifndef XASM_MOTOR_DEPENDENCY_H_INCLUDED_
 #define XASM_MOTOR_DEPENDENCY_H_INCLUDED_
 
+// Starts collecting the files the assembly depends on. If outputFileName is NULL they are
+// collected but no dependency file is written.
 extern void
 dep_Initialize(const char* outputFileName);
 
@@ -31,6 +33,10 @@ dep_SetMainOutput(string* filename);
 extern void
 dep_AddDependency(string* filename);
 
+// Calls visit for every dependency, the main source file first
+extern void
+dep_ForEachDependency(void (*visit)(string* filename, intptr_t data), intptr_t data);
+
 extern void
 dep_WriteDependencyFile(void);
 
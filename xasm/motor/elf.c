@@ -516,7 +516,10 @@ elf_Write(const string* filename, bool bigEndian, EElfArch arch) {
 
 	fput_half = bigEndian ? fputbw : fputlw;
 	fput_word = bigEndian ? fputbl : fputll;
+	if (g_stringTable != NULL)
+		strbuf_Free(g_stringTable);
 	g_stringTable = strbuf_Create();
+	g_totalSectionHeaders = 0;
 	addStringChars("");
 	
 	addSectionHeaderZero();
@@ -32,6 +32,7 @@
 #include "patch.h"
 
 static string* g_lastErrorString = NULL;
+static jmp_buf* g_failureHandler = NULL;
 
 static char* g_warnings[] = {
     "Cannot \"PURGE\" undefined symbol",
@@ -43,6 +44,7 @@ static char* g_warnings[] = {
     "Not inside REPT block, ignored",
     "Error in machine option %s",
 	"Symbol has reserved name",
+	"Unable to write file \"%s\"",
 };
 
 static char* g_errors[] = {
@@ -103,14 +105,15 @@ static char* g_errors[] = {
     "Object file does not support expression",
     "Invalid MACRO argument",
     "Not a string member function returning int",
-    "Too many files specified on command line",
+    "[unused]",
     "Extended precision floating point not supported",
     "Unterminated IF block (started at %s:%d)",
     "SECTION already exists but it has a different combination of options",
     "Invalid SECTION options combination",
 	"GROUP symbol cannot be redefined",
 	"An ELF section cannot be loaded at 0",
-	"Invalid outside structure scope"
+	"Invalid outside structure scope",
+	"%s and %s would both be assembled to %s"
 };
 
 static const char*
@@ -317,6 +320,19 @@ err_SymbolError(const SSymbol* symbol, uint32_t n, ...) {
     return false;
 }
 
+static void
+fail(void) {
+    err_PrintAll();
+
+    if (g_failureHandler != NULL) {
+        while (g_suspendedErrors != NULL)
+            err_Discard();
+        longjmp(*g_failureHandler, 1);
+    }
+
+    exit(EXIT_FAILURE);
+}
+
 bool
 err_Fail(uint32_t n, ...) {
     va_list args;
@@ -325,8 +341,8 @@ err_Fail(uint32_t n, ...) {
     printError(NULL, NULL, 'F', n, &xasm_TotalErrors, args);
     va_end(args);
 
-    err_PrintAll();
-    exit(EXIT_FAILURE);
+    fail();
+    return false;
 }
 
 bool
@@ -337,8 +353,8 @@ err_PatchFail(const SPatch* patch, uint32_t n, ...) {
     printError(patch, NULL, 'F', n, &xasm_TotalErrors, args);
     va_end(args);
 
-    err_PrintAll();
-    exit(EXIT_FAILURE);
+    fail();
+    return false;
 }
 
 
@@ -347,6 +363,11 @@ err_Init(void) {
     initializeMessages(&g_allMessages);
 }
 
+void
+err_SetFailureHandler(jmp_buf* handler) {
+    g_failureHandler = handler;
+}
+
 
 void
 err_PrintAll(void) {
@@ -358,5 +379,7 @@ err_PrintAll(void) {
         }
     }
 	freeMessages(&g_allMessages);
+	initializeMessages(&g_allMessages);
 	str_Free(g_lastErrorString);
+	g_lastErrorString = NULL;
 }
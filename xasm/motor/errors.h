@@ -19,6 +19,8 @@
 #ifndef XASM_MOTOR_ERRORS_H_INCLUDED_
 #define XASM_MOTOR_ERRORS_H_INCLUDED_
 
+#include <setjmp.h>
+
 #include "patch.h"
 
 typedef enum {
@@ -31,6 +33,7 @@ typedef enum {
     WARN_REXIT_OUTSIDE_REPT,
     WARN_MACHINE_UNKNOWN_OPTION,
 	WARN_SYMBOL_WITH_RESERVED_NAME,
+	WARN_CANNOT_WRITE_FILE,
 
     ERROR_CHAR_EXPECTED = 100,
     ERROR_EXPRESSION_N_BIT,
@@ -89,14 +92,15 @@ typedef enum {
     ERROR_OBJECTFILE_PATCH,
     ERROR_INVALID_MACRO_ARGUMENT,
     ERROR_STRING_MEMBER_NOT_INT,
-    ERROR_TOO_MANY_FILES,
+    ERROR_unused_3,
     ERROR_EXTENDED_PRECISION_UNSUPPORTED,
 	ERROR_NEED_ENDC,
     ERROR_SECT_EXISTS_DIFFERENT_KIND,
     ERROR_SECT_FLAGS_COMBINATION,
 	ERROR_GROUP_REDEFINED,
 	ERROR_ELF_LOAD_ZERO,
-	ERROR_NOT_IN_STRUCTURE_SCOPE
+	ERROR_NOT_IN_STRUCTURE_SCOPE,
+	ERROR_SAME_OUTPUT_FILE
 } EError;
 
 extern bool
@@ -129,6 +133,10 @@ err_DiscardSuspended(void);
 extern void
 err_Init(void);
 
+// Fatal errors jump to handler instead of exiting the process, unless handler is NULL
+extern void
+err_SetFailureHandler(jmp_buf* handler);
+
 extern void
 err_PrintAll(void);
 
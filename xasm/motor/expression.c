@@ -31,10 +31,17 @@
 #include "section.h"
 #include "tokens.h"
 #include "errors.h"
+#include "profile.h"
 
 
 /* Internal functions */
 
+static SExpression*
+allocExpression(void) {
+    prof_Count(PROF_EXPRESSIONS);
+    return (SExpression*) mem_Alloc(sizeof(SExpression));
+}
+
 static bool
 getSymbolSectionOffset(const SExpression* expression, const SSection* section, uint32_t* resultOffset) {
     SSymbol* symbol = expression->value.symbol;
@@ -96,7 +103,7 @@ SExpression*                                      \
 expr_ ## NAME(SExpression* expr) {                \
     if (!assertExpression(expr))                  \
         return NULL;                              \
-    SExpression* r = (SExpression*) mem_Alloc(sizeof(SExpression)); \
+    SExpression* r = allocExpression();           \
     r->right = expr;                              \
     r->left = NULL;                               \
     r->value.integer = FUNC(expr->value.integer); \
@@ -149,7 +156,7 @@ mergeExpressions(SExpression* left, SExpression* right, EToken operation) {
     if (!assertExpressions(left, right))
         return NULL;
 
-    expr = (SExpression*) mem_Alloc(sizeof(SExpression));
+    expr = allocExpression();
 
     expr->isConstant = left->isConstant && right->isConstant;
     expr->left = left;
@@ -228,7 +235,7 @@ expr_Parens(SExpression* expression) {
     if (!assertExpression(expression))
         return NULL;
 
-    SExpression* r = (SExpression*) mem_Alloc(sizeof(SExpression));
+    SExpression* r = allocExpression();
     r->right = expression;
     r->left = NULL;
     r->value.integer = expression->value.integer;
@@ -250,7 +257,7 @@ expr_Bit(SExpression* right) {
         return NULL;
     }
 
-    SExpression* r = (SExpression*) mem_Alloc(sizeof(SExpression));
+    SExpression* r = allocExpression();
     r->right = right;
     r->left = NULL;
     r->value.integer = log2n(v);
@@ -274,7 +281,7 @@ expr_PcRelative(SExpression* expression, int adjustment) {
             expr_Const(adjustment - (sect_Current->cpuProgramCounter + sect_Current->cpuOrigin + sect_Current->cpuAdjust))
         );
     } else {
-        SExpression* r = (SExpression*) mem_Alloc(sizeof(SExpression));
+        SExpression* r = allocExpression();
 
         r->value.integer = 0;
         r->type = EXPR_PC_RELATIVE;
@@ -294,7 +301,7 @@ expr_Pc(void) {
 	if (symbol == NULL)
 		return NULL;
 
-    SExpression* r = (SExpression*) mem_Alloc(sizeof(SExpression));
+    SExpression* r = allocExpression();
 
     if (symbol->flags & SYMF_CONSTANT) {
         r->value.integer = symbol->value.integer;
@@ -315,7 +322,7 @@ expr_Pc(void) {
 
 SExpression*
 expr_Const(int32_t value) {
-    SExpression* r = (SExpression*) mem_Alloc(sizeof(SExpression));
+    SExpression* r = allocExpression();
     expr_SetConst(r, value);
 
     return r;
@@ -395,7 +402,7 @@ SExpression*
 expr_Bank(string* symbolName) {
     assert(xasm_Configuration->supportBanks);
 
-    SExpression* r = (SExpression*) mem_Alloc(sizeof(SExpression));
+    SExpression* r = allocExpression();
     r->right = NULL;
     r->left = NULL;
     r->value.symbol = sym_GetSymbol(symbolName);
@@ -412,7 +419,7 @@ expr_Symbol(SSymbol* symbol) {
         if (symbol->flags & SYMF_CONSTANT) {
             return expr_Const(sym_GetValue(symbol));
         } else {
-            SExpression* r = (SExpression*) mem_Alloc(sizeof(SExpression));
+            SExpression* r = allocExpression();
 
             r->right = NULL;
             r->left = NULL;
@@ -469,7 +476,7 @@ expr_Copy(SExpression* expression) {
     if (expression == NULL)
         return NULL;
 
-    SExpression* r = (SExpression*) mem_Alloc(sizeof(SExpression));
+    SExpression* r = allocExpression();
     r->isConstant = expression->isConstant;
     r->left = expr_Copy(expression->left);
     r->right = expr_Copy(expression->right);
@@ -546,7 +553,7 @@ expr_Clone(SExpression* expression) {
     if (expression == NULL)
         return NULL;
 
-    SExpression* result = (SExpression *) mem_Alloc(sizeof(SExpression));
+    SExpression* result = allocExpression();
     result->isConstant = expression->isConstant;
     result->operation = expression->operation;
     result->type = expression->type;
@@ -35,9 +35,19 @@
 #include "lexer.h"
 #include "lexer_constants.h"
 #include "lexer_context.h"
+#include "lexer_recording.h"
+#include "profile.h"
 #include "symbol.h"
 
 
+/* Internal variables */
+
+uint32_t lex_UnputStrings = 0;
+
+// Cleared when the token just lexed depends on more than the characters it was lexed from
+static bool g_tokenRecordable;
+
+
 /* Private functions */
 
 INLINE char
@@ -92,6 +102,7 @@ acceptQuotedStringUntil(char terminator) {
 				break;
 			}
 			case '\n':
+				g_tokenRecordable = false;
 				err_Error(ERROR_STRING_TERM);
 				return false;
 			default:
@@ -181,6 +192,7 @@ static bool
 verifyLocalLabel(void) {
 	for (size_t i = 0; i < lex_Context->token.length; ++i) {
 		if (!isdigit(lex_Context->token.value.string[i])) {
+			g_tokenRecordable = false;
 			return err_Error(ERROR_ID_MALFORMED);
 		}
 	}
@@ -227,6 +239,7 @@ acceptLabel(EToken token) {
 			ch = lex_GetChar();
 			if (ch == '#') {
 				// unput string symbol value, if found
+				g_tokenRecordable = false;
 				string* name = lex_TokenString();
 				str_Free(name);
 				string* value = sym_GetStringSymbolValueByName(name);
@@ -561,20 +574,6 @@ stateMacroArguments() {
 }
 
 
-static bool
-skipToNextLine(void) {
-	char ch = lex_GetChar();
-
-	if (ch == 0)
-		return false;
-
-	while (!isLineEnd(ch) && ch != 0) {
-		ch = lex_GetChar();
-	}
-
-	return true;
-}
-
 static bool
 skipToNextLineIndexed(size_t* index) {
 	for (;;) {
@@ -585,28 +584,12 @@ skipToNextLineIndexed(size_t* index) {
 	}
 }
 
-static bool
-charIs(char* candidates) {
-	char ch = lex_GetChar();
-	lex_UnputChar(ch);
-	return ch != 0 && strchr(candidates, ch) != NULL;
-}
-
 static bool
 charIsIndexed(size_t* index, char* candidates) {
 	char ch = getUnexpandedChar(*index);
 	return ch != 0 && strchr(candidates, ch) != NULL;
 }
 
-static void
-skipLabel(void) {
-	char ch = lex_GetChar();
-	while (strchr(" \t\n",ch) == NULL && ch != 0) {
-		ch = lex_GetChar();
-	}
-	lex_UnputChar(ch);
-}
-
 static void
 skipLabelIndexed(size_t* index) {
 	for (;;) {
@@ -618,31 +601,158 @@ skipLabelIndexed(size_t* index) {
 }
 
 static bool
-skipWhiteSpace(void) {
-	char ch = lex_GetChar();
+skipWhiteSpaceIndexed(size_t* index) {
+	char ch = getUnexpandedChar(*index);
 	while (ch != 0 && strchr("\t ", ch) != NULL) {
-		ch = lex_GetChar();
+		*index += 1;
+		ch = getUnexpandedChar(*index);
 		if (ch == '*') {
 			return true;
 		}
 	}
-	if (ch == ';')
-		return true;
-	lex_UnputChar(ch);
+	return (ch == ';') || (ch == 0);
+}
+
+static const SLexConstantsWord
+g_blockDirectives[] = {
+	{"IF",    T_DIRECTIVE_IF},
+	{"IFC",   T_DIRECTIVE_IFC},
+	{"IFD",   T_DIRECTIVE_IFD},
+	{"IFNC",  T_DIRECTIVE_IFNC},
+	{"IFND",  T_DIRECTIVE_IFND},
+	{"IFNE",  T_DIRECTIVE_IF},
+	{"IFEQ",  T_DIRECTIVE_IFEQ},
+	{"IFGT",  T_DIRECTIVE_IFGT},
+	{"IFGE",  T_DIRECTIVE_IFGE},
+	{"IFLT",  T_DIRECTIVE_IFLT},
+	{"IFLE",  T_DIRECTIVE_IFLE},
+	{"ELSE",  T_DIRECTIVE_ELSE},
+	{"ENDC",  T_DIRECTIVE_ENDC},
+	{"MACRO", T_SYM_MACRO},
+	{"ENDM",  T_DIRECTIVE_ENDM},
+	{"REPT",  T_DIRECTIVE_REPT},
+	{"ENDR",  T_DIRECTIVE_ENDR},
+	{NULL, 0}
+};
+
+#define MAX_BLOCK_DIRECTIVE_LENGTH 5
+
+static bool
+matchBlockDirective(SLexerToken* token) {
+	for (const SLexConstantsWord* directive = g_blockDirectives; directive->name != NULL; ++directive) {
+		if (strlen(directive->name) == token->length
+		&&  _strnicmp(token->value.string, directive->name, token->length) == 0) {
+			token->id = directive->token;
+			return true;
+		}
+	}
 	return false;
 }
 
 static bool
-skipWhiteSpaceIndexed(size_t* index) {
-	char ch = getUnexpandedChar(*index);
-	while (ch != 0 && strchr("\t ", ch) != NULL) {
-		*index += 1;
-		ch = getUnexpandedChar(*index);
-		if (ch == '*') {
+nextBlockDirective(SLexerBuffer* buffer, SLexerToken* token, uint32_t* lineNumber) {
+	for (;;) {
+		if (!lexbuf_SkipUnexpandedLine(buffer))
+			return false;
+
+		*lineNumber += 1;
+
+		size_t index = 0;
+		char ch = lexbuf_GetUnexpandedChar(buffer, index);
+		if (ch == ';' || ch == '*')
+			continue;
+
+		while (ch != 0 && strchr(" \t\n", ch) == NULL)
+			ch = lexbuf_GetUnexpandedChar(buffer, ++index);
+
+		if (ch != ' ' && ch != '\t')
+			continue;
+
+		while (ch == ' ' || ch == '\t')
+			ch = lexbuf_GetUnexpandedChar(buffer, ++index);
+
+		if (ch == ';' || ch == '*')
+			continue;
+
+		size_t length = 0;
+		while (isalpha(ch) && length < MAX_BLOCK_DIRECTIVE_LENGTH) {
+			token->value.string[length++] = ch;
+			ch = lexbuf_GetUnexpandedChar(buffer, ++index);
+		}
+		token->value.string[length] = 0;
+		token->length = length;
+
+		if (!isalpha(ch) && matchBlockDirective(token)) {
+			lexbuf_SkipUnexpandedChars(buffer, index);
 			return true;
 		}
 	}
-	return (ch == ';') || (ch == 0);
+}
+
+// Skips to the directive ending a block the same way parse_block.c does, true if it is one of end1 and end2
+static bool
+skipBlockText(SLexerBuffer* buffer, SLexerToken* token, EToken end1, EToken end2) {
+	uint32_t lineNumber = 0;
+	while (nextBlockDirective(buffer, token, &lineNumber)) {
+		if (token->id == end1 || token->id == end2)
+			return true;
+
+		switch (token->id) {
+			case T_DIRECTIVE_IF:
+			case T_DIRECTIVE_IFC:
+			case T_DIRECTIVE_IFD:
+			case T_DIRECTIVE_IFEQ:
+			case T_DIRECTIVE_IFGE:
+			case T_DIRECTIVE_IFGT:
+			case T_DIRECTIVE_IFLE:
+			case T_DIRECTIVE_IFLT:
+			case T_DIRECTIVE_IFNC:
+			case T_DIRECTIVE_IFND:
+				if (!skipBlockText(buffer, token, T_DIRECTIVE_ENDC, T_DIRECTIVE_ENDC))
+					return false;
+				break;
+			case T_SYM_MACRO:
+				if (!skipBlockText(buffer, token, T_DIRECTIVE_ENDM, T_DIRECTIVE_ENDM))
+					return false;
+				break;
+			case T_DIRECTIVE_REPT:
+				if (!skipBlockText(buffer, token, T_DIRECTIVE_ENDR, T_DIRECTIVE_ENDR))
+					return false;
+				break;
+			default:
+				break;
+		}
+	}
+	return false;
+}
+
+static const char*
+skipBlanks(const char* text, const char* end) {
+	while (text < end && (*text == ' ' || *text == '\t'))
+		++text;
+	return text;
+}
+
+// Skips lines that are empty or only contain a comment, returns the start of the first other line
+static const char*
+skipEmptyLines(const char* text, const char* end) {
+	for (;;) {
+		const char* line = text;
+		text = skipBlanks(text, end);
+		if (text < end && (*text == ';' || *text == '*')) {
+			text = memchr(text, '\n', (size_t) (end - text));
+			if (text == NULL)
+				return end;
+		} else if (text == end || *text != '\n') {
+			return line;
+		}
+		++text;
+	}
+}
+
+static bool
+isGuardSymbolCharacter(char ch, bool first) {
+	return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_' || (!first && ch >= '0' && ch <= '9');
 }
 
 /*	Public functions */
@@ -664,6 +774,7 @@ lex_CopyUnexpandedContent(char* dest, size_t count) {
 
 void
 lex_Bookmark(SLexerContext* bookmark) {
+	prof_Count(PROF_BOOKMARKS);
 	lexctx_ShallowCopy(bookmark, lex_Context);
 }
 
@@ -679,6 +790,7 @@ lex_SkipBytes(size_t count) {
 
 void
 lex_UnputStringLength(const char* str, size_t length) {
+	++lex_UnputStrings;
 	str += length;
 	for (size_t i = 0; i < length; ++i) {
 		char ch = *(--str);
@@ -697,35 +809,68 @@ lex_SetMode(ELexerMode mode) {
 	lex_Context->mode = mode;
 }
 
-bool
-lex_Init(string* filename) {
+void
+lex_Init(void) {
 	lex_ConstantsInit();
+}
+
+bool
+lex_BeginFile(string* filename) {
 	return lexctx_ContextInit(filename);
 }
 
+void
+lex_EndFile(void) {
+	lexctx_Cleanup();
+}
+
 bool
 lex_GetNextDirective(void) {
-	for (;;) {
-		if (!skipToNextLine())
-			return false;
+	return nextBlockDirective(&lex_Context->buffer, &lex_Context->token, &lex_Context->lineNumber);
+}
 
-		lex_Context->lineNumber += 1;
-		if (charIs(";*"))
-			continue;
-		skipLabel();
-		if (skipWhiteSpace())
-			continue;
+string*
+lex_FindIncludeGuard(string* content) {
+	const char* text = str_String(content);
+	const char* end = text + str_Length(content);
 
-		lex_Context->token.length = 0;
-		char ch;
-		while (isalpha(ch = lex_GetChar())) {
-			lex_Context->token.value.string[lex_Context->token.length++] = ch;
-		}
-		lex_Context->token.value.string[lex_Context->token.length] = 0;
-		lex_UnputChar(ch);
-		if (lex_ConstantsMatchTokenString() != NULL)
-			return true;
+	const char* line = skipEmptyLines(text, end);
+	const char* directive = skipBlanks(line, end);
+	if (directive == line || end - directive < 5 || _strnicmp(directive, "IFND", 4) != 0 || (directive[4] != ' ' && directive[4] != '\t'))
+		return NULL;
+
+	const char* symbolStart = skipBlanks(directive + 4, end);
+	const char* symbolEnd = symbolStart;
+	while (symbolEnd < end && isGuardSymbolCharacter(*symbolEnd, symbolEnd == symbolStart))
+		++symbolEnd;
+
+	const char* lineEnd = skipBlanks(symbolEnd, end);
+	if (symbolEnd == symbolStart || (lineEnd < end && *lineEnd != '\n' && *lineEnd != ';' && *lineEnd != '*'))
+		return NULL;
+
+	SLexerBuffer buffer;
+	chstk_Init(&buffer.charStack);
+	buffer.text = content;
+	buffer.index = (size_t) (lineEnd - text);
+
+	SLexerToken token;
+	if (!skipBlockText(&buffer, &token, T_DIRECTIVE_ELSE, T_DIRECTIVE_ENDC) || token.id != T_DIRECTIVE_ENDC)
+		return NULL;
+
+	const char* rest = skipBlanks(text + buffer.index, end);
+	if (rest < end && *rest != '\n' && *rest != ';' && *rest != '*')
+		return NULL;
+
+	if (rest < end && *rest != '\n') {
+		rest = memchr(rest, '\n', (size_t) (end - rest));
+		if (rest == NULL)
+			rest = end;
 	}
+
+	if (skipEmptyLines(rest, end) != end)
+		return NULL;
+
+	return str_CreateLength(symbolStart, (size_t) (symbolEnd - symbolStart));
 }
 
 bool
@@ -752,10 +897,37 @@ lex_GetNextDirectiveUnexpanded(size_t* index) {
 	}
 }
 
-bool
-lex_GetNextToken(void) {
+static bool
+stateNormalRecorded(void) {
+	SLexerContext* context = lex_Context;
+	SLexerBuffer* buffer = &context->buffer;
+	if (chstk_Count(&buffer->charStack) != 0)
+		return stateNormal();
+
+	if (lexrec_Replay(context->block.repeat.recording, &context->token, &buffer->index, &context->atLineStart))
+		return true;
+
+	size_t start = buffer->index;
+	bool lineStart = context->atLineStart;
+
+	g_tokenRecordable = true;
+	bool result = stateNormal();
+
+	if (result && lex_Context == context && g_tokenRecordable && buffer->index > start
+	&&  memchr(str_String(buffer->text) + start, '\\', buffer->index - start) == NULL
+	&&  lexbuf_RewindUnputChars(buffer, start)) {
+		lexrec_Record(context->block.repeat.recording, start, lineStart, &context->token, buffer->index, context->atLineStart);
+	}
+
+	return result;
+}
+
+static bool
+getNextToken(void) {
 	switch (lex_Context->mode) {
 		case LEXER_MODE_NORMAL: {
+			if (lex_Context->type == CONTEXT_REPT)
+				return stateNormalRecorded();
 			return stateNormal();
 		}
 		case LEXER_MODE_MACRO_ARGUMENT0: {
@@ -774,6 +946,18 @@ lex_GetNextToken(void) {
 	return 0;
 }
 
+bool
+lex_GetNextToken(void) {
+	prof_Count(PROF_TOKENS);
+	if (!prof_Enabled)
+		return getNextToken();
+
+	EActivity previous = prof_Switch(PROF_LEX);
+	bool result = getNextToken();
+	prof_Switch(previous);
+	return result;
+}
+
 extern string*
 lex_TokenString(void) {
 	return str_CreateLength(lex_Context->token.value.string, lex_Context->token.length);
@@ -782,5 +966,5 @@ lex_TokenString(void) {
 extern void
 lex_Exit(void) {
 	lex_ConstantsExit();
-	lexctx_Cleanup();
+	lexctx_FreeFileCache();
 }
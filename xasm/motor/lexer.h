@@ -30,12 +30,22 @@
 #include "lexer_context.h"
 #include "tokens.h"
 
-extern bool
-lex_Init(string* filename);
+// Counts the strings unput, which is how symbol values are expanded into the text being lexed
+extern uint32_t lex_UnputStrings;
+
+// Initializes the keyword tables, which are kept for all source files assembled
+extern void
+lex_Init(void);
 
 extern void
 lex_Exit(void);
 
+extern bool
+lex_BeginFile(string* filename);
+
+extern void
+lex_EndFile(void);
+
 extern void
 lex_UnputChar(char ch);
 
@@ -60,6 +70,10 @@ lex_GetNextDirective(void);
 extern bool
 lex_GetNextDirectiveUnexpanded(size_t* index);
 
+// Returns the symbol guarding the file content if it is entirely enclosed in IFND symbol/ENDC, otherwise NULL
+extern string*
+lex_FindIncludeGuard(string* content);
+
 extern bool
 lex_GetNextToken(void);
 
@@ -17,18 +17,21 @@
 */
 
 #include <assert.h>
+#include <string.h>
 
 #include "str.h"
 
 #include "lexer_buffer.h"
 
 
+static uint32_t g_nextUniqueId = 0;
+
+
 // Private functions
 
 static string*
 createUniqueValue(void) {
-    static uint32_t runId = 0;
-    return str_CreateFormat("_%u", runId++);
+    return str_CreateFormat("_%u", g_nextUniqueId++);
 }
 
 
@@ -110,6 +113,11 @@ lexbuf_Init(SLexerBuffer* buffer, string* name, string* content, vec_t* argument
 }
 
 
+extern void
+lexbuf_ResetUniqueValues(void) {
+	g_nextUniqueId = 0;
+}
+
 extern void
 lexbuf_Destroy(SLexerBuffer* buffer) {
 	str_Free(buffer->name);
@@ -183,6 +191,47 @@ lexbuf_SkipUnexpandedChars(SLexerBuffer* buffer, size_t count) {
 }
 
 
+extern bool
+lexbuf_SkipUnexpandedLine(SLexerBuffer* buffer) {
+	bool consumed = false;
+
+	char ch;
+	while ((ch = chstk_Pop(&buffer->charStack)) != 0) {
+		if (ch == '\n')
+			return true;
+		consumed = true;
+	}
+
+	size_t length = str_Length(buffer->text);
+	if (buffer->index >= length)
+		return consumed;
+
+	const char* start = str_String(buffer->text) + buffer->index;
+	const char* lineFeed = memchr(start, '\n', length - buffer->index);
+	buffer->index = lineFeed != NULL ? (size_t) (lineFeed - str_String(buffer->text)) + 1 : length;
+
+	return true;
+}
+
+
+extern bool
+lexbuf_RewindUnputChars(SLexerBuffer* buffer, size_t start) {
+	size_t unput = chstk_Count(&buffer->charStack);
+	if (unput > buffer->index - start)
+		return false;
+
+	const char* text = str_String(buffer->text);
+	for (size_t i = 0; i < unput; ++i) {
+		if (chstk_PeekAt(&buffer->charStack, i) != text[buffer->index - unput + i])
+			return false;
+	}
+
+	chstk_Discard(&buffer->charStack, unput);
+	buffer->index -= unput;
+	return true;
+}
+
+
 extern void
 lexbuf_RenewUniqueValue(SLexerBuffer* buffer) {
 	str_Free(buffer->uniqueValue);
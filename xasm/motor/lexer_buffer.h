@@ -65,8 +65,21 @@ lexbuf_CopyUnexpandedContent(SLexerBuffer* fbuffer, char* dest, size_t count);
 extern size_t
 lexbuf_SkipUnexpandedChars(SLexerBuffer* fbuffer, size_t count);
 
+// Skips past the next line feed without expanding macro arguments. Returns false if nothing was left to skip
+extern bool
+lexbuf_SkipUnexpandedLine(SLexerBuffer* fbuffer);
+
+// The characters unput while lexing a token are usually the ones following it in the buffer. If so, and they are
+// at or after start, the buffer is rewound to before them, leaving the lexer in the same state. Returns false otherwise
+extern bool
+lexbuf_RewindUnputChars(SLexerBuffer* fbuffer, size_t start);
+
 extern void
 lexbuf_RenewUniqueValue(SLexerBuffer* fbuffer);
 
+// Restarts the values of \@, so a source file gets the same values whatever was assembled before it
+extern void
+lexbuf_ResetUniqueValues(void);
+
 
 #endif /* XASM_MOTOR_LEXERBUFFER_H_INCLUDED_ */
@@ -52,6 +52,7 @@ typedef struct ConstantWord {
 
 static SConstantWord* g_wordsHashTable[WORDS_HASH_SIZE];
 static size_t g_maxWordLength;
+static uint32_t g_generation;
 
 /* Private functions */
 
@@ -151,6 +152,12 @@ lex_ConstantsMatchTokenString(void) {
 }
 
 
+uint32_t
+lex_ConstantsGeneration(void) {
+	return g_generation;
+}
+
+
 void
 lex_PrintMaxTokensPerHash(void) {
 	int maxWithSameHash = 0;
@@ -183,6 +190,7 @@ lex_ConstantsUndefineWord(const char* name, uint32_t token) {
 		if (word->definition.token == token && strcmp(word->definition.name, name) == 0) {
 			list_Remove(*hashTableEntry, word);
 			mem_Free(word);
+			++g_generation;
 			return;
 		}
 	}
@@ -216,6 +224,7 @@ lex_ConstantsDefineWord(const char* name, uint32_t token) {
 
 	SConstantWord** hashTableEntry = &g_wordsHashTable[hashString(name)];
 	list_Insert(*hashTableEntry, pNew);
+	++g_generation;
 }
 
 void
@@ -50,6 +50,10 @@ lex_ConstantsMatchWord(void);
 extern const SLexConstantsWord*
 lex_ConstantsMatchTokenString(void);
 
+// Changes whenever a word is defined or undefined
+extern uint32_t
+lex_ConstantsGeneration(void);
+
 extern void
 lex_ConstantsInit(void);
 
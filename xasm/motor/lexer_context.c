@@ -33,8 +33,11 @@
 #include "dependency.h"
 #include "errors.h"
 #include "includes.h"
+#include "lexer.h"
 #include "lexer_buffer.h"
 #include "lexer_context.h"
+#include "lexer_recording.h"
+#include "profile.h"
 #include "symbol.h"
 #include "tokens.h"
 
@@ -46,6 +49,16 @@ SLexerContext* lex_Context;
 static vec_t* g_newMacroArguments;
 
 static map_t* g_fileNameMap = NULL;
+static uint32_t g_nextFileId = 0;
+
+// Canonicalized file contents, kept for all source files assembled by this process
+static map_t* g_fileContentCache = NULL;
+
+typedef struct {
+	string* content;
+	uint32_t crc32;
+	string* guardSymbol;
+} SFileContent;
 
 
 /* Private functions */
@@ -66,15 +79,13 @@ freeFileNameInfo(intptr_t userData, intptr_t element) {
 
 static SFileInfo*
 createFileInfo(string* fileName) {
-	static uint32_t nextFileId = 0;
-
 	intptr_t value;
 	if (strmap_Value(g_fileNameMap, fileName, &value)) {
 		return (SFileInfo*) value;
 	} else {
 		SFileInfo* entry = mem_Alloc(sizeof(SFileInfo));
 		entry->fileName = str_Copy(fileName);
-		entry->fileId = nextFileId++;
+		entry->fileId = g_nextFileId++;
 		entry->crc32 = 0;
 		strmap_Insert(g_fileNameMap, fileName, (intptr_t) entry);
 
@@ -82,6 +93,52 @@ createFileInfo(string* fileName) {
 	}
 }
 
+static void
+freeFileContent(intptr_t userData, intptr_t element) {
+	SFileContent* fileContent = (SFileContent*) element;
+	str_Free(fileContent->content);
+	str_Free(fileContent->guardSymbol);
+	mem_Free(fileContent);
+}
+
+static SFileContent*
+readFileContent(string* name) {
+	if (g_fileContentCache == NULL)
+		g_fileContentCache = strmap_Create(freeFileContent);
+
+	intptr_t value;
+	if (strmap_Value(g_fileContentCache, name, &value))
+		return (SFileContent*) value;
+
+	FILE* fileHandle = fopen(str_String(name), "rb");
+	if (fileHandle == NULL)
+		return NULL;
+
+	size_t size = fsize(fileHandle);
+	string* rawContent = str_ReadFile(fileHandle, size);
+	fclose(fileHandle);
+
+	SFileContent* fileContent = mem_Alloc(sizeof(SFileContent));
+	fileContent->content = str_CanonicalizeLineEndings(rawContent);
+	fileContent->crc32 = crc32((const uint8_t *) str_String(rawContent), size);
+	fileContent->guardSymbol = lex_FindIncludeGuard(fileContent->content);
+	str_Free(rawContent);
+
+	strmap_Insert(g_fileContentCache, name, (intptr_t) fileContent);
+	return fileContent;
+}
+
+// A file that has been included before, and whose include guard symbol is defined, would be skipped entirely
+static bool
+isGuardedFile(string* name) {
+	intptr_t value;
+	if (!strmap_Value(g_fileNameMap, name, &value) || !strmap_Value(g_fileContentCache, name, &value))
+		return false;
+
+	string* guardSymbol = ((SFileContent*) value)->guardSymbol;
+	return guardSymbol != NULL && sym_IsDefined(guardSymbol) && !sym_IsString(guardSymbol);
+}
+
 static void
 pushContext(SLexerContext* context) {
 	list_Insert(lex_Context, context);
@@ -292,15 +349,14 @@ lexctx_CreateMemoryContext(string* name, string* memory, vec_t* arguments) {
 }
 
 SLexerContext*
-lexctx_CreateFileContext(FILE* fileHandle, string* name) {
-	SLexerContext* ctx = createContext();
+lexctx_CreateFileContext(string* name) {
+	SFileContent* fileContent = readFileContent(name);
+	if (fileContent == NULL)
+		return NULL;
 
-	size_t size = fsize(fileHandle);
-	string* fileContent = str_ReadFile(fileHandle, size);
-	string* canonicalizedContent = str_CanonicalizeLineEndings(fileContent);
-	str_Free(fileContent);
+	SLexerContext* ctx = createContext();
 
-	lexbuf_Init(&ctx->buffer, name, canonicalizedContent, strvec_Create());
+	lexbuf_Init(&ctx->buffer, name, fileContent->content, strvec_Create());
 	ctx->type = CONTEXT_FILE;
 	ctx->atLineStart = true;
 	ctx->mode = LEXER_MODE_NORMAL;
@@ -308,33 +364,36 @@ lexctx_CreateFileContext(FILE* fileHandle, string* name) {
 	ctx->fileInfo = createFileInfo(name);
 
 	if (opt_Current->enableDebugInfo)
-		ctx->fileInfo->crc32 = crc32((const uint8_t *)str_String(fileContent), size);
-
-	str_Free(canonicalizedContent);
+		ctx->fileInfo->crc32 = fileContent->crc32;
 
 	return ctx;
 }
 
 
-extern void
+extern bool
 lexctx_ProcessIncludeFile(string* fileName) {
 	string* name = inc_FindFile(fileName);
-	FILE* fileHandle;
-	if (name != NULL && (fileHandle = fopen(str_String(name), "rb")) != NULL) {
-		SLexerContext* newContext = lexctx_CreateFileContext(fileHandle, name);
-		fclose(fileHandle);
+	SLexerContext* newContext;
+	bool entered = false;
+	if (name != NULL && isGuardedFile(name)) {
+		dep_AddDependency(name);
+	} else if (name != NULL && (newContext = lexctx_CreateFileContext(name)) != NULL) {
+		prof_Count(PROF_INCLUDES);
 
 		dep_AddDependency(newContext->buffer.name);
 		pushContext(newContext);
+		entered = true;
 	} else {
 		err_Fail(ERROR_NO_FILE);
 	}
 	str_Free(name);
+	return entered;
 }
 
 extern void
 lexctx_ProcessRepeatBlock(uint32_t count) {
 	SLexerContext* newContext = createContext();
+	prof_Count(PROF_REPT_BLOCKS);
 
 	lexctx_Copy(newContext, lex_Context);
 	lexbuf_RenewUniqueValue(&newContext->buffer);
@@ -342,6 +401,7 @@ lexctx_ProcessRepeatBlock(uint32_t count) {
 	newContext->mode = LEXER_MODE_NORMAL;
 	newContext->block.repeat.remaining = count - 1;
 	newContext->block.repeat.bookmark = lex_Context;
+	newContext->block.repeat.recording = lexrec_Get(newContext->buffer.text, newContext->buffer.index);
 
 	pushContext(newContext);
 }
@@ -351,6 +411,7 @@ lexctx_ProcessMacro(string* macroName) {
 	SSymbol* symbol = sym_GetSymbol(macroName);
 
 	if (symbol != NULL) {
+		prof_Count(PROF_MACRO_INVOCATIONS);
 		SLexerContext* newContext = lexctx_CreateMemoryContext(symbol->fileInfo->fileName, symbol->value.macro, g_newMacroArguments);
 
 		newContext->type = CONTEXT_MACRO;
@@ -376,6 +437,8 @@ lexctx_ContextInit(string* fileName) {
 	strvec_PushBack(g_newMacroArguments, NULL);
 
 	g_fileNameMap = strmap_Create(freeFileNameInfo);
+	g_nextFileId = 0;
+	lexbuf_ResetUniqueValues();
 	createFileInfo(fileName);
 	dep_AddDependency(fileName);
 
@@ -385,14 +448,10 @@ lexctx_ContextInit(string* fileName) {
 
 	string* name = inc_FindFile(fileName);
 	if (name != NULL) {
-		FILE* fileHandle = fopen(str_String(name), "rb");
-		if (fileHandle != NULL) {
-			lex_Context = lexctx_CreateFileContext(fileHandle, name);
-			str_Free(name);
-			fclose(fileHandle);
-			return true;
-		}
+		lex_Context = lexctx_CreateFileContext(name);
 		str_Free(name);
+		if (lex_Context != NULL)
+			return true;
 	}
 
 	err_Fail(ERROR_NO_FILE);
@@ -408,11 +467,24 @@ lexctx_Cleanup(void) {
 		ctx = next;
 	}
 
+	lex_Context = NULL;
+
+	lexrec_FreeAll();
+
 	if (g_fileNameMap != NULL)
 		strmap_Free(g_fileNameMap);
+	g_fileNameMap = NULL;
 
 	if (g_newMacroArguments != NULL)
 		strvec_Free(g_newMacroArguments);
+	g_newMacroArguments = NULL;
+}
+
+extern void
+lexctx_FreeFileCache(void) {
+	if (g_fileContentCache != NULL)
+		strmap_Free(g_fileContentCache);
+	g_fileContentCache = NULL;
 }
 
 extern SFileInfo*
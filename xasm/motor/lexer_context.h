@@ -72,6 +72,7 @@ typedef struct LexerContext {
         struct {
 			struct LexerContext* bookmark;
             uint32_t remaining;
+            struct TokenRecording* recording;
         } repeat;
         struct {
             struct Symbol* symbol;
@@ -94,7 +95,8 @@ lexctx_SetMacroArgument0(string* str);
 extern void
 lexctx_ProcessMacro(string* macroName);
 
-extern void
+// Returns false if the file was not entered, because its include guard symbol is already defined
+extern bool
 lexctx_ProcessIncludeFile(string* filename);
 
 extern void
@@ -112,6 +114,10 @@ lexctx_ContextInit(string* filename);
 extern void
 lexctx_Cleanup(void);
 
+// Frees the contents of all source files read, which are kept for the following assemblies
+extern void
+lexctx_FreeFileCache(void);
+
 extern string*
 lexctx_Dump(void);
 
@@ -134,7 +140,7 @@ extern SLexerContext*
 lexctx_CreateMemoryContext(string* name, string* content, vec_t* arguments);
 
 extern SLexerContext*
-lexctx_CreateFileContext(FILE* f, string* name);
+lexctx_CreateFileContext(string* name);
 
 void
 lexctx_Destroy(SLexerContext* context);
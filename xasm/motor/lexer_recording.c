@@ -0,0 +1,203 @@
+/*  Copyright 2008-2022 Carsten Elton Sorensen and contributors
+
+    This file is part of ASMotor.
+
+    ASMotor is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ASMotor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+// From util
+#include "lists.h"
+#include "mem.h"
+#include "str.h"
+
+// From xasm
+#include "lexer_constants.h"
+#include "lexer_recording.h"
+#include "options.h"
+
+
+/* Internal structures */
+
+typedef struct {
+	SLexerToken token;
+	size_t end;
+	bool lineStart;
+	bool atLineStart;
+} SRecordedToken;
+
+struct TokenRecording {
+	list_Data(struct TokenRecording);
+
+	string* text;
+	size_t start;
+
+	// What the lexer depended on when the tokens were recorded
+	uint32_t constantsGeneration;
+	uint8_t binaryLiteralCharacters[2];
+	uint8_t gameboyLiteralCharacters[4];
+
+	// For every character from start, the index + 1 of the token starting there, or 0
+	uint32_t* tokenAt;
+	size_t tokenAtCount;
+
+	SRecordedToken* tokens;
+	size_t totalTokens;
+	size_t allocatedTokens;
+};
+
+
+/* Internal variables */
+
+static STokenRecording* g_recordings = NULL;
+
+
+/* Private functions */
+
+static void
+copyToken(SLexerToken* dest, const SLexerToken* source) {
+	size_t length = source->length + 1;
+	if (length < sizeof(source->value.floating))
+		length = sizeof(source->value.floating);
+	if (length > sizeof(source->value))
+		length = sizeof(source->value);
+
+	dest->id = source->id;
+	dest->length = source->length;
+	memcpy(&dest->value, &source->value, length);
+}
+
+static void
+snapshotLexerState(STokenRecording* recording) {
+	recording->constantsGeneration = lex_ConstantsGeneration();
+	memcpy(recording->binaryLiteralCharacters, opt_Current->binaryLiteralCharacters, sizeof(recording->binaryLiteralCharacters));
+	memcpy(recording->gameboyLiteralCharacters, opt_Current->gameboyLiteralCharacters, sizeof(recording->gameboyLiteralCharacters));
+}
+
+// Keywords and options change how characters are lexed, the recorded tokens are discarded if they have changed
+static bool
+isLexerStateUnchanged(STokenRecording* recording) {
+	if (recording->constantsGeneration == lex_ConstantsGeneration()
+	&&  memcmp(recording->binaryLiteralCharacters, opt_Current->binaryLiteralCharacters, sizeof(recording->binaryLiteralCharacters)) == 0
+	&&  memcmp(recording->gameboyLiteralCharacters, opt_Current->gameboyLiteralCharacters, sizeof(recording->gameboyLiteralCharacters)) == 0) {
+		return true;
+	}
+
+	recording->totalTokens = 0;
+	memset(recording->tokenAt, 0, recording->tokenAtCount * sizeof(uint32_t));
+	snapshotLexerState(recording);
+	return false;
+}
+
+static void
+growTokenAt(STokenRecording* recording, size_t count) {
+	size_t newCount = recording->tokenAtCount * 2;
+	if (newCount < count)
+		newCount = count;
+
+	recording->tokenAt = mem_Realloc(recording->tokenAt, newCount * sizeof(uint32_t));
+	memset(recording->tokenAt + recording->tokenAtCount, 0, (newCount - recording->tokenAtCount) * sizeof(uint32_t));
+	recording->tokenAtCount = newCount;
+}
+
+static SRecordedToken*
+allocRecordedToken(STokenRecording* recording) {
+	if (recording->totalTokens == recording->allocatedTokens) {
+		recording->allocatedTokens = recording->allocatedTokens != 0 ? recording->allocatedTokens * 2 : 64;
+		recording->tokens = mem_Realloc(recording->tokens, recording->allocatedTokens * sizeof(SRecordedToken));
+	}
+	return &recording->tokens[recording->totalTokens++];
+}
+
+
+/* Public functions */
+
+extern STokenRecording*
+lexrec_Get(string* text, size_t start) {
+	for (STokenRecording* recording = g_recordings; recording != NULL; recording = list_GetNext(recording)) {
+		if (recording->text == text && recording->start == start)
+			return recording;
+	}
+
+	STokenRecording* recording = mem_Alloc(sizeof(STokenRecording));
+	list_Init(recording);
+	recording->text = str_Copy(text);
+	recording->start = start;
+	recording->tokenAt = NULL;
+	recording->tokenAtCount = 0;
+	recording->tokens = NULL;
+	recording->totalTokens = 0;
+	recording->allocatedTokens = 0;
+	snapshotLexerState(recording);
+
+	list_Insert(g_recordings, recording);
+	return recording;
+}
+
+extern bool
+lexrec_Replay(STokenRecording* recording, SLexerToken* token, size_t* index, bool* atLineStart) {
+	if (*index < recording->start || *index - recording->start >= recording->tokenAtCount || !isLexerStateUnchanged(recording))
+		return false;
+
+	uint32_t tokenIndex = recording->tokenAt[*index - recording->start];
+	if (tokenIndex == 0)
+		return false;
+
+	const SRecordedToken* recorded = &recording->tokens[tokenIndex - 1];
+	if (recorded->lineStart != *atLineStart)
+		return false;
+
+	copyToken(token, &recorded->token);
+	*index = recorded->end;
+	*atLineStart = recorded->atLineStart;
+	return true;
+}
+
+extern void
+lexrec_Record(STokenRecording* recording, size_t start, bool lineStart, const SLexerToken* token, size_t end, bool atLineStart) {
+	if (start < recording->start || !isLexerStateUnchanged(recording))
+		return;
+
+	size_t offset = start - recording->start;
+	if (offset >= recording->tokenAtCount)
+		growTokenAt(recording, offset + 1);
+
+	SRecordedToken* recorded;
+	if (recording->tokenAt[offset] != 0) {
+		recorded = &recording->tokens[recording->tokenAt[offset] - 1];
+	} else {
+		recorded = allocRecordedToken(recording);
+		recording->tokenAt[offset] = (uint32_t) recording->totalTokens;
+	}
+
+	copyToken(&recorded->token, token);
+	recorded->end = end;
+	recorded->lineStart = lineStart;
+	recorded->atLineStart = atLineStart;
+}
+
+extern void
+lexrec_FreeAll(void) {
+	STokenRecording* recording = g_recordings;
+	while (recording != NULL) {
+		STokenRecording* next = list_GetNext(recording);
+		str_Free(recording->text);
+		mem_Free(recording->tokenAt);
+		mem_Free(recording->tokens);
+		mem_Free(recording);
+		recording = next;
+	}
+	g_recordings = NULL;
+}
@@ -0,0 +1,46 @@
+/*  Copyright 2008-2022 Carsten Elton Sorensen and contributors
+
+    This file is part of ASMotor.
+
+    ASMotor is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ASMotor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef XASM_MOTOR_LEXER_RECORDING_H_INCLUDED_
+#define XASM_MOTOR_LEXER_RECORDING_H_INCLUDED_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "str.h"
+
+#include "lexer_context.h"
+
+// The tokens lexed from a REPT block, so later iterations need not lex the characters again
+typedef struct TokenRecording STokenRecording;
+
+// Returns the recording of the REPT block starting at index start in text, shared by all contexts repeating it
+extern STokenRecording*
+lexrec_Get(string* text, size_t start);
+
+// Replays the token lexed from index in a previous iteration, updating token, index and atLineStart. Returns false if there is none
+extern bool
+lexrec_Replay(STokenRecording* recording, SLexerToken* token, size_t* index, bool* atLineStart);
+
+extern void
+lexrec_Record(STokenRecording* recording, size_t start, bool lineStart, const SLexerToken* token, size_t end, bool atLineStart);
+
+extern void
+lexrec_FreeAll(void);
+
+#endif /* XASM_MOTOR_LEXER_RECORDING_H_INCLUDED_ */
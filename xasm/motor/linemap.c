@@ -21,8 +21,10 @@
 
 #include "lexer_context.h"
 #include "linemap.h"
+#include "options.h"
 
-#define INITIAL_ALLOCATION 32
+#define INITIAL_ALLOCATION 64
+#define MAX_ENTRY_SIZE 15
 
 
 /* Internal functions */
@@ -31,8 +33,12 @@ static SLineMapSection*
 createLineMapSection(SSection* section) {
     SLineMapSection* mapSection = mem_Alloc(sizeof(SLineMapSection));
     mapSection->totalEntries = 0;
-    mapSection->allocatedEntries = INITIAL_ALLOCATION;
-    mapSection->entries = mem_Alloc(INITIAL_ALLOCATION * sizeof(SLineMapEntry));
+    mapSection->size = 0;
+    mapSection->allocatedSize = INITIAL_ALLOCATION;
+    mapSection->data = mem_Alloc(INITIAL_ALLOCATION);
+    mapSection->fileInfo = NULL;
+    mapSection->lineNumber = 0;
+    mapSection->offset = 0;
 
     section->lineMap = mapSection;
 
@@ -51,35 +57,43 @@ findLineMapSection(SSection* section) {
 }
 
 
-static SLineMapEntry*
-allocLineMapEntry(SLineMapSection* file) {
-    if (file->totalEntries == file->allocatedEntries) {
-        file->allocatedEntries *= 2;
-        file->entries = (SLineMapEntry*) mem_Realloc(file->entries, file->allocatedEntries * sizeof(SLineMapEntry));
+static void
+writeUnsigned(SLineMapSection* sectionMap, uint64_t value) {
+    while (value >= 0x80) {
+        sectionMap->data[sectionMap->size++] = (uint8_t) (value | 0x80);
+        value >>= 7;
     }
-
-    return &file->entries[file->totalEntries++];
+    sectionMap->data[sectionMap->size++] = (uint8_t) value;
 }
 
 
-static SLineMapEntry*
-mostRecentLineMapEntry(SLineMapSection* sectionMap) {
-    if (sectionMap->totalEntries > 0)
-        return &sectionMap->entries[sectionMap->totalEntries - 1];
-    else
-        return NULL;
+static uint64_t
+zigZag(uint32_t from, uint32_t to) {
+    int64_t delta = (int64_t) to - (int64_t) from;
+    return delta < 0 ? ((uint64_t) -delta << 1) - 1 : (uint64_t) delta << 1;
 }
-    
+
 
 static void
 addEntry(SLineMapSection* sectionMap, SFileInfo* fileInfo, uint32_t lineNumber, uint32_t offset) {
-    SLineMapEntry* mostRecentEntry = mostRecentLineMapEntry(sectionMap);
-    if (mostRecentEntry == NULL || mostRecentEntry->fileInfo != fileInfo || mostRecentEntry->lineNumber != lineNumber) {
-        SLineMapEntry* entry = allocLineMapEntry(sectionMap);
-        entry->fileInfo = fileInfo;
-        entry->lineNumber = lineNumber;
-        entry->offset = offset;
+    if (sectionMap->totalEntries > 0 && sectionMap->fileInfo == fileInfo && sectionMap->lineNumber == lineNumber)
+        return;
+
+    if (sectionMap->size + MAX_ENTRY_SIZE > sectionMap->allocatedSize) {
+        sectionMap->allocatedSize *= 2;
+        sectionMap->data = mem_Realloc(sectionMap->data, sectionMap->allocatedSize);
     }
+
+    bool fileChanged = sectionMap->fileInfo != fileInfo;
+    writeUnsigned(sectionMap, zigZag(sectionMap->lineNumber, lineNumber) << 1 | (fileChanged ? 1 : 0));
+    if (fileChanged)
+        writeUnsigned(sectionMap, fileInfo->fileId);
+    writeUnsigned(sectionMap, zigZag(sectionMap->offset, offset));
+
+    sectionMap->fileInfo = fileInfo;
+    sectionMap->lineNumber = lineNumber;
+    sectionMap->offset = offset;
+    sectionMap->totalEntries += 1;
 }
 
 
@@ -93,12 +107,46 @@ linemap_Add(SFileInfo* fileInfo, uint32_t lineNumber, SSection* section, uint32_
 
 extern void
 linemap_AddCurrent(void) {
-    linemap_Add(lexctx_TokenFileInfo(), lexctx_TokenLineNumber(), sect_Current, sect_Current->cpuProgramCounter);
+    // Line mappings are only written to objects with debug information
+    if (opt_Current->enableDebugInfo)
+        linemap_Add(lexctx_TokenFileInfo(), lexctx_TokenLineNumber(), sect_Current, sect_Current->cpuProgramCounter);
+}
+
+
+extern void
+linemap_Mark(SSection* section, SLineMapMark* mark) {
+    SLineMapSection* lineMap = section->lineMap;
+    if (lineMap != NULL) {
+        mark->totalEntries = lineMap->totalEntries;
+        mark->size = lineMap->size;
+        mark->fileInfo = lineMap->fileInfo;
+        mark->lineNumber = lineMap->lineNumber;
+        mark->offset = lineMap->offset;
+    } else {
+        mark->totalEntries = 0;
+        mark->size = 0;
+        mark->fileInfo = NULL;
+        mark->lineNumber = 0;
+        mark->offset = 0;
+    }
+}
+
+
+extern void
+linemap_Restore(SSection* section, const SLineMapMark* mark) {
+    SLineMapSection* lineMap = section->lineMap;
+    if (lineMap != NULL) {
+        lineMap->totalEntries = mark->totalEntries;
+        lineMap->size = mark->size;
+        lineMap->fileInfo = mark->fileInfo;
+        lineMap->lineNumber = mark->lineNumber;
+        lineMap->offset = mark->offset;
+    }
 }
 
 
 extern void
 linemap_Free(SLineMapSection* linemap) {
-	mem_Free(linemap->entries);
+	mem_Free(linemap->data);
 	mem_Free(linemap);
 }
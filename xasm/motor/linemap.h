@@ -22,23 +22,37 @@
 #include "set.h"
 #include "str.h"
 
+#include "lexer_context.h"
 #include "section.h"
 
 
-struct LineMapEntry {
+/* The line mappings of a section, in the delta encoded form written to the object file. Each entry
+ * is an unsigned LEB128 number holding the zigzag encoded line number delta shifted left once, with
+ * bit 0 set if the file changed. The file id follows if it changed, then the zigzag encoded offset
+ * delta. Deltas are relative to the previous entry, the first to line 0 and offset 0.
+ */
+struct LineMapSection {
+    uint32_t totalEntries;
+    uint32_t size;
+    uint32_t allocatedSize;
+    uint8_t* data;
+
+    // The most recent entry
     SFileInfo* fileInfo;
     uint32_t lineNumber;
     uint32_t offset;
 };
-typedef struct LineMapEntry SLineMapEntry;
+typedef struct LineMapSection SLineMapSection;
 
 
-struct LineMapSection {
+// The state of a section's line mappings, entries added later can be removed again
+typedef struct {
     uint32_t totalEntries;
-    uint32_t allocatedEntries;
-    SLineMapEntry* entries;
-};
-typedef struct LineMapSection SLineMapSection;
+    uint32_t size;
+    SFileInfo* fileInfo;
+    uint32_t lineNumber;
+    uint32_t offset;
+} SLineMapMark;
 
 
 extern void
@@ -47,6 +61,12 @@ linemap_Add(SFileInfo* filename, uint32_t lineNumber, SSection* section, uint32_
 extern void
 linemap_AddCurrent(void);
 
+extern void
+linemap_Mark(SSection* section, SLineMapMark* mark);
+
+extern void
+linemap_Restore(SSection* section, const SLineMapMark* mark);
+
 extern void
 linemap_Free(SLineMapSection* linemap);
 
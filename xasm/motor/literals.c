@@ -0,0 +1,281 @@
+/*  Copyright 2008-2022 Carsten Elton Sorensen and contributors
+
+    This file is part of ASMotor.
+
+    ASMotor is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ASMotor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+// From util
+#include "crc32.h"
+#include "mem.h"
+#include "str.h"
+
+// From xasm
+#include "expression.h"
+#include "literals.h"
+#include "options.h"
+#include "patch.h"
+#include "xasm.h"
+
+#define LITERAL_HASH_SIZE 1024u
+
+
+/* Internal structures */
+
+typedef struct Literal {
+	struct Literal* next;
+
+	SSymbol* symbol;
+	SSection* section;
+	uint32_t offset;
+	uint32_t programCounter;
+	uint32_t size;
+	uint32_t hash;
+
+	// The literal's patches, ordered by offset
+	SPatch** patches;
+	uint32_t totalPatches;
+} SLiteral;
+
+
+/* Internal variables */
+
+static SLiteral* g_hashedLiterals[LITERAL_HASH_SIZE];
+static uint32_t g_nextLiteralId = 0;
+
+
+/* Exported variables */
+
+uint32_t lit_TotalLiterals = 0;
+uint32_t lit_SharedLiterals = 0;
+uint32_t lit_BytesSaved = 0;
+
+
+/* Private functions */
+
+static bool
+isPositionIndependent(const SExpression* expression) {
+	if (expression == NULL)
+		return true;
+
+	if (expr_Type(expression) == EXPR_PC_RELATIVE)
+		return false;
+
+	return isPositionIndependent(expression->left) && isPositionIndependent(expression->right);
+}
+
+static bool
+identicalExpressions(const SExpression* expression1, const SExpression* expression2) {
+	if (expression1 == NULL || expression2 == NULL)
+		return expression1 == expression2;
+
+	if (expression1->type != expression2->type || expression1->isConstant != expression2->isConstant)
+		return false;
+
+	switch (expr_Type(expression1)) {
+		case EXPR_INTEGER_CONSTANT: {
+			return expression1->value.integer == expression2->value.integer;
+		}
+		case EXPR_SYMBOL: {
+			return expression1->value.symbol == expression2->value.symbol;
+		}
+		case EXPR_OPERATION: {
+			if (expression1->operation != expression2->operation)
+				return false;
+
+			if (expression1->operation == T_FUNC_BANK && expression1->value.symbol != expression2->value.symbol)
+				return false;
+
+			break;
+		}
+		case EXPR_PARENS: {
+			break;
+		}
+		case EXPR_PC_RELATIVE: {
+			return false;
+		}
+	}
+
+	return identicalExpressions(expression1->left, expression2->left)
+		&& identicalExpressions(expression1->right, expression2->right);
+}
+
+// A literal can't be aligned more strictly than the section holding it, which is aligned by the backend's
+// section alignment or the one given by option -a
+static uint32_t
+maxLiteralAlignment(void) {
+	uint32_t alignment = xasm_Configuration->sectionAlignment;
+	if (opt_Current->sectionAlignment > 0 && (uint32_t) opt_Current->sectionAlignment > alignment)
+		alignment = (uint32_t) opt_Current->sectionAlignment;
+
+	return alignment == 0 ? 1 : alignment;
+}
+
+static uint32_t
+alignmentOf(uint32_t programCounter) {
+	uint32_t maxAlignment = maxLiteralAlignment();
+	uint32_t alignment = programCounter & -programCounter;
+	return alignment == 0 || alignment > maxAlignment ? maxAlignment : alignment;
+}
+
+static bool
+identicalLiterals(const SLiteral* literal1, const SLiteral* literal2) {
+	if (literal1->hash != literal2->hash
+	||  literal1->size != literal2->size
+	||  literal1->section != literal2->section
+	||  literal1->totalPatches != literal2->totalPatches
+	||  memcmp(literal1->section->data + literal1->offset, literal2->section->data + literal2->offset, literal1->size) != 0)
+		return false;
+
+	for (uint32_t i = 0; i < literal1->totalPatches; ++i) {
+		const SPatch* patch1 = literal1->patches[i];
+		const SPatch* patch2 = literal2->patches[i];
+
+		if (patch1->offset - literal1->offset != patch2->offset - literal2->offset
+		||  patch1->type != patch2->type
+		||  !identicalExpressions(patch1->expression, patch2->expression))
+			return false;
+	}
+
+	return true;
+}
+
+static SLiteral*
+findIdenticalLiteral(const SLiteral* literal) {
+	for (SLiteral* candidate = g_hashedLiterals[literal->hash % LITERAL_HASH_SIZE]; candidate != NULL; candidate = candidate->next) {
+		// An aligned literal may have asked for that alignment, so it may only share an earlier literal that is
+		// aligned at least as strictly
+		if (alignmentOf(candidate->programCounter) >= alignmentOf(literal->programCounter) && identicalLiterals(candidate, literal))
+			return candidate;
+	}
+
+	return NULL;
+}
+
+static bool
+collectPatches(SLiteral* literal) {
+	uint32_t allocatedPatches = 0;
+
+	for (SPatch* patch = literal->section->patches; patch != NULL; patch = list_GetNext(patch)) {
+		if (patch->offset < literal->offset)
+			continue;
+
+		if (!isPositionIndependent(patch->expression))
+			return false;
+
+		if (literal->totalPatches == allocatedPatches) {
+			allocatedPatches = allocatedPatches == 0 ? 4 : allocatedPatches * 2;
+			literal->patches = mem_Realloc(literal->patches, allocatedPatches * sizeof(SPatch*));
+		}
+
+		// Patches are not kept in offset order, insert sorted
+		uint32_t i = literal->totalPatches++;
+		while (i > 0 && literal->patches[i - 1]->offset > patch->offset) {
+			literal->patches[i] = literal->patches[i - 1];
+			--i;
+		}
+		literal->patches[i] = patch;
+	}
+
+	return true;
+}
+
+static void
+freeLiteral(SLiteral* literal) {
+	mem_Free(literal->patches);
+	mem_Free(literal);
+}
+
+
+/* Exported functions */
+
+extern void
+lit_Init(void) {
+	lit_TotalLiterals = 0;
+	lit_SharedLiterals = 0;
+	lit_BytesSaved = 0;
+	g_nextLiteralId = 0;
+}
+
+extern void
+lit_Exit(void) {
+	for (uint32_t i = 0; i < LITERAL_HASH_SIZE; ++i) {
+		SLiteral* literal = g_hashedLiterals[i];
+		while (literal != NULL) {
+			SLiteral* next = literal->next;
+			freeLiteral(literal);
+			literal = next;
+		}
+		g_hashedLiterals[i] = NULL;
+	}
+}
+
+extern string*
+lit_CreateName(void) {
+	return str_CreateFormat("__$Literal_%u", g_nextLiteralId++);
+}
+
+extern void
+lit_Begin(SLiteralStart* start) {
+	start->section = sect_Current;
+	start->offset = sect_Current->usedSpace;
+	start->programCounter = sect_Current->cpuProgramCounter;
+	start->totalLabels = sym_TotalLabels();
+	linemap_Mark(sect_Current, &start->lineMap);
+}
+
+extern SSymbol*
+lit_End(const SLiteralStart* start, SSymbol* symbol) {
+	++lit_TotalLiterals;
+
+	// Literals defining labels of their own, or leaving the section, are position dependent
+	SSection* section = start->section;
+	if (symbol == NULL || sect_Current != section || section->data == NULL
+	||  sym_TotalLabels() != start->totalLabels || section->usedSpace <= start->offset)
+		return symbol;
+
+	SLiteral* literal = mem_Alloc(sizeof(SLiteral));
+	memset(literal, 0, sizeof(SLiteral));
+
+	literal->symbol = symbol;
+	literal->section = section;
+	literal->offset = start->offset;
+	literal->programCounter = start->programCounter;
+	literal->size = section->usedSpace - start->offset;
+	literal->hash = crc32(section->data + start->offset, literal->size);
+
+	if (!collectPatches(literal)) {
+		freeLiteral(literal);
+		return symbol;
+	}
+
+	SLiteral* identical = findIdenticalLiteral(literal);
+	if (identical != NULL) {
+		++lit_SharedLiterals;
+		lit_BytesSaved += literal->size;
+
+		sect_Truncate(section, start->offset, start->programCounter);
+		linemap_Restore(section, &start->lineMap);
+		freeLiteral(literal);
+		return identical->symbol;
+	}
+
+	SLiteral** bucket = &g_hashedLiterals[literal->hash % LITERAL_HASH_SIZE];
+	literal->next = *bucket;
+	*bucket = literal;
+
+	return symbol;
+}
@@ -0,0 +1,57 @@
+/*  Copyright 2008-2022 Carsten Elton Sorensen and contributors
+
+    This file is part of ASMotor.
+
+    ASMotor is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ASMotor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef XASM_MOTOR_LITERALS_H_INCLUDED_
+#define XASM_MOTOR_LITERALS_H_INCLUDED_
+
+#include "linemap.h"
+#include "section.h"
+#include "symbol.h"
+
+// Where the contents of a { ... } literal begin
+typedef struct {
+	SSection* section;
+	uint32_t offset;
+	uint32_t programCounter;
+	uint32_t totalLabels;
+	SLineMapMark lineMap;
+} SLiteralStart;
+
+extern uint32_t lit_TotalLiterals;
+extern uint32_t lit_SharedLiterals;
+extern uint32_t lit_BytesSaved;
+
+extern void
+lit_Init(void);
+
+extern void
+lit_Exit(void);
+
+// Returns a new name for the label of a literal, unique in the current source file
+extern string*
+lit_CreateName(void);
+
+extern void
+lit_Begin(SLiteralStart* start);
+
+// Returns the label of an earlier literal with identical contents and patches, in which case the new contents are
+// removed from the section again. Otherwise the literal is remembered and its own label is returned.
+extern SSymbol*
+lit_End(const SLiteralStart* start, SSymbol* symbol);
+
+#endif /* XASM_MOTOR_LITERALS_H_INCLUDED_ */
@@ -16,11 +16,17 @@
 	along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-/*	char	ID[4]="XOB\3";
+/*	char	ID[4]="XOB\6";
  *	char	MinimumWordSize ; Used for address calculations.
  *							; 1 - A CPU address points to a byte in memory
  *							; 2 - A CPU address points to a 16 bit word in memory (CPU address 0x1000 is the 0x2000th byte)
  *							; 4 - A CPU address points to a 32 bit word in memory (CPU address 0x1000 is the 0x4000th byte)
+ *	IF Version >= 6
+ *		uint32_t NumberOfStrings
+ *		REPT NumberOfStrings
+ *			ASCIIZ		String
+ *		ENDR
+ *	ENDC
  *	IF Version >= 2
  *		uint32_t NumberOfFiles
  *		REPT NumberOfFiles
@@ -41,6 +47,7 @@
  *			int32_t	Position; -1 = not fixed
  *			[>=v1] int32_t BasePC	; -1 = not fixed
  *			[>=v3] int32_t ByteAlign ; -1 = not aligned
+ *			[>=v4] uint8_t Flags ; bit 0 = rooted, bit 1 = mergeable
  *			uint32_t	NumberOfSymbols
  *			REPT	NumberOfSymbols
  *					ASCIIZ	Name
@@ -53,7 +60,13 @@
  *						int32_t	value
  *					ENDC
  *			ENDR
- *          IF Version >= 2
+ *          IF Version >= 5
+ *				uint32_t	NumberOfLineMappings
+ *				IF NumberOfLineMappings != 0
+ *					uint32_t	LineMappingsSize
+ *					uint8_t		LineMappings[LineMappingsSize]	; see linemap.h
+ *				ENDC
+ *          ELIF Version >= 2
  *				uint32_t	NumberOfLineMappings
  *				REPT NumberOfLineMappings
  *					uint32_t	FileId
@@ -78,6 +91,11 @@
  *		REPT NumberOfFiles
  *			ASCIIZ		Name
  *			uint32_t	CRC32
+ *
+ * From version 6, integers are LEB128 encoded, int32_t fields as signed and the others as unsigned LEB128. Only
+ * CRC32 remains a 32 bit word. ASCIIZ names are stored as the unsigned LEB128 index of the name in the string table.
+ * In expressions, the operand of OBJ_CONSTANT is signed LEB128, the symbol id of OBJ_SYMBOL and OBJ_FUNC_BANK unsigned
+ * LEB128, and the operators 0x80-0xFF push the constants 0-127.
  */
 
 #include <assert.h>
@@ -87,6 +105,8 @@
 #include "util.h"
 #include "xasm.h"
 #include "file.h"
+#include "mem.h"
+#include "strbuf.h"
 
 #include "expression.h"
 #include "lexer_context.h"
@@ -98,33 +118,132 @@
 #include "tokens.h"
 
 
+#define STRING_HASH_SIZE 4096
+
+typedef struct StringId {
+	struct StringId* next;
+	string* name;
+	uint32_t id;
+} SStringId;
+
+static SStringId* g_hashedStrings[STRING_HASH_SIZE];
+static string_buffer* g_stringTable = NULL;
+static uint32_t g_totalStrings = 0;
+
+
 /* Private functions */
 
+static void
+putByte(string_buffer* buffer, uint8_t value) {
+	strbuf_AppendChar(buffer, (char) value);
+}
+
+static void
+putLong(string_buffer* buffer, uint32_t value) {
+	for (int i = 0; i < 4; ++i) {
+		putByte(buffer, (uint8_t) value);
+		value >>= 8u;
+	}
+}
+
+static void
+putUnsigned(string_buffer* buffer, uint32_t value) {
+	while (value >= 0x80) {
+		putByte(buffer, (uint8_t) (value | 0x80));
+		value >>= 7u;
+	}
+	putByte(buffer, (uint8_t) value);
+}
+
+static void
+putSigned(string_buffer* buffer, int32_t value) {
+	for (;;) {
+		uint8_t byte = (uint8_t) (value & 0x7F);
+		value = value < 0 ? ~(~value >> 7) : value >> 7;
+		if ((value == 0 && (byte & 0x40) == 0) || (value == -1 && (byte & 0x40) != 0)) {
+			putByte(buffer, byte);
+			return;
+		}
+		putByte(buffer, byte | 0x80);
+	}
+}
+
+// Names are written as an index into the string table, each name is only stored once
+static void
+putString(string_buffer* buffer, string* name) {
+	if (name == NULL) {
+		string* empty = str_Empty();
+		putString(buffer, empty);
+		str_Free(empty);
+		return;
+	}
+
+	SStringId** bucket = &g_hashedStrings[str_JenkinsHash(name) & (STRING_HASH_SIZE - 1)];
+	SStringId* entry = *bucket;
+	while (entry != NULL && !str_Equal(entry->name, name))
+		entry = entry->next;
+
+	if (entry == NULL) {
+		entry = mem_Alloc(sizeof(SStringId));
+		entry->next = *bucket;
+		entry->name = str_Copy(name);
+		entry->id = g_totalStrings++;
+		*bucket = entry;
+
+		strbuf_AppendChars(g_stringTable, str_String(name), str_Length(name) + 1);  // include terminating zero
+	}
+
+	putUnsigned(buffer, entry->id);
+}
+
+static void
+freeStrings(void) {
+	for (uint32_t i = 0; i < STRING_HASH_SIZE; ++i) {
+		SStringId* entry = g_hashedStrings[i];
+		while (entry != NULL) {
+			SStringId* next = entry->next;
+			str_Free(entry->name);
+			mem_Free(entry);
+			entry = next;
+		}
+		g_hashedStrings[i] = NULL;
+	}
+
+	strbuf_Free(g_stringTable);
+	g_stringTable = NULL;
+}
+
+static void
+appendBuffer(string_buffer* buffer, string_buffer* from) {
+	strbuf_AppendChars(buffer, from->data, from->size);
+	strbuf_Free(from);
+}
+
 static uint32_t
-writeSymbols(SSection* section, FILE* fileHandle, SExpression* expression, uint32_t nextId) {
+writeSymbols(SSection* section, string_buffer* buffer, SExpression* expression, uint32_t nextId) {
 	if (expression != NULL) {
-		nextId = writeSymbols(section, fileHandle, expression->left, nextId);
-		nextId = writeSymbols(section, fileHandle, expression->right, nextId);
+		nextId = writeSymbols(section, buffer, expression->left, nextId);
+		nextId = writeSymbols(section, buffer, expression->right, nextId);
 
 		if (expr_Type(expression) == EXPR_SYMBOL || (xasm_Configuration->supportBanks && expr_IsOperator(expression, T_FUNC_BANK))) {
 			if (expression->value.symbol->id == UINT32_MAX) {
 				expression->value.symbol->id = nextId++;
-				fputsz(str_String(expression->value.symbol->name), fileHandle);
+				putString(buffer, expression->value.symbol->name);
 				if (expression->value.symbol->section == section) {
 					if (expression->value.symbol->flags & SYMF_FILE_EXPORT) {
-						fputll(3, fileHandle);    //	LOCALEXPORT
-						fputll((uint32_t) expression->value.symbol->value.integer, fileHandle);
+						putUnsigned(buffer, 3);    //	LOCALEXPORT
+						putSigned(buffer, expression->value.symbol->value.integer);
 					} else if (expression->value.symbol->flags & SYMF_EXPORT) {
-						fputll(0, fileHandle);    //	EXPORT
-						fputll((uint32_t) expression->value.symbol->value.integer, fileHandle);
+						putUnsigned(buffer, 0);    //	EXPORT
+						putSigned(buffer, expression->value.symbol->value.integer);
 					} else {
-						fputll(2, fileHandle);    //	LOCAL
-						fputll((uint32_t) expression->value.symbol->value.integer, fileHandle);
+						putUnsigned(buffer, 2);    //	LOCAL
+						putSigned(buffer, expression->value.symbol->value.integer);
 					}
 				} else if (expression->value.symbol->type == SYM_IMPORT || expression->value.symbol->type == SYM_GLOBAL) {
-					fputll(1, fileHandle);    //	IMPORT
+					putUnsigned(buffer, 1);    //	IMPORT
 				} else {
-					fputll(4, fileHandle);    //	LOCALIMPORT
+					putUnsigned(buffer, 4);    //	LOCALIMPORT
 				}
 			}
 		}
@@ -133,7 +252,7 @@ writeSymbols(SSection* section, FILE* fileHandle, SExpression* expression, uint3
 }
 
 static uint32_t
-writeExportedSymbols(FILE* fileHandle, SSection* section, uint32_t symbolId) {
+writeExportedSymbols(string_buffer* buffer, SSection* section, uint32_t symbolId) {
 	for (uint_fast16_t i = 0; i < SYMBOL_HASH_SIZE; ++i) {
 		for (SSymbol* sym = sym_hashedSymbols[i]; sym; sym = list_GetNext(sym)) {
 			if (sym->type != SYM_GROUP)
@@ -142,12 +261,12 @@ writeExportedSymbols(FILE* fileHandle, SSection* section, uint32_t symbolId) {
 			if (sym->section == section && (sym->flags & (SYMF_EXPORT | SYMF_FILE_EXPORT))) {
 				sym->id = symbolId++;
 
-				fputsz(str_String(sym->name), fileHandle);
+				putString(buffer, sym->name);
 				if (sym->flags & SYMF_EXPORT)
-					fputll(0, fileHandle);    //	EXPORT
+					putUnsigned(buffer, 0);    //	EXPORT
 				else if (sym->flags & SYMF_FILE_EXPORT)
-					fputll(3, fileHandle);    //	LOCALEXPORT
-				fputll((uint32_t) sym->value.integer, fileHandle);
+					putUnsigned(buffer, 3);    //	LOCALEXPORT
+				putSigned(buffer, sym->value.integer);
 			}
 		}
 	}
@@ -180,14 +299,14 @@ markLocalExports(void) {
 }
 
 static void
-writeExpression(FILE* fileHandle, SExpression* expression) {
+writeExpression(string_buffer* buffer, SExpression* expression) {
 	if (expression != NULL) {
-		writeExpression(fileHandle, expression->left);
-		writeExpression(fileHandle, expression->right);
+		writeExpression(buffer, expression->left);
+		writeExpression(buffer, expression->right);
 
 		switch (expr_Type(expression)) {
 			case EXPR_PARENS: {
-				writeExpression(fileHandle, expression->right);
+				writeExpression(buffer, expression->right);
 				break;
 			}
 			case EXPR_OPERATION: {
@@ -196,120 +315,124 @@ writeExpression(FILE* fileHandle, SExpression* expression) {
 						internalerror("Unknown operator");
 						break;
 					case T_OP_SUBTRACT:
-						fputc(OBJ_OP_SUB, fileHandle);
+						putByte(buffer, OBJ_OP_SUB);
 						break;
 					case T_OP_ADD:
-						fputc(OBJ_OP_ADD, fileHandle);
+						putByte(buffer, OBJ_OP_ADD);
 						break;
 					case T_OP_BITWISE_XOR:
-						fputc(OBJ_OP_XOR, fileHandle);
+						putByte(buffer, OBJ_OP_XOR);
 						break;
 					case T_OP_BITWISE_OR:
-						fputc(OBJ_OP_OR, fileHandle);
+						putByte(buffer, OBJ_OP_OR);
 						break;
 					case T_OP_BITWISE_AND:
-						fputc(OBJ_OP_AND, fileHandle);
+						putByte(buffer, OBJ_OP_AND);
 						break;
 					case T_OP_BITWISE_ASL:
-						fputc(OBJ_OP_ASL, fileHandle);
+						putByte(buffer, OBJ_OP_ASL);
 						break;
 					case T_OP_BITWISE_ASR:
-						fputc(OBJ_OP_ASR, fileHandle);
+						putByte(buffer, OBJ_OP_ASR);
 						break;
 					case T_OP_MULTIPLY:
-						fputc(OBJ_OP_MUL, fileHandle);
+						putByte(buffer, OBJ_OP_MUL);
 						break;
 					case T_OP_DIVIDE:
-						fputc(OBJ_OP_DIV, fileHandle);
+						putByte(buffer, OBJ_OP_DIV);
 						break;
 					case T_OP_MODULO:
-						fputc(OBJ_OP_MOD, fileHandle);
+						putByte(buffer, OBJ_OP_MOD);
 						break;
 					case T_OP_BOOLEAN_OR:
-						fputc(OBJ_OP_BOOLEAN_OR, fileHandle);
+						putByte(buffer, OBJ_OP_BOOLEAN_OR);
 						break;
 					case T_OP_BOOLEAN_AND:
-						fputc(OBJ_OP_BOOLEAN_AND, fileHandle);
+						putByte(buffer, OBJ_OP_BOOLEAN_AND);
 						break;
 					case T_OP_BOOLEAN_NOT:
-						fputc(OBJ_OP_BOOLEAN_NOT, fileHandle);
+						putByte(buffer, OBJ_OP_BOOLEAN_NOT);
 						break;
 					case T_OP_GREATER_OR_EQUAL:
-						fputc(OBJ_OP_GREATER_OR_EQUAL, fileHandle);
+						putByte(buffer, OBJ_OP_GREATER_OR_EQUAL);
 						break;
 					case T_OP_GREATER_THAN:
-						fputc(OBJ_OP_GREATER_THAN, fileHandle);
+						putByte(buffer, OBJ_OP_GREATER_THAN);
 						break;
 					case T_OP_LESS_OR_EQUAL:
-						fputc(OBJ_OP_LESS_OR_EQUAL, fileHandle);
+						putByte(buffer, OBJ_OP_LESS_OR_EQUAL);
 						break;
 					case T_OP_LESS_THAN:
-						fputc(OBJ_OP_LESS_THAN, fileHandle);
+						putByte(buffer, OBJ_OP_LESS_THAN);
 						break;
 					case T_OP_EQUAL:
-						fputc(OBJ_OP_EQUALS, fileHandle);
+						putByte(buffer, OBJ_OP_EQUALS);
 						break;
 					case T_OP_NOT_EQUAL:
-						fputc(OBJ_OP_NOT_EQUALS, fileHandle);
+						putByte(buffer, OBJ_OP_NOT_EQUALS);
 						break;
 					case T_FUNC_LOWLIMIT:
-						fputc(OBJ_FUNC_LOW_LIMIT, fileHandle);
+						putByte(buffer, OBJ_FUNC_LOW_LIMIT);
 						break;
 					case T_FUNC_HIGHLIMIT:
-						fputc(OBJ_FUNC_HIGH_LIMIT, fileHandle);
+						putByte(buffer, OBJ_FUNC_HIGH_LIMIT);
 						break;
 					case T_OP_FDIV:
-						fputc(OBJ_FUNC_FDIV, fileHandle);
+						putByte(buffer, OBJ_FUNC_FDIV);
 						break;
 					case T_OP_FMUL:
-						fputc(OBJ_FUNC_FMUL, fileHandle);
+						putByte(buffer, OBJ_FUNC_FMUL);
 						break;
 					case T_FUNC_ATAN2:
-						fputc(OBJ_FUNC_ATAN2, fileHandle);
+						putByte(buffer, OBJ_FUNC_ATAN2);
 						break;
 					case T_FUNC_SIN:
-						fputc(OBJ_FUNC_SIN, fileHandle);
+						putByte(buffer, OBJ_FUNC_SIN);
 						break;
 					case T_FUNC_COS:
-						fputc(OBJ_FUNC_COS, fileHandle);
+						putByte(buffer, OBJ_FUNC_COS);
 						break;
 					case T_FUNC_TAN:
-						fputc(OBJ_FUNC_TAN, fileHandle);
+						putByte(buffer, OBJ_FUNC_TAN);
 						break;
 					case T_FUNC_ASIN:
-						fputc(OBJ_FUNC_ASIN, fileHandle);
+						putByte(buffer, OBJ_FUNC_ASIN);
 						break;
 					case T_FUNC_ACOS:
-						fputc(OBJ_FUNC_ACOS, fileHandle);
+						putByte(buffer, OBJ_FUNC_ACOS);
 						break;
 					case T_FUNC_ATAN:
-						fputc(OBJ_FUNC_ATAN, fileHandle);
+						putByte(buffer, OBJ_FUNC_ATAN);
 						break;
 					case T_FUNC_BANK: {
 						assert (xasm_Configuration->supportBanks);
-						fputc(OBJ_FUNC_BANK, fileHandle);
-						fputll(expression->value.symbol->id, fileHandle);
+						putByte(buffer, OBJ_FUNC_BANK);
+						putUnsigned(buffer, expression->value.symbol->id);
 						break;
 					}
 					case T_FUNC_ASSERT:
-						fputc(OBJ_FUNC_ASSERT, fileHandle);
+						putByte(buffer, OBJ_FUNC_ASSERT);
 						break;
 				}
 
 				break;
 			}
 			case EXPR_INTEGER_CONSTANT: {
-				fputc(OBJ_CONSTANT, fileHandle);
-				fputll((uint32_t) expression->value.integer, fileHandle);
+				if (expression->value.integer >= 0 && expression->value.integer < 0x80) {
+					putByte(buffer, OBJ_SMALL_CONSTANT | expression->value.integer);
+				} else {
+					putByte(buffer, OBJ_CONSTANT);
+					putSigned(buffer, expression->value.integer);
+				}
 				break;
 			}
 			case EXPR_SYMBOL: {
-				fputc(OBJ_SYMBOL, fileHandle);
-				fputll(expression->value.symbol->id, fileHandle);
+				putByte(buffer, OBJ_SYMBOL);
+				putUnsigned(buffer, expression->value.symbol->id);
 				break;
 			}
 			case EXPR_PC_RELATIVE: {
-				fputc(OBJ_PC_REL, fileHandle);
+				putByte(buffer, OBJ_PC_REL);
 				break;
 			}
 			default: {
@@ -321,163 +444,145 @@ writeExpression(FILE* fileHandle, SExpression* expression) {
 }
 
 static void
-writePatch(FILE* fileHandle, SPatch* patch) {
-	fputll(patch->offset, fileHandle);
-	fputll(patch->type, fileHandle);
-	off_t sizePosition = ftello(fileHandle);
-	fputll(0, fileHandle);
-
-	off_t expressionStart = ftello(fileHandle);
-	writeExpression(fileHandle, patch->expression);
-	off_t expressionEnd = ftell(fileHandle);
-
-	fseeko(fileHandle, sizePosition, SEEK_SET);
-	fputll((uint32_t) (expressionEnd - expressionStart), fileHandle);
-	fseeko(fileHandle, expressionEnd, SEEK_SET);
+writePatch(string_buffer* buffer, SPatch* patch) {
+	putUnsigned(buffer, patch->offset);
+	putUnsigned(buffer, patch->type);
+
+	string_buffer* expression = strbuf_Create();
+	writeExpression(expression, patch->expression);
+	putUnsigned(buffer, (uint32_t) expression->size);
+	appendBuffer(buffer, expression);
 }
 
 static void
-writeGroups(FILE* fileHandle) {
-	off_t sizePos = ftello(fileHandle);
-	fputll(0, fileHandle);
+writeGroups(string_buffer* buffer) {
+	string_buffer* groups = strbuf_Create();
 
 	uint32_t groupCount = 0;
 	for (uint_fast16_t i = 0; i < SYMBOL_HASH_SIZE; ++i) {
 		for (SSymbol* sym = sym_hashedSymbols[i]; sym != NULL; sym = list_GetNext(sym)) {
 			if (sym->type == SYM_GROUP) {
 				sym->id = groupCount++;
-				fputsz(str_String(sym->name), fileHandle);
-				fputll(sym->value.groupType | (sym->flags & (SYMF_SHARED | SYMF_DATA)), fileHandle);
+				putString(groups, sym->name);
+				putUnsigned(groups, sym->value.groupType | (sym->flags & (SYMF_SHARED | SYMF_DATA)));
 			}
 		}
 	}
 
-	fseeko(fileHandle, sizePos, SEEK_SET);
-	fputll(groupCount, fileHandle);
-
-	fseeko(fileHandle, 0, SEEK_END);
+	putUnsigned(buffer, groupCount);
+	appendBuffer(buffer, groups);
 }
 
 static void
-writeExportedConstantsSection(FILE* fileHandle) {
-	fputll(UINT32_MAX, fileHandle);  //	GroupID , -1 for EQU symbols
-	fputc(0, fileHandle);            //	Name
-	fputll(UINT32_MAX, fileHandle);  //	Bank
-	fputll(UINT32_MAX, fileHandle);  //	Org
-	fputll(UINT32_MAX, fileHandle);  //	BasePC
-	fputll(UINT32_MAX, fileHandle);  //	Align
-	fputc(0, fileHandle);            //	Root
-
-	off_t symbolCountPos = ftell(fileHandle);
-	fputll(0, fileHandle);        //	Number of symbols
+writeExportedConstantsSection(string_buffer* buffer) {
+	putSigned(buffer, -1);  //	GroupID , -1 for EQU symbols
+	putString(buffer, NULL);  //	Name
+	putSigned(buffer, -1);  //	Bank
+	putSigned(buffer, -1);  //	Org
+	putSigned(buffer, -1);  //	BasePC
+	putSigned(buffer, -1);  //	Align
+	putByte(buffer, 0);     //	Flags
+
+	string_buffer* symbols = strbuf_Create();
 	uint32_t integerExportCount = 0;
 
 	for (uint_fast16_t i = 0; i < SYMBOL_HASH_SIZE; ++i) {
 		for (SSymbol* sym = sym_hashedSymbols[i]; sym; sym = list_GetNext(sym)) {
 			if ((sym->type == SYM_EQU || sym->type == SYM_SET) && (sym->flags & SYMF_EXPORT)) {
 				++integerExportCount;
-				fputsz(str_String(sym->name), fileHandle);
-				fputll(0, fileHandle);    /* EXPORT */
-				fputll((uint32_t) sym->value.integer, fileHandle);
+				putString(symbols, sym->name);
+				putUnsigned(symbols, 0);    /* EXPORT */
+				putSigned(symbols, sym->value.integer);
 			}
 		}
 	}
 
-	fseeko(fileHandle, symbolCountPos, SEEK_SET);
-	fputll(integerExportCount, fileHandle);
-	fseeko(fileHandle, 0, SEEK_END);
+	putUnsigned(buffer, integerExportCount);
+	appendBuffer(buffer, symbols);
 
-	fputll(0, fileHandle); // Line mappings
+	putUnsigned(buffer, 0); // Line mappings
 
-	fputll(0, fileHandle); // Size
+	putUnsigned(buffer, 0); // Size
 }
 
 static void
-writeSectionSymbols(FILE* fileHandle, SSection* section) {
-	off_t symbolCountPosition = ftello(fileHandle);
-	fputll(0, fileHandle);
+writeSectionSymbols(string_buffer* buffer, SSection* section) {
+	string_buffer* symbols = strbuf_Create();
 
-	uint32_t symbolId = writeExportedSymbols(fileHandle, section, 0);
+	uint32_t symbolId = writeExportedSymbols(symbols, section, 0);
 
 	// Calculate and export symbols IDs by going through patches
 	for (SPatch* patch = section->patches; patch; patch = list_GetNext(patch)) {
 		if (patch->section == section) {
-			symbolId = writeSymbols(section, fileHandle, patch->expression, symbolId);
+			symbolId = writeSymbols(section, symbols, patch->expression, symbolId);
 		}
 	}
 
-	// Fix up number of symbols
-	fseeko(fileHandle, symbolCountPosition, SEEK_SET);
-	fputll(symbolId, fileHandle);
-	fseeko(fileHandle, 0, SEEK_END);
+	putUnsigned(buffer, symbolId);
+	appendBuffer(buffer, symbols);
 }
 
 static void
-writeSectionPatches(FILE* fileHandle, SSection* section) {
-	off_t patchCountPos = ftello(fileHandle);
-	fputll(0, fileHandle);
+writeSectionPatches(string_buffer* buffer, SSection* section) {
+	string_buffer* patches = strbuf_Create();
 
 	uint32_t totalPatches = 0;
 	for (SPatch* patch = section->patches; patch; patch = list_GetNext(patch)) {
 		if (patch->section == section) {
-			writePatch(fileHandle, patch);
+			writePatch(patches, patch);
 			totalPatches += 1;
 		}
 	}
 
-	fseeko(fileHandle, patchCountPos, SEEK_SET);
-	fputll(totalPatches, fileHandle);
-	fseeko(fileHandle, 0, SEEK_END);
+	putUnsigned(buffer, totalPatches);
+	appendBuffer(buffer, patches);
 }
 
 static void
-writeLineMappings(FILE* fileHandle, const SSection* section) {
+writeLineMappings(string_buffer* buffer, const SSection* section) {
+	// Line mappings are only recorded while debug information is enabled
 	if (opt_Current->enableDebugInfo && section->lineMap != NULL && section->lineMap->totalEntries != 0) {
-		fputll(section->lineMap->totalEntries, fileHandle);
-		for (uint32_t i = 0; i < section->lineMap->totalEntries; ++i) {
-			SLineMapEntry* entry = &section->lineMap->entries[i];
-			fputll(entry->fileInfo->fileId, fileHandle);
-			fputll(entry->lineNumber, fileHandle);
-			fputll(entry->offset, fileHandle);
-		}
+		putUnsigned(buffer, section->lineMap->totalEntries);
+		putUnsigned(buffer, section->lineMap->size);
+		strbuf_AppendChars(buffer, (const char*) section->lineMap->data, section->lineMap->size);
 	} else {
-		fputll(0, fileHandle);
+		putUnsigned(buffer, 0);
 	}
 }
 
 static void
-writeSection(FILE* fileHandle, SSection* section) {
-	fputll(section->group->id, fileHandle);
-	fputsz(str_String(section->name), fileHandle);
+writeSection(string_buffer* buffer, SSection* section) {
+	putSigned(buffer, (int32_t) section->group->id);
+	putString(buffer, section->name);
 	if (section->flags & SECTF_BANKFIXED) {
 		assert(xasm_Configuration->supportBanks);
-		fputll(section->bank, fileHandle);
+		putSigned(buffer, (int32_t) section->bank);
 	} else {
-		fputll(UINT32_MAX, fileHandle);
+		putSigned(buffer, -1);
 	}
 
-	fputll(section->flags & SECTF_LOADFIXED ? section->imagePosition : UINT32_MAX, fileHandle);
-	fputll(section->flags & SECTF_LOADFIXED ? section->cpuOrigin : UINT32_MAX, fileHandle);
-	fputll(section->flags & SECTF_ALIGNED ? section->align : UINT32_MAX, fileHandle);
-	fputc(section->flags & SECTF_ROOT ? 1 : 0, fileHandle);
+	putSigned(buffer, section->flags & SECTF_LOADFIXED ? (int32_t) section->imagePosition : -1);
+	putSigned(buffer, section->flags & SECTF_LOADFIXED ? (int32_t) section->cpuOrigin : -1);
+	putSigned(buffer, section->flags & SECTF_ALIGNED ? (int32_t) section->align : -1);
+	putByte(buffer, (section->flags & SECTF_ROOT ? 1 : 0) | (section->flags & SECTF_MERGEABLE ? 2 : 0));
 
-	writeSectionSymbols(fileHandle, section);
+	writeSectionSymbols(buffer, section);
 
-	writeLineMappings(fileHandle, section);
+	writeLineMappings(buffer, section);
 
-	fputll(section->usedSpace, fileHandle);
+	putUnsigned(buffer, section->usedSpace);
 	if (section->group->value.groupType == GROUP_TEXT) {
-		fwrite(section->data, 1, section->usedSpace, fileHandle);
-		writeSectionPatches(fileHandle, section);
+		strbuf_AppendChars(buffer, (const char*) section->data, section->usedSpace);
+		writeSectionPatches(buffer, section);
 	}
 }
 
 static void
-writeFileNames(FILE* fileHandle, SFileInfo** fileInfo, size_t fileCount) {
-	fputll((uint32_t) fileCount, fileHandle);
+writeFileNames(string_buffer* buffer, SFileInfo** fileInfo, size_t fileCount) {
+	putUnsigned(buffer, (uint32_t) fileCount);
 	for (uint32_t i = 0; i < fileCount; ++i) {
-		fputsz(str_String(fileInfo[i]->fileName), fileHandle);
-		fputll(fileInfo[i]->crc32, fileHandle);
+		putString(buffer, fileInfo[i]->fileName);
+		putLong(buffer, fileInfo[i]->crc32);
 	}
 }
 
@@ -490,35 +595,51 @@ obj_Write(string* fileName) {
 	if ((fileHandle = fopen(str_String(fileName), "wb")) == NULL)
 		return false;
 
-	fwrite("XOB\4", 1, 4, fileHandle);
-	fputc(xasm_Configuration->minimumWordSize, fileHandle);
+	g_stringTable = strbuf_Create();
+	g_totalStrings = 0;
+
+	string_buffer* buffer = strbuf_Create();
 
 	if (opt_Current->enableDebugInfo) {
 		size_t fileCount;
 		SFileInfo** fileInfo = lexctx_GetFileInfo(&fileCount);
-		writeFileNames(fileHandle, fileInfo, fileCount);
+		writeFileNames(buffer, fileInfo, fileCount);
 		mem_Free(fileInfo);
 	} else {
-		fputll(0, fileHandle);
+		putUnsigned(buffer, 0);
 	}
 
-	writeGroups(fileHandle);
+	writeGroups(buffer);
 
 	//	Output sections
 
 	uint32_t sectionCount = sect_TotalSections();
-	fputll(sectionCount + 1, fileHandle);
+	putUnsigned(buffer, sectionCount + 1);
 
-	writeExportedConstantsSection(fileHandle);
+	writeExportedConstantsSection(buffer);
 
 	markLocalExports();
 
 	uint32_t sectionId = 0;
 	for (SSection* section = sect_Sections; section; section = list_GetNext(section)) {
 		section->id = sectionId++;
-		writeSection(fileHandle, section);
+		writeSection(buffer, section);
 	}
 
+	// The string table precedes everything referring to it
+	string_buffer* header = strbuf_Create();
+	strbuf_AppendChars(header, "XOB\6", 4);
+	putByte(header, xasm_Configuration->minimumWordSize);
+	putUnsigned(header, g_totalStrings);
+
+	fwrite(header->data, 1, header->size, fileHandle);
+	fwrite(g_stringTable->data, 1, g_stringTable->size, fileHandle);
+	fwrite(buffer->data, 1, buffer->size, fileHandle);
+
+	strbuf_Free(header);
+	strbuf_Free(buffer);
+	freeStrings();
+
 	fclose(fileHandle);
 	return true;
 }
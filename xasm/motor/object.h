@@ -60,6 +60,8 @@ enum {
     OBJ_PC_REL,
     OBJ_FUNC_BANK,
     OBJ_FUNC_ASSERT,
+
+    OBJ_SMALL_CONSTANT = 0x80   // 0x80-0xFF push the constants 0-127, since version 6
 };
 
 #endif /* XASM_MOTOR_OBJECT_H_INCLUDED_ */
@@ -118,20 +118,31 @@ opt_Push(void) {
     list_Insert(opt_Current, nopt);
 }
 
+static void
+popOptions(void) {
+    SOptions* nopt = opt_Current;
+
+    list_Remove(opt_Current, opt_Current);
+    mem_Free(nopt->machineOptions);
+    mem_Free(nopt);
+}
+
 void
 opt_Pop(void) {
     if (!list_IsLast(opt_Current)) {
-        SOptions* nopt = opt_Current;
-
-        list_Remove(opt_Current, opt_Current);
-		mem_Free(nopt->machineOptions);
-        mem_Free(nopt);
+        popOptions();
         opt_Updated();
     } else {
         err_Warn(WARN_OPTION_POP);
     }
 }
 
+void
+opt_Restore(SOptions* options) {
+    while (opt_Current != options)
+        popOptions();
+}
+
 
 void
 opt_Parse(char* option) {
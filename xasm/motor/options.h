@@ -56,6 +56,10 @@ opt_Push(void);
 extern void
 opt_Pop(void);
 
+// Pops options until options is the current options, without calling opt_Updated
+extern void
+opt_Restore(SOptions* options);
+
 extern void
 opt_Parse(char* s);
 
@@ -29,6 +29,7 @@
 #include "parse_directive.h"
 #include "parse_string.h"
 #include "parse_symbol.h"
+#include "profile.h"
 #include "errors.h"
 #include "symbol.h"
 
@@ -106,6 +107,19 @@ handleLineBreak() {
 }
 
 
+static EActivity
+contextActivity(void) {
+    switch (lex_Context->type) {
+        case CONTEXT_MACRO:
+            return PROF_MACRO;
+        case CONTEXT_REPT:
+            return PROF_REPT;
+        default:
+            return PROF_PARSE;
+    }
+}
+
+
 /* Public functions */
 
 bool
@@ -159,6 +173,9 @@ parse_GetToken(void) {
 bool
 parse_Until(EToken endToken) {
     while (lex_Context->token.id) {
+        if (prof_Enabled)
+            prof_Switch(contextActivity());
+
         if (xasm_Configuration->parseInstruction())
             continue;
 
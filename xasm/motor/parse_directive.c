@@ -202,6 +202,11 @@ handleSection(intptr_t _) {
 				flags |= SECTF_ROOT;
 				break;
 			}
+			case T_FUNC_MERGEABLE: {
+				parse_GetToken();
+				flags |= SECTF_MERGEABLE;
+				break;
+			}
 			default:
 				return false;
 		}
@@ -464,7 +469,10 @@ static string *getFilename(void) {
 
 static void
 includeFile(string* name) {
-	lexctx_ProcessIncludeFile(name);
+	// A file skipped by its include guard must leave the line break after the file name to be read again
+	if (!lexctx_ProcessIncludeFile(name))
+		lex_UnputString("\n");
+
 	parse_GetToken();
 }
 
@@ -18,13 +18,91 @@
 
 
 #include <assert.h>
+#include <string.h>
+
+#include "mem.h"
+
 #include "xasm.h"
 #include "expression.h"
 #include "lexer.h"
+#include "lexer_constants.h"
+#include "literals.h"
 #include "parse.h"
+#include "parse_expression.h"
 #include "options.h"
 #include "errors.h"
 #include "parse_string.h"
+#include "profile.h"
+
+#define EXPRESSION_CACHE_SIZE 1024U
+
+typedef struct {
+    SSymbol* symbol;
+    int32_t value;
+} SSymbolValue;
+
+// The value of a constant expression at a position in the text of a macro or REPT block
+typedef struct CachedExpression {
+    struct CachedExpression* next;
+
+    string* text;
+    size_t start;
+    size_t maxStringConstLength;
+    SLexerToken firstToken;
+    bool firstAtLineStart;
+
+    // What the value depended on
+    uint32_t constantsGeneration;
+    uint32_t constantsPurged;
+    uint8_t binaryLiteralCharacters[2];
+    uint8_t gameboyLiteralCharacters[4];
+    bool allowReservedKeywordLabels;
+    SSymbolValue* symbolValues;
+    size_t totalSymbolValues;
+
+    int32_t value;
+    bool parens;
+
+    // The lexer state following the expression
+    SLexerToken token;
+    size_t end;
+    bool atLineStart;
+} SCachedExpression;
+
+static SCachedExpression* g_cachedExpressions[EXPRESSION_CACHE_SIZE];
+
+// Set while an expression is parsed for the cache, the symbol values it uses are collected
+static bool g_recording = false;
+static bool g_cacheable;
+static SSymbolValue* g_symbolValues = NULL;
+static size_t g_totalSymbolValues = 0;
+static size_t g_allocatedSymbolValues = 0;
+
+static void
+notCacheable(void) {
+    g_cacheable = false;
+}
+
+// Only EQU and SET symbols in the global scope are looked up the same way wherever the expression is parsed
+static void
+recordSymbol(SSymbol* symbol) {
+    if (!g_recording)
+        return;
+
+    if (symbol->scope != NULL || (symbol->type != SYM_EQU && symbol->type != SYM_SET) || symbol->callback.integer != NULL) {
+        g_cacheable = false;
+        return;
+    }
+
+    if (g_totalSymbolValues == g_allocatedSymbolValues) {
+        g_allocatedSymbolValues = g_allocatedSymbolValues != 0 ? g_allocatedSymbolValues * 2 : 16;
+        g_symbolValues = mem_Realloc(g_symbolValues, g_allocatedSymbolValues * sizeof(SSymbolValue));
+    }
+
+    g_symbolValues[g_totalSymbolValues].symbol = symbol;
+    g_symbolValues[g_totalSymbolValues].value = symbol->value.integer;
+    ++g_totalSymbolValues;
+}
 
 static int32_t
 stringCompare(string* s) {
@@ -52,16 +130,15 @@ switchToLiteralSection(void) {
 
     string* section = str_Create("$LITERALS$");
     sect_SwitchTo(section, group);
+
+    // The linker may fold identical literal pools of different objects, unless the section was declared otherwise
+    if (sect_Current != NULL && sect_Current->flags == 0)
+        sect_Current->flags = SECTF_MERGEABLE;
+
     str_Free(groupName);
     str_Free(section);
 }
 
-static string*
-createLiteralName(void) {
-    static uint32_t id = 0;
-    return str_CreateFormat("__$Literal_%u", id++);
-}
-
 static SExpression*
 expressionPriority0(size_t maxStringConstLength);
 
@@ -86,17 +163,29 @@ expressionPriority9(size_t maxStringConstLength) {
             return expr_Const(val);
         }
         case '{': {
+            notCacheable();
             parse_GetToken();
 
             sect_Push();
             switchToLiteralSection();
-            string* symbolName = createLiteralName();
-            sym_CreateLabel(symbolName);
+            string* symbolName = lit_CreateName();
+            SSymbol* symbol = sym_CreateLabel(symbolName);
+
+            SLiteralStart start;
+            lit_Begin(&start);
             parse_Until('}');
+            SSymbol* literal = lit_End(&start, symbol);
+
             sect_Pop();
             parse_GetToken();
 
-            SExpression* expression = expr_SymbolByName(symbolName);
+            SExpression* expression;
+            if (literal != symbol) {
+                sym_Purge(symbolName);
+                expression = expr_Symbol(literal);
+            } else {
+                expression = expr_SymbolByName(symbolName);
+            }
             str_Free(symbolName);
             return expression;
         }
@@ -152,12 +241,14 @@ expressionPriority9(size_t maxStringConstLength) {
 					}
 				}
 
+				recordSymbol(symbol);
 				return expr_Symbol(symbol);
             }
         }
         // fall through
         case T_OP_MULTIPLY:
         case T_AT: {
+            notCacheable();
             SExpression* expr = expr_Pc();
             parse_GetToken();
             return expr;
@@ -167,6 +258,7 @@ expressionPriority9(size_t maxStringConstLength) {
         default: {
             if (opt_Current->allowReservedKeywordLabels) {
                 if (lex_Context->token.length > 0 && lex_Context->token.id >= T_FIRST_TOKEN) {
+                    notCacheable();
                     string* str = lex_TokenString();
                     SExpression* expr = expr_SymbolByName(str);
                     str_Free(str);
@@ -239,6 +331,9 @@ expressionPriority8(size_t maxStringConstLength) {
 
     string* s = parse_StringExpression();
     if (s != NULL) {
+        // The value depends on string symbols
+        notCacheable();
+
         if (parse_IsDot()) {
             SExpression* expression = handleStringMemberFunctionReturningInt(s);
             if (expression != NULL)
@@ -385,13 +480,17 @@ expressionPriority7(size_t maxStringConstLength) {
         case T_FUNC_ATAN:
             return handleArityOneFunction(expr_Atan, maxStringConstLength);
         case T_FUNC_DEF:
+            notCacheable();
             return handleDefFunction();
         case T_FUNC_BANK:
+            notCacheable();
             return handleBankFunction();
         default: {
             SExpression* expr = xasm_Configuration->parseFunction();
-            if (expr != NULL)
+            if (expr != NULL) {
+                notCacheable();
                 return expr;
+            }
 
             return expressionPriority8(maxStringConstLength);
         }
@@ -611,13 +710,178 @@ expressionPriority0(size_t maxStringConstLength) {
 }
 
 
+static uint32_t
+cacheHash(const string* text, size_t start) {
+    return (uint32_t) (((uintptr_t) text >> 4) * 31 + start) & (EXPRESSION_CACHE_SIZE - 1);
+}
+
+static bool
+equalTokens(const SLexerToken* token1, const SLexerToken* token2) {
+    if (token1->id != token2->id || token1->length != token2->length)
+        return false;
+
+    switch (token1->id) {
+        case T_NUMBER:
+            return token1->value.integer == token2->value.integer;
+        case T_FLOAT:
+            return token1->value.floating == token2->value.floating;
+        default:
+            return memcmp(token1->value.string, token2->value.string, token1->length) == 0;
+    }
+}
+
+static SCachedExpression*
+findCachedExpression(const string* text, size_t start) {
+    for (SCachedExpression* entry = g_cachedExpressions[cacheHash(text, start)]; entry != NULL; entry = entry->next) {
+        if (entry->text == text && entry->start == start)
+            return entry;
+    }
+
+    return NULL;
+}
+
+static bool
+isCachedExpressionIntact(const SCachedExpression* entry, size_t maxStringConstLength) {
+    if (entry->maxStringConstLength != maxStringConstLength
+    ||  entry->constantsPurged != sym_ConstantsPurged
+    ||  entry->constantsGeneration != lex_ConstantsGeneration()
+    ||  entry->allowReservedKeywordLabels != opt_Current->allowReservedKeywordLabels
+    ||  memcmp(entry->binaryLiteralCharacters, opt_Current->binaryLiteralCharacters, sizeof(entry->binaryLiteralCharacters)) != 0
+    ||  memcmp(entry->gameboyLiteralCharacters, opt_Current->gameboyLiteralCharacters, sizeof(entry->gameboyLiteralCharacters)) != 0
+    ||  entry->firstAtLineStart != lex_Context->atLineStart
+    ||  !equalTokens(&entry->firstToken, &lex_Context->token)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < entry->totalSymbolValues; ++i) {
+        if (entry->symbolValues[i].symbol->value.integer != entry->symbolValues[i].value)
+            return false;
+    }
+
+    return true;
+}
+
+static void
+storeCachedExpression(SCachedExpression* entry, string* text, size_t start, size_t maxStringConstLength,
+                      const SLexerToken* firstToken, bool firstAtLineStart, const SExpression* expression) {
+    if (entry == NULL) {
+        entry = mem_Alloc(sizeof(SCachedExpression));
+        entry->text = str_Copy(text);
+        entry->start = start;
+        entry->symbolValues = NULL;
+
+        uint32_t hash = cacheHash(text, start);
+        entry->next = g_cachedExpressions[hash];
+        g_cachedExpressions[hash] = entry;
+    }
+
+    entry->maxStringConstLength = maxStringConstLength;
+    entry->firstToken = *firstToken;
+    entry->firstAtLineStart = firstAtLineStart;
+
+    entry->constantsGeneration = lex_ConstantsGeneration();
+    entry->constantsPurged = sym_ConstantsPurged;
+    entry->allowReservedKeywordLabels = opt_Current->allowReservedKeywordLabels;
+    memcpy(entry->binaryLiteralCharacters, opt_Current->binaryLiteralCharacters, sizeof(entry->binaryLiteralCharacters));
+    memcpy(entry->gameboyLiteralCharacters, opt_Current->gameboyLiteralCharacters, sizeof(entry->gameboyLiteralCharacters));
+
+    entry->symbolValues = mem_Realloc(entry->symbolValues, (g_totalSymbolValues + 1) * sizeof(SSymbolValue));
+    memcpy(entry->symbolValues, g_symbolValues, g_totalSymbolValues * sizeof(SSymbolValue));
+    entry->totalSymbolValues = g_totalSymbolValues;
+
+    entry->value = expression->value.integer;
+    entry->parens = expr_Type(expression) == EXPR_PARENS;
+
+    entry->token = lex_Context->token;
+    entry->end = lex_Context->buffer.index;
+    entry->atLineStart = lex_Context->atLineStart;
+}
+
+// Macros and REPT blocks often parse the same constant expressions with the same symbol values again. The value is
+// cached by the position in the text following the first token, the lexer is then moved past the expression without
+// lexing it. An expression is only cached if the symbol values were the only thing it depended on.
+static SExpression*
+cachedExpression(size_t maxStringConstLength) {
+    SLexerContext* context = lex_Context;
+    SLexerBuffer* buffer = &context->buffer;
+    if (!lexbuf_RewindUnputChars(buffer, 0))
+        return expressionPriority0(maxStringConstLength);
+
+    string* text = buffer->text;
+    size_t start = buffer->index;
+
+    SCachedExpression* entry = findCachedExpression(text, start);
+    if (entry != NULL && isCachedExpressionIntact(entry, maxStringConstLength)) {
+        prof_Count(PROF_EXPRESSION_CACHE_HITS);
+
+        context->token = entry->token;
+        context->atLineStart = entry->atLineStart;
+        buffer->index = entry->end;
+
+        SExpression* expression = expr_Const(entry->value);
+        return entry->parens ? expr_Parens(expression) : expression;
+    }
+
+    prof_Count(PROF_EXPRESSION_CACHE_MISSES);
+
+    SLexerToken firstToken = context->token;
+    bool firstAtLineStart = context->atLineStart;
+    uint32_t totalErrors = xasm_TotalErrors;
+    uint32_t totalWarnings = xasm_TotalWarnings;
+    uint32_t unputStrings = lex_UnputStrings;
+
+    g_recording = true;
+    g_cacheable = true;
+    g_totalSymbolValues = 0;
+
+    SExpression* expression = expressionPriority0(maxStringConstLength);
+
+    g_recording = false;
+
+    // Errors and warnings must be reported again, and expanded arguments and symbols may be different next time
+    if (g_cacheable && expr_IsConstant(expression)
+    &&  xasm_TotalErrors == totalErrors && xasm_TotalWarnings == totalWarnings && lex_UnputStrings == unputStrings
+    &&  lex_Context == context && buffer->text == text && buffer->index >= start
+    &&  memchr(str_String(text) + start, '\\', buffer->index - start) == NULL
+    &&  lexbuf_RewindUnputChars(buffer, start)) {
+        storeCachedExpression(entry, text, start, maxStringConstLength, &firstToken, firstAtLineStart, expression);
+    }
+
+    return expression;
+}
+
+
 /* Public functions */
 
 SExpression*
 parse_Expression(size_t maxStringConstLength) {
+    if (!g_recording && (lex_Context->type == CONTEXT_MACRO || lex_Context->type == CONTEXT_REPT) && lex_Context->mode == LEXER_MODE_NORMAL)
+        return cachedExpression(maxStringConstLength);
+
     return expressionPriority0(maxStringConstLength);
 }
 
+void
+parse_ResetExpressionCache(void) {
+    for (uint32_t i = 0; i < EXPRESSION_CACHE_SIZE; ++i) {
+        SCachedExpression* entry = g_cachedExpressions[i];
+        while (entry != NULL) {
+            SCachedExpression* next = entry->next;
+            str_Free(entry->text);
+            mem_Free(entry->symbolValues);
+            mem_Free(entry);
+            entry = next;
+        }
+        g_cachedExpressions[i] = NULL;
+    }
+
+    mem_Free(g_symbolValues);
+    g_symbolValues = NULL;
+    g_totalSymbolValues = 0;
+    g_allocatedSymbolValues = 0;
+    g_recording = false;
+}
+
 int32_t
 parse_ConstantExpression(void) {
     SExpression* expr = parse_Expression(4);
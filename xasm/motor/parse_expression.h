@@ -33,4 +33,8 @@ parse_ExpressionS16(void);
 extern SExpression*
 parse_ExpressionU16(void);
 
+// Forgets the values of constant expressions cached while assembling a file
+extern void
+parse_ResetExpressionCache(void);
+
 #endif // XASM_MOTOR_PARSE_EXPRESSION_H_INCLUDED_
@@ -61,6 +61,11 @@ getRsCounter(void) {
 	return g_rsSymbol;
 }
 
+void
+parse_ResetRs(void) {
+	g_rsSymbol = NULL;
+}
+
 int32_t
 parse_IncrementRs(int32_t size) {
 	SSymbol* rsSymbol = getRsCounter();
@@ -19,6 +19,10 @@
 #ifndef XASM_MOTOR_PARSE_SYMBOL_H_INCLUDED_
 #define XASM_MOTOR_PARSE_SYMBOL_H_INCLUDED_
 
+// Forgets the RS counter symbol, must be called when the symbol table is freed
+extern void
+parse_ResetRs(void);
+
 extern int32_t
 parse_IncrementRs(int32_t size);
 
@@ -0,0 +1,189 @@
+/*  Copyright 2008-2022 Carsten Elton Sorensen and contributors
+
+    This file is part of ASMotor.
+
+    ASMotor is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ASMotor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Assembly profile for option -p. The time of every activity is exclusive - time spent lexing
+ * while expanding a macro is charged to lexing, not to the macro. Statements are charged to the
+ * innermost lexer context, so a REPT block inside a macro is charged to REPT expansion.
+ */
+
+#include "mem.h"
+
+#include "xasm.h"
+#include "errors.h"
+#include "profile.h"
+
+// Shared with xlink
+#include "timing.h"
+
+typedef struct {
+    EActivity activity;
+    double start;
+    double end;
+} SPhase;
+
+bool prof_Enabled = false;
+uint64_t prof_Counters[PROF_TOTAL_COUNTERS];
+
+static const char* g_traceFilename = NULL;
+
+static double g_startTime;
+static double g_switchTime;
+static EActivity g_currentActivity = PROF_STARTUP;
+static double g_activityTimes[PROF_TOTAL_ACTIVITIES];
+
+static SPhase* g_phases = NULL;
+static uint32_t g_totalPhases = 0;
+static uint32_t g_allocatedPhases = 0;
+
+static const char* g_activityNames[PROF_TOTAL_ACTIVITIES] = {
+    "startup", "parse", "macro", "rept", "lex", "optimize", "backpatch", "write"
+};
+
+static const char* g_counterNames[PROF_TOTAL_COUNTERS] = {
+    "tokens", "macroInvocations", "reptBlocks", "includes", "bookmarks", "symbolLookups", "expressions",
+    "expressionCacheHits", "expressionCacheMisses"
+};
+
+static void
+beginPhase(EActivity activity, double time) {
+    if (g_totalPhases > 0)
+        g_phases[g_totalPhases - 1].end = time;
+
+    if (g_totalPhases == g_allocatedPhases) {
+        g_allocatedPhases = g_allocatedPhases != 0 ? g_allocatedPhases * 2 : 16;
+        g_phases = mem_Realloc(g_phases, sizeof(SPhase) * g_allocatedPhases);
+    }
+
+    SPhase* phase = &g_phases[g_totalPhases++];
+    phase->activity = activity;
+    phase->start = time;
+    phase->end = time;
+}
+
+static void
+writeTrace(const char* name, double total, uint64_t peak) {
+    FILE* fileHandle = fopen(name, "wt");
+    if (fileHandle == NULL) {
+        err_Warn(WARN_CANNOT_WRITE_FILE, name);
+        return;
+    }
+
+    fprintf(fileHandle, "{\"traceEvents\":[\n");
+    for (uint32_t i = 0; i < g_totalPhases; ++i) {
+        SPhase* phase = &g_phases[i];
+        fprintf(fileHandle, "{\"name\":\"%s\",\"cat\":\"xasm\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1},\n",
+                g_activityNames[phase->activity], phase->start - g_startTime, phase->end - phase->start);
+    }
+
+    fprintf(fileHandle, "{\"name\":\"activities\",\"cat\":\"xasm\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{", total);
+    for (uint32_t i = 0; i < PROF_TOTAL_ACTIVITIES; ++i) {
+        fprintf(fileHandle, "%s\"%s\":%.3f", i == 0 ? "" : ",", g_activityNames[i], g_activityTimes[i] / 1000.0);
+    }
+    fprintf(fileHandle, "}},\n");
+
+    fprintf(fileHandle, "{\"name\":\"counts\",\"cat\":\"xasm\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{\"lines\":%u", total, xasm_TotalLines);
+    for (uint32_t i = 0; i < PROF_TOTAL_COUNTERS; ++i) {
+        fprintf(fileHandle, ",\"%s\":%llu", g_counterNames[i], (unsigned long long) prof_Counters[i]);
+    }
+    fprintf(fileHandle, ",\"peakMemoryKiB\":%llu}},\n", (unsigned long long) peak);
+
+    fprintf(fileHandle, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"%s\"}}\n", xasm_Configuration->executableName);
+    fprintf(fileHandle, "],\"displayTimeUnit\":\"ms\"}\n");
+
+    fclose(fileHandle);
+}
+
+
+/* Exported functions */
+
+extern void
+prof_Enable(const char* traceFilename) {
+    prof_Enabled = true;
+    g_traceFilename = traceFilename;
+    g_startTime = timing_Now();
+    g_switchTime = g_startTime;
+    beginPhase(PROF_STARTUP, g_startTime);
+}
+
+extern EActivity
+prof_Switch(EActivity activity) {
+    EActivity previous = g_currentActivity;
+    if (activity != previous) {
+        double time = timing_Now();
+        g_activityTimes[previous] += time - g_switchTime;
+        g_switchTime = time;
+        g_currentActivity = activity;
+    }
+    return previous;
+}
+
+extern void
+prof_Phase(EActivity activity) {
+    if (!prof_Enabled)
+        return;
+
+    prof_Switch(activity);
+    beginPhase(activity, g_switchTime);
+}
+
+extern void
+prof_Write(FILE* fileHandle) {
+    if (!prof_Enabled)
+        return;
+
+    double time = timing_Now();
+    g_activityTimes[g_currentActivity] += time - g_switchTime;
+    g_switchTime = time;
+    if (g_totalPhases > 0)
+        g_phases[g_totalPhases - 1].end = time;
+
+    double total = time - g_startTime;
+
+    fprintf(fileHandle, "Assembly profile:\n");
+    for (uint32_t i = 0; i < PROF_TOTAL_ACTIVITIES; ++i) {
+        fprintf(fileHandle, "    %-12s %10.3f ms\n", g_activityNames[i], g_activityTimes[i] / 1000.0);
+    }
+    fprintf(fileHandle, "    %-12s %10.3f ms\n", "total", total / 1000.0);
+
+    fprintf(fileHandle, "%u lines, %llu tokens, %llu expression nodes, %llu symbol lookups\n", xasm_TotalLines,
+            (unsigned long long) prof_Counters[PROF_TOKENS], (unsigned long long) prof_Counters[PROF_EXPRESSIONS],
+            (unsigned long long) prof_Counters[PROF_SYMBOL_LOOKUPS]);
+    fprintf(fileHandle, "%llu macro invocations, %llu REPT blocks, %llu includes, %llu bookmarks\n",
+            (unsigned long long) prof_Counters[PROF_MACRO_INVOCATIONS], (unsigned long long) prof_Counters[PROF_REPT_BLOCKS],
+            (unsigned long long) prof_Counters[PROF_INCLUDES], (unsigned long long) prof_Counters[PROF_BOOKMARKS]);
+
+    uint64_t lookups = prof_Counters[PROF_EXPRESSION_CACHE_HITS] + prof_Counters[PROF_EXPRESSION_CACHE_MISSES];
+    if (lookups != 0) {
+        fprintf(fileHandle, "%llu of %llu expressions in macros and REPT blocks found in the expression cache (%.1f%%)\n",
+                (unsigned long long) prof_Counters[PROF_EXPRESSION_CACHE_HITS], (unsigned long long) lookups,
+                100.0 * (double) prof_Counters[PROF_EXPRESSION_CACHE_HITS] / (double) lookups);
+    }
+
+    uint64_t peak = timing_PeakMemory();
+    if (peak != 0)
+        fprintf(fileHandle, "Peak memory %llu KiB\n", (unsigned long long) peak);
+
+    if (g_traceFilename != NULL)
+        writeTrace(g_traceFilename, total, peak);
+
+    mem_Free(g_phases);
+    g_phases = NULL;
+    g_totalPhases = 0;
+    g_allocatedPhases = 0;
+}
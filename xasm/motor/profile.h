@@ -0,0 +1,73 @@
+/*  Copyright 2008-2022 Carsten Elton Sorensen and contributors
+
+    This file is part of ASMotor.
+
+    ASMotor is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ASMotor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef XASM_MOTOR_PROFILE_H_INCLUDED_
+#define XASM_MOTOR_PROFILE_H_INCLUDED_
+
+#include <stdio.h>
+
+#include "types.h"
+
+typedef enum {
+    PROF_STARTUP,
+    PROF_PARSE,
+    PROF_MACRO,
+    PROF_REPT,
+    PROF_LEX,
+    PROF_OPTIMIZE,
+    PROF_BACKPATCH,
+    PROF_WRITE,
+    PROF_TOTAL_ACTIVITIES
+} EActivity;
+
+typedef enum {
+    PROF_TOKENS,
+    PROF_MACRO_INVOCATIONS,
+    PROF_REPT_BLOCKS,
+    PROF_INCLUDES,
+    PROF_BOOKMARKS,
+    PROF_SYMBOL_LOOKUPS,
+    PROF_EXPRESSIONS,
+    PROF_EXPRESSION_CACHE_HITS,
+    PROF_EXPRESSION_CACHE_MISSES,
+    PROF_TOTAL_COUNTERS
+} ECounter;
+
+extern bool prof_Enabled;
+extern uint64_t prof_Counters[PROF_TOTAL_COUNTERS];
+
+#define prof_Count(counter) (++prof_Counters[counter])
+
+// Enables profiling, and a Chrome trace event file if traceFilename isn't NULL
+extern void
+prof_Enable(const char* traceFilename);
+
+// Charges the time since the last switch to the current activity and makes activity the current one.
+// Returns the previous activity. Must only be called when profiling is enabled.
+extern EActivity
+prof_Switch(EActivity activity);
+
+// Starts a new phase of the assembly, which is also an event in the trace file
+extern void
+prof_Phase(EActivity activity);
+
+// Ends the current phase and writes the profile, and the trace file if requested
+extern void
+prof_Write(FILE* fileHandle);
+
+#endif /* XASM_MOTOR_PROFILE_H_INCLUDED_ */
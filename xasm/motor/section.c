@@ -138,6 +138,8 @@ growCurrentSection(uint32_t count) {
 	if (count + sect_Current->usedSpace > sect_Current->allocatedSpace) {
 		uint32_t allocate = alignToNext(count + sect_Current->usedSpace, SECTION_GROWTH_AMOUNT);
 		if ((sect_Current->data = mem_Realloc(sect_Current->data, allocate)) != NULL) {
+			// Locations of patches are skipped rather than written, they must not contain stale memory
+			memset(sect_Current->data + sect_Current->allocatedSpace, 0, allocate - sect_Current->allocatedSpace);
 			sect_Current->allocatedSpace = allocate;
 		} else {
 			internalerror("Out of memory!");
@@ -563,6 +565,30 @@ sect_SkipBytes(uint32_t count) {
 	}
 }
 
+void
+sect_Truncate(SSection* section, uint32_t usedSpace, uint32_t programCounter) {
+	if (usedSpace >= section->usedSpace)
+		return;
+
+	SPatch* patch = section->patches;
+	while (patch != NULL) {
+		SPatch* next = list_GetNext(patch);
+		if (patch->offset >= usedSpace) {
+			list_Remove(section->patches, patch);
+			patch_Free(patch);
+		}
+		patch = next;
+	}
+
+	// Memory beyond the used space must be cleared, see growCurrentSection
+	if (section->data != NULL)
+		memset(section->data + usedSpace, 0, section->usedSpace - usedSpace);
+
+	section->freeSpace += section->usedSpace - usedSpace;
+	section->usedSpace = usedSpace;
+	section->cpuProgramCounter = programCounter;
+}
+
 bool
 sect_SwitchTo(const string* sectname, SSymbol* group) {
 	SSection* newSection = findSection(sectname, group);
@@ -638,6 +664,12 @@ sect_Exit(void) {
 		freeSection(section);
 		section = next;
 	}
+
+	while (g_sectionStack != NULL) {
+		SSectionStackEntry* next = g_sectionStack->next;
+		mem_Free(g_sectionStack);
+		g_sectionStack = next;
+	}
 }
 
 void
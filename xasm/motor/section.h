@@ -63,6 +63,7 @@ typedef struct Section SSection;
 #define SECTF_ORGFIXED  0x04u
 #define SECTF_ALIGNED   0x08u
 #define SECTF_ROOT      0x10u
+#define SECTF_MERGEABLE 0x20u
 
 extern SSection* sect_Current;
 extern SSection* sect_Sections;
@@ -94,6 +95,9 @@ sect_SkipBytes(uint32_t count);
 extern void
 sect_Align(uint32_t align);
 
+extern void
+sect_Truncate(SSection* section, uint32_t usedSpace, uint32_t programCounter);
+
 extern uint32_t
 sect_CurrentSize(void);
 
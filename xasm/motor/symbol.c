@@ -26,10 +26,12 @@
 #include "mem.h"
 
 #include "xasm.h"
+#include "cache.h"
 #include "symbol.h"
 #include "lexer_context.h"
 #include "errors.h"
 #include "section.h"
+#include "profile.h"
 
 #define SET_TYPE_AND_FLAGS(symbol, t) ((symbol)->type=t,(symbol)->flags=((symbol)->flags&SYMF_EXPORT)|g_defaultSymbolFlags[t])
 
@@ -49,6 +51,10 @@ static uint32_t g_defaultSymbolFlags[] = {
 
 SSymbol* sym_CurrentScope = NULL;
 
+uint32_t sym_ConstantsPurged = 0;
+
+static uint32_t g_totalLabels = 0;
+
 SSymbol* sym_hashedSymbols[SYMBOL_HASH_SIZE];
 
 
@@ -108,6 +114,7 @@ static string* getAmigaDateString() {
 
 static string*
 callback__DATE(SSymbol* symbol) {
+	cache_Bypass();
 	str_Free(symbol->value.macro);
 	symbol->value.macro = getDateString();
 
@@ -116,6 +123,7 @@ callback__DATE(SSymbol* symbol) {
 
 static string*
 callback__TIME(SSymbol* symbol) {
+	cache_Bypass();
 	str_Free(symbol->value.macro);
 	symbol->value.macro = getTimeString();
 
@@ -124,6 +132,7 @@ callback__TIME(SSymbol* symbol) {
 
 static string*
 callback__AMIGADATE(SSymbol* symbol) {
+	cache_Bypass();
 	str_Free(symbol->value.macro);
 	symbol->value.macro = getAmigaDateString();
 
@@ -151,6 +160,9 @@ createEqusCallback(const char* name, string* (*callback)(struct Symbol*)) {
 
 static void
 freeSymbol(SSymbol* symbol) {
+	if (symbol->type == SYM_EQU || symbol->type == SYM_SET)
+		++sym_ConstantsPurged;
+
 	str_Free(symbol->name);
 	if ((symbol->type == SYM_MACRO || symbol->type == SYM_EQUS) && symbol->callback.string == NULL) {
 		str_Free(symbol->value.macro);
@@ -165,6 +177,7 @@ hash(const string* name) {
 
 static SSymbol*
 getSymbol(const string* name, const SSymbol* scope) {
+	prof_Count(PROF_SYMBOL_LOOKUPS);
 	for (SSymbol* symbol = sym_hashedSymbols[hash(name)]; symbol; symbol = list_GetNext(symbol)) {
 		if (symbol->scope == scope && str_Equal(symbol->name, name))
 			return symbol;
@@ -384,6 +397,7 @@ sym_CreateLabel(string* name) {
 				symbol->value.integer = sect_Current->cpuProgramCounter + sect_Current->cpuAdjust
 									  + sect_Current->cpuOrigin;
 			}
+			++g_totalLabels;
 			return symbol;
 		} else {
 			err_Error(ERROR_LABEL_SECTION);
@@ -395,6 +409,11 @@ sym_CreateLabel(string* name) {
 	return NULL;
 }
 
+extern uint32_t
+sym_TotalLabels(void) {
+	return g_totalLabels;
+}
+
 extern string*
 sym_GetSymbolValueAsStringByName(const string* name) {
 	SSymbol* symbol = findOrCreateSymbol(name);
@@ -616,5 +635,6 @@ sym_Exit(void) {
 			freeSymbol(symbol);
 			symbol = next;
 		}
+		sym_hashedSymbols[i] = NULL;
 	}
 }
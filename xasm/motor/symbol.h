@@ -91,6 +91,10 @@ typedef struct Symbol {
 extern SSymbol*
 sym_CurrentScope;
 
+// Counts the EQU and SET symbols freed, pointers to them kept elsewhere are invalid when it changes
+extern uint32_t
+sym_ConstantsPurged;
+
 extern bool
 sym_Init(void);
 
@@ -100,6 +104,9 @@ sym_Exit(void);
 extern SSymbol*
 sym_CreateLabel(string* name);
 
+extern uint32_t
+sym_TotalLabels(void);
+
 extern SSymbol*
 sym_CreateEqus(string* name, string* value);
 
@@ -60,6 +60,7 @@ typedef enum {
 	T_FUNC_BANK,
 	T_FUNC_ALIGN,
 	T_FUNC_ROOT,
+	T_FUNC_MERGEABLE,
 
 	T_OP_FDIV,
 	T_OP_FMUL,
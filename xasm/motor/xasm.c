@@ -38,20 +38,27 @@
 #include "xasm.h"
 #include "amigaobject.h"
 #include "binaryobject.h"
+#include "cache.h"
 #include "dependency.h"
 #include "elf.h"
 #include "errors.h"
 #include "lexer.h"
 #include "lexer_context.h"
+#include "literals.h"
 #include "object.h"
 #include "options.h"
 #include "parse.h"
+#include "parse_expression.h"
+#include "parse_symbol.h"
 #include "patch.h"
+#include "profile.h"
 #include "section.h"
 #include "symbol.h"
 #include "tokens.h"
 
 #include "util.h"
+#include "strbuf.h"
+#include "strcoll.h"
 #include "amitime.h"
 
 uint32_t xasm_TotalLines = 0;
@@ -63,12 +70,14 @@ const SConfiguration* xasm_Configuration = NULL;
 
 static void
 printUsage(void) {
-	printf("%s v%s, ASMotor v" ASMOTOR_VERSION "\n\nUsage: %s [options] asmfile\n"
+	printf("%s v%s, ASMotor v" ASMOTOR_VERSION "\n\nUsage: %s [options] asmfile [asmfile ...]\n"
 		   "Options:\n"
 		   "    -a<n>    Section alignment when writing binary file (default is %d bytes)\n"
 		   "    -b<AS>   Change the two characters used for binary constants\n"
 		   "             (default is 01)\n"
-		   "    -d<FILE> Output dependency file for GNU Make\n"
+		   "    -c<dir>  Keep an object cache in directory <dir>\n"
+		   "    -d<FILE> Output dependency file for GNU Make, or the directory for\n"
+		   "             dependency files when assembling several files\n"
 		   "    -D<NAME> Define EQU symbol with the value 1\n"
 		   "    -e(l|b)  Change endianness\n"
 		   "    -fF      Output format, one of\n"
@@ -86,7 +95,10 @@ printUsage(void) {
 	printf("    -g       Include debug information\n"
 		   "    -h       This text\n"
 		   "    -i<dir>  Extra include path (can appear more than once)\n"
-		   "    -o<f>    Write assembly output to <file>\n"
+		   "    -o<f>    Write assembly output to <file>, or to files in directory\n"
+		   "             <f> when assembling several files\n"
+		   "    -p[f]    Print an assembly profile, and write a Chrome trace event\n"
+		   "             file to [f]\n"
 		   "    -v       Verbose text output\n"
 		   "    -w<d>    Disable warning <d> (four digits)\n"
 		   "    -z<XX>   Set the byte value (hex format) used for uninitialised\n"
@@ -118,6 +130,178 @@ writeOutput(char format, string* outputFilename, string* sourceFilename) {
 
 }
 
+// Name of the output file in directory for a source file assembled in batch mode
+static string*
+batchFilename(const char* directory, string* sourcePath, const char* extension) {
+	const char* source = str_String(sourcePath);
+	const char* baseName = source;
+	for (const char* ch = source; *ch != 0; ++ch) {
+		if (*ch == '/' || *ch == '\\')
+			baseName = ch + 1;
+	}
+
+	const char* dot = strrchr(baseName, '.');
+	int baseLength = (int) (dot != NULL ? (size_t) (dot - baseName) : strlen(baseName));
+
+	string_buffer* buf = strbuf_Create();
+	strbuf_AppendFormat(buf, "%s/%.*s%s", directory, baseLength, baseName, extension);
+	string* str = strbuf_String(buf);
+	strbuf_Free(buf);
+
+	return str;
+}
+
+// Sources with the same base name would overwrite each other's output in batch mode
+static bool
+batchFilenamesUnique(const char* directory, char* sources[], int totalSources, const char* extension) {
+	bool unique = true;
+	string** filenames = mem_Alloc(sizeof(string*) * totalSources);
+
+	for (int i = 0; i < totalSources; ++i) {
+		string* sourcePath = str_Create(sources[i]);
+		filenames[i] = batchFilename(directory, sourcePath, extension);
+		str_Free(sourcePath);
+
+		for (int j = 0; j < i; ++j) {
+			if (str_Equal(filenames[i], filenames[j])) {
+				err_Error(ERROR_SAME_OUTPUT_FILE, sources[j], sources[i], str_String(filenames[i]));
+				unique = false;
+				break;
+			}
+		}
+	}
+
+	for (int i = 0; i < totalSources; ++i)
+		str_Free(filenames[i]);
+	mem_Free(filenames);
+
+	return unique;
+}
+
+static const char*
+outputExtension(char format) {
+	switch (format) {
+		case 'x':
+			return ".obj";
+		case 'e':
+		case 'h':
+			return ".o";
+		case 'b':
+			return ".bin";
+		case 'v':
+			return ".mem";
+		default:
+			return "";
+	}
+}
+
+static void
+defineSymbols(vec_t* definitions) {
+	for (size_t i = 0; i < strvec_Count(definitions); ++i) {
+		sym_CreateEqu(strvec_StringAt(definitions, i), 1);
+	}
+}
+
+// Assembles a single source file, the symbol table, sections and options are reset afterwards
+static bool
+assembleFile(string* sourcePath, string* outputFilename, const char* dependencyFilename, char format, vec_t* definitions, bool verbose) {
+	clock_t startClock = clock();
+	uint32_t startLines = xasm_TotalLines;
+
+	xasm_TotalErrors = 0;
+	xasm_TotalWarnings = 0;
+
+	sect_Init();
+	sym_Init();
+	lit_Init();
+	defineSymbols(definitions);
+
+	SOptions* commandLineOptions = opt_Current;
+	opt_Push();
+	opt_Updated();
+
+	// The dependencies are also collected for the object cache
+	if (dependencyFilename != NULL || cache_Enabled())
+		dep_Initialize(dependencyFilename);
+
+	parse_ExpandStrings = true;
+
+	// A fatal error ends the assembly of this file only
+	jmp_buf failure;
+	err_SetFailureHandler(&failure);
+
+	if (cache_Restore(sourcePath, outputFilename)) {
+		if (verbose)
+			printf("Restored %s from cache\n", str_String(outputFilename));
+
+		dep_SetMainOutput(outputFilename);
+		dep_WriteDependencyFile();
+	} else if (setjmp(failure) != 0) {
+		// A fatal error was reported, the errors are printed below
+	} else if (lex_BeginFile(sourcePath)) {
+		prof_Phase(PROF_PARSE);
+		bool parseResult = parse_Do();
+
+		if (parseResult) {
+			prof_Phase(PROF_OPTIMIZE);
+			patch_OptimizeAll();
+			prof_Phase(PROF_BACKPATCH);
+			patch_BackPatch();
+
+			sym_ErrorOnUndefined();
+		}
+
+		if (parseResult && xasm_TotalErrors == 0) {
+			if (verbose) {
+				clock_t endClock = clock();
+				uint32_t totalLines = xasm_TotalLines - startLines;
+
+				float timespent = ((float) (endClock - startClock)) / CLOCKS_PER_SEC;
+				printf("Success! %u lines in %.02f seconds ", totalLines, timespent);
+				if (timespent == 0) {
+					printf("\n");
+				} else {
+					printf("(%d lines/minute)\n", (int) (60 / timespent * totalLines));
+				}
+				if (xasm_TotalWarnings != 0) {
+					printf("Encountered %u warnings\n", xasm_TotalWarnings);
+				}
+				if (lit_TotalLiterals != 0) {
+					printf("%u of %u literals shared with an identical literal, %u bytes saved\n", lit_SharedLiterals, lit_TotalLiterals, lit_BytesSaved);
+				}
+			}
+
+			if (outputFilename != NULL) {
+				dep_SetMainOutput(outputFilename);
+				prof_Phase(PROF_WRITE);
+				if (writeOutput(format, outputFilename, sourcePath)) {
+					dep_WriteDependencyFile();
+					cache_Store(sourcePath, outputFilename);
+				} else  {
+					remove(str_String(outputFilename));
+				}
+			}
+		}
+	}
+
+	err_SetFailureHandler(NULL);
+	err_PrintAll();
+
+	dep_Exit();
+	lex_EndFile();
+
+	opt_Restore(commandLineOptions);
+
+	lit_Exit();
+	sym_Exit();
+	sect_Exit();
+	parse_ResetRs();
+	parse_ResetExpressionCache();
+
+	fflush(stdout);
+	return xasm_TotalErrors == 0;
+}
+
 extern int
 xasm_Main(const SConfiguration* configuration, int argc, char* argv[]) {
 	xasm_Configuration = configuration;
@@ -130,32 +314,44 @@ xasm_Main(const SConfiguration* configuration, int argc, char* argv[]) {
 	atexit(getchar);
 #endif
 
-	clock_t startClock = clock();
-
 	argc -= 1;
 	if (argc == 0)
 		printUsage();
 
 	err_Init();
-	sect_Init();
-	sym_Init();
 	opt_Open();
 
+	lex_Init();
+	tokens_Init(configuration->supportFloat);
+	if (configuration->supportFloat) {
+		assert(sizeof(float) == 4);
+		assert(sizeof(double) == 8);
+	}
+	xasm_Configuration->defineTokens();
+
 	char format = 'x';
-	string* outputFilename = NULL;
+	const char* outputName = NULL;
+	const char* dependencyName = NULL;
+	vec_t* definitions = strvec_Create();
 	bool verbose = false;
 	while (argc && argv[argn][0] == '-') {
+		if (strchr("cdhopv?", argv[argn][1]) == NULL)
+			cache_AddOption(argv[argn]);
+
 		switch (argv[argn][1]) {
 			case '?':
 			case 'h':
 				printUsage();
 				break;
+			case 'c':
+				cache_Open(&argv[argn][2]);
+				break;
 			case 'd':
-				dep_Initialize(&argv[argn][2]);
+				dependencyName = &argv[argn][2];
 				break;
 			case 'D': {
 				string* name = str_Create(&argv[argn][2]);
-				sym_CreateEqu(name, 1);
+				strvec_PushBack(definitions, name);
 				str_Free(name);
 				break;
 			}
@@ -189,7 +385,10 @@ xasm_Main(const SConfiguration* configuration, int argc, char* argv[]) {
 				}
 				break;
 			case 'o':
-				outputFilename = str_Create(&argv[argn][2]);
+				outputName = &argv[argn][2];
+				break;
+			case 'p':
+				prof_Enable(argv[argn][2] != 0 ? &argv[argn][2] : NULL);
 				break;
 			case 'v':
 				verbose = true;
@@ -212,74 +411,43 @@ xasm_Main(const SConfiguration* configuration, int argc, char* argv[]) {
 		--argc;
 	}
 
-	opt_Updated();
-
 	rcode = EXIT_SUCCESS;
 
 	if (argc == 1) {
 		string* sourcePath = str_Create(argv[argn]);
+		string* outputFilename = outputName != NULL ? str_Create(outputName) : NULL;
 
-		if (lex_Init(sourcePath)) {
-
-			tokens_Init(configuration->supportFloat);
-			if (configuration->supportFloat) {
-				assert(sizeof(float) == 4);
-				assert(sizeof(double) == 8);
-			}
-			xasm_Configuration->defineTokens();
-
-			bool parseResult = parse_Do();
-
-			if (parseResult) {
-				patch_OptimizeAll();
-				patch_BackPatch();
-
-				sym_ErrorOnUndefined();
-			}
+		if (!assembleFile(sourcePath, outputFilename, dependencyName, format, definitions, verbose))
+			rcode = EXIT_FAILURE;
 
-			if (parseResult && xasm_TotalErrors == 0) {
-				if (verbose) {
-					clock_t endClock = clock();
-
-					float timespent = ((float) (endClock - startClock)) / CLOCKS_PER_SEC;
-					printf("Success! %u lines in %.02f seconds ", xasm_TotalLines, timespent);
-					if (timespent == 0) {
-						printf("\n");
-					} else {
-						printf("(%d lines/minute)\n", (int) (60 / timespent * xasm_TotalLines));
-					}
-					if (xasm_TotalWarnings != 0) {
-						printf("Encountered %u warnings\n", xasm_TotalWarnings);
-					}
-				}
-
-				if (outputFilename != NULL) {
-					dep_SetMainOutput(outputFilename);
-					if (writeOutput(format, outputFilename, sourcePath)) {
-						dep_WriteDependencyFile();
-					} else  {
-						remove(str_String(outputFilename));
-					}
-				}
-			}
-
-			err_PrintAll();
-			if (xasm_TotalErrors > 0) {
+		str_Free(outputFilename);
+		str_Free(sourcePath);
+	} else if ((outputName != NULL && !batchFilenamesUnique(outputName, &argv[argn], argc, outputExtension(format)))
+	       ||  (dependencyName != NULL && !batchFilenamesUnique(dependencyName, &argv[argn], argc, ".d"))) {
+		rcode = EXIT_FAILURE;
+	} else {
+		// Batch mode, the output and dependency file options name directories
+		for (int i = 0; i < argc; ++i) {
+			string* sourcePath = str_Create(argv[argn + i]);
+			string* outputFilename = outputName != NULL ? batchFilename(outputName, sourcePath, outputExtension(format)) : NULL;
+			string* dependencyFilename = dependencyName != NULL ? batchFilename(dependencyName, sourcePath, ".d") : NULL;
+
+			if (!assembleFile(sourcePath, outputFilename, dependencyFilename != NULL ? str_String(dependencyFilename) : NULL, format, definitions, verbose))
 				rcode = EXIT_FAILURE;
-			}
+
+			str_Free(dependencyFilename);
+			str_Free(outputFilename);
+			str_Free(sourcePath);
 		}
-		str_Free(sourcePath);
-	} else if (argc > 1) {
-		err_Error(ERROR_TOO_MANY_FILES);
 	}
 
-	str_Free(outputFilename);
-	opt_Close();
+	prof_Write(stdout);
+	err_PrintAll();
 
-	dep_Exit();
-	sym_Exit();
+	strvec_Free(definitions);
+	cache_Close();
+	opt_Close();
 	lex_Exit();
-	sect_Exit();
 
 //	mem_ShowLeaks();
 
@@ -24,6 +24,21 @@
  *		uint32_t	Size
  *		uint8_t	Data[Size]
  *	ENDR
+ *
+ *	uint32_t	"XLB\1"
+ *	uint32_t	TotalFiles
+ *	REPT	TotalFiles
+ *		ASCIIZ	Name
+ *		uint32_t	Offset	; of Data, from the start of the file
+ *		uint32_t	Size
+ *		uint32_t	NumberOfExports	; UINT32_MAX = exports not known, module must always be linked
+ *		REPT	NumberOfExports
+ *			ASCIIZ	Name
+ *		ENDR
+ *	ENDR
+ *	REPT	TotalFiles
+ *		uint8_t	Data[Size]
+ *	ENDR
  */
 
 #include <stdio.h>
@@ -37,6 +52,7 @@
 #include "str.h"
 
 #include "module.h"
+#include "object.h"
 
 extern void
 fatalError(const char* s);
@@ -87,6 +103,74 @@ readLib0(FILE* fileHandle, size_t size) {
     return NULL;
 }
 
+static SModule*
+readLib1(FILE* fileHandle) {
+    SModule* first = NULL;
+    SModule** next = &first;
+
+    uint32_t count = fgetll(fileHandle);
+    uint32_t* offsets = (uint32_t*) mem_Alloc(sizeof(uint32_t) * (count + 1));
+
+    for (uint32_t i = 0; i < count; ++i) {
+        SModule* module = (SModule*) mem_Alloc(sizeof(SModule));
+        *next = module;
+        next = &module->nextModule;
+
+        fgetsz(module->name, MAXNAMELENGTH, fileHandle);
+        offsets[i] = fgetll(fileHandle);
+        module->byteLength = fgetll(fileHandle);
+        module->nextModule = NULL;
+
+        uint32_t totalExports = fgetll(fileHandle);
+        if (totalExports != UINT32_MAX) {
+            while (totalExports--) {
+                while (fgetc(fileHandle) > 0) {
+                }  // Skip name
+            }
+        }
+    }
+
+    uint32_t index = 0;
+    for (SModule* module = first; module != NULL; module = module->nextModule) {
+        module->data = (uint8_t*) mem_Alloc(module->byteLength);
+        if (fseek(fileHandle, offsets[index++], SEEK_SET) != 0
+        ||  module->byteLength != fread(module->data, sizeof(uint8_t), module->byteLength, fileHandle))
+            fatalError("File read failed");
+    }
+
+    mem_Free(offsets);
+    return first;
+}
+
+static void
+countExport(const char* name, intptr_t data) {
+    *(uint32_t*) data += 1;
+}
+
+static void
+writeExport(const char* name, intptr_t data) {
+    fputsz(name, (FILE*) data);
+}
+
+static long
+writeDirectoryEntry(SModule* module, FILE* fileHandle) {
+    fputsz(module->name, fileHandle);
+
+    long offsetPosition = ftell(fileHandle);
+    fputll(0, fileHandle);
+    fputll(module->byteLength, fileHandle);
+
+    uint32_t totalExports = 0;
+    if (obj_ForEachExport(module, countExport, (intptr_t) &totalExports)) {
+        fputll(totalExports, fileHandle);
+        obj_ForEachExport(module, writeExport, (intptr_t) fileHandle);
+    } else {
+        fputll(UINT32_MAX, fileHandle);
+    }
+
+    return offsetPosition;
+}
+
 SModule*
 lib_Read(const char* filename) {
     FILE* fileHandle = fopen(filename, "rb");
@@ -108,6 +192,10 @@ lib_Read(const char* filename) {
             SModule* result = readLib0(fileHandle, size);
             fclose(fileHandle);
             return result;
+        } else if (memcmp(ID, "XLB\1", 4) == 0) {
+            SModule* result = readLib1(fileHandle);
+            fclose(fileHandle);
+            return result;
         } else {
             fclose(fileHandle);
             fatalError("Not a valid xLib library");
@@ -123,21 +211,30 @@ lib_Write(SModule* library, const char* filename) {
     FILE* fileHandle = fopen(filename, "wb");
 
     if (fileHandle != NULL) {
-        fwrite("XLB\0", sizeof(char), 4, fileHandle);
-        fputll(0, fileHandle);
-
         uint32_t count = 0;
-        while (library != NULL) {
-            fputsz(library->name, fileHandle);
-            fputll(library->byteLength, fileHandle);
-            fwrite(library->data, sizeof(uint8_t), library->byteLength, fileHandle);
-            library = library->nextModule;
+        for (SModule* module = library; module != NULL; module = module->nextModule)
             ++count;
-        }
 
-        fseek(fileHandle, 4, SEEK_SET);
+        fwrite("XLB\1", sizeof(char), 4, fileHandle);
         fputll(count, fileHandle);
 
+        long* offsetPositions = (long*) mem_Alloc(sizeof(long) * (count + 1));
+
+        uint32_t index = 0;
+        for (SModule* module = library; module != NULL; module = module->nextModule)
+            offsetPositions[index++] = writeDirectoryEntry(module, fileHandle);
+
+        index = 0;
+        for (SModule* module = library; module != NULL; module = module->nextModule) {
+            long offset = ftell(fileHandle);
+            fwrite(module->data, sizeof(uint8_t), module->byteLength, fileHandle);
+
+            fseek(fileHandle, offsetPositions[index++], SEEK_SET);
+            fputll((uint32_t) offset, fileHandle);
+            fseek(fileHandle, 0, SEEK_END);
+        }
+
+        mem_Free(offsetPositions);
         fclose(fileHandle);
         return true;
     }
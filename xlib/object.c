@@ -0,0 +1,263 @@
+/*  Copyright 2008-2022 Carsten Elton Sorensen and contributors
+
+    This file is part of ASMotor.
+
+    ASMotor is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ASMotor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Minimal XOB reader, only concerned with finding the exported symbols of a module.
+ * Please refer to xlink/object.c for a description of the format.
+ */
+
+#include <string.h>
+
+#include "util.h"
+#include "mem.h"
+
+#include "object.h"
+
+#define GROUP_TYPE_TEXT 0
+#define GROUP_FLAGS (0x20000000u | 0x40000000u)
+
+#define SYMBOL_TYPE_EXPORT 0
+#define SYMBOL_TYPE_IMPORT 1
+#define SYMBOL_TYPE_LOCALIMPORT 4
+
+typedef struct {
+    const uint8_t* data;
+    uint32_t size;
+    uint32_t index;
+    bool error;
+
+    uint32_t version;
+    const char** strings;
+    uint32_t totalStrings;
+} SReader;
+
+static bool
+canRead(SReader* reader, uint32_t count) {
+    if (reader->error || reader->size - reader->index < count) {
+        reader->error = true;
+        return false;
+    }
+    return true;
+}
+
+static uint8_t
+readByte(SReader* reader) {
+    return canRead(reader, 1) ? reader->data[reader->index++] : 0;
+}
+
+static uint32_t
+readLong(SReader* reader) {
+    if (!canRead(reader, 4))
+        return 0;
+
+    const uint8_t* p = &reader->data[reader->index];
+    reader->index += 4;
+
+    return (uint32_t) p[0] | (uint32_t) p[1] << 8u | (uint32_t) p[2] << 16u | (uint32_t) p[3] << 24u;
+}
+
+static uint32_t
+readUnsigned(SReader* reader) {
+    uint32_t value = 0;
+    for (uint32_t shift = 0; shift < 35; shift += 7) {
+        uint8_t byte = readByte(reader);
+        value |= (uint32_t) (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return value;
+    }
+    reader->error = true;
+    return 0;
+}
+
+static int32_t
+readSigned(SReader* reader) {
+    uint32_t value = 0;
+    for (uint32_t shift = 0; shift < 35; shift += 7) {
+        uint8_t byte = readByte(reader);
+        value |= (uint32_t) (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            if (shift < 25 && (byte & 0x40) != 0)
+                value |= UINT32_MAX << (shift + 7);
+            return (int32_t) value;
+        }
+    }
+    reader->error = true;
+    return 0;
+}
+
+// Integers are LEB128 encoded from version 6. A signed integer is encoded with the same number of bytes as an
+// unsigned one, so readNumber can skip both, but a signed integer whose value is used must be read with readSignedNumber
+static uint32_t
+readNumber(SReader* reader) {
+    return reader->version >= 6 ? readUnsigned(reader) : readLong(reader);
+}
+
+static int32_t
+readSignedNumber(SReader* reader) {
+    return reader->version >= 6 ? readSigned(reader) : (int32_t) readLong(reader);
+}
+
+static void
+skipBytes(SReader* reader, uint32_t count) {
+    if (canRead(reader, count))
+        reader->index += count;
+}
+
+static const char*
+readString(SReader* reader) {
+    const char* s = (const char*) &reader->data[reader->index];
+    while (readByte(reader) != 0 && !reader->error) {
+    }
+    return reader->error ? NULL : s;
+}
+
+static const char*
+readName(SReader* reader) {
+    if (reader->version >= 6) {
+        uint32_t id = readUnsigned(reader);
+        if (id >= reader->totalStrings) {
+            reader->error = true;
+            return NULL;
+        }
+        return reader->strings[id];
+    }
+    return readString(reader);
+}
+
+static bool
+readStrings(SReader* reader) {
+    reader->totalStrings = readUnsigned(reader);
+    if (reader->error || reader->totalStrings > reader->size)
+        return false;
+
+    reader->strings = mem_Alloc(sizeof(const char*) * (reader->totalStrings + 1));
+    for (uint32_t i = 0; i < reader->totalStrings && !reader->error; ++i)
+        reader->strings[i] = readString(reader);
+
+    return !reader->error;
+}
+
+static uint32_t
+readVersion(SReader* reader) {
+    if (reader->size >= 4 && memcmp(reader->data, "XOB", 3) == 0) {
+        reader->index = 4;
+        return reader->data[3];
+    }
+    return UINT32_MAX;
+}
+
+static bool
+readSections(SReader* reader, uint32_t version, const bool* textGroups, uint32_t totalGroups,
+             void (* function)(const char*, intptr_t), intptr_t data) {
+    uint32_t totalSections = readNumber(reader);
+
+    for (uint32_t i = 0; i < totalSections && !reader->error; ++i) {
+        int32_t groupId = readSignedNumber(reader);    // -1 for exported EQU symbols
+        readName(reader);
+        readNumber(reader);         // Bank
+        readNumber(reader);         // Position
+        if (version >= 1)
+            readNumber(reader);     // BasePC
+        if (version >= 3)
+            readNumber(reader);     // ByteAlign
+        if (version >= 4)
+            skipBytes(reader, 1);   // Flags
+
+        uint32_t totalSymbols = readNumber(reader);
+        for (uint32_t j = 0; j < totalSymbols && !reader->error; ++j) {
+            const char* name = readName(reader);
+            uint32_t type = readNumber(reader);
+            if (type != SYMBOL_TYPE_IMPORT && type != SYMBOL_TYPE_LOCALIMPORT)
+                readNumber(reader);     // Value
+
+            if (type == SYMBOL_TYPE_EXPORT && !reader->error)
+                function(name, data);
+        }
+
+        if (version >= 5) {
+            if (readNumber(reader) != 0)
+                skipBytes(reader, readNumber(reader));  // Line mappings
+        } else if (version >= 2) {
+            skipBytes(reader, readLong(reader) * 4 * 3);
+        }
+
+        uint32_t size = readNumber(reader);
+        if (groupId >= 0 && (uint32_t) groupId < totalGroups && textGroups[groupId]) {
+            skipBytes(reader, size);
+
+            uint32_t totalPatches = readNumber(reader);
+            for (uint32_t j = 0; j < totalPatches && !reader->error; ++j) {
+                readNumber(reader);     // Offset
+                readNumber(reader);     // Type
+                skipBytes(reader, readNumber(reader));
+            }
+        }
+    }
+
+    return !reader->error;
+}
+
+static bool
+readModule(SReader* reader, void (* function)(const char*, intptr_t), intptr_t data) {
+    uint32_t version = reader->version;
+
+    if (version >= 1)
+        skipBytes(reader, 1);       // MinimumWordSize
+
+    if (version >= 6 && !readStrings(reader))
+        return false;
+
+    if (version >= 2) {
+        uint32_t totalFiles = readNumber(reader);
+        for (uint32_t i = 0; i < totalFiles && !reader->error; ++i) {
+            readName(reader);
+            skipBytes(reader, 4);   // CRC32
+        }
+    }
+
+    uint32_t totalGroups = readNumber(reader);
+    if (reader->error || totalGroups > reader->size)
+        return false;
+
+    bool* textGroups = mem_Alloc(sizeof(bool) * (totalGroups + 1));
+    for (uint32_t i = 0; i < totalGroups; ++i) {
+        readName(reader);
+        textGroups[i] = (readNumber(reader) & ~GROUP_FLAGS) == GROUP_TYPE_TEXT;
+    }
+
+    bool result = !reader->error && readSections(reader, version, textGroups, totalGroups, function, data);
+
+    mem_Free(textGroups);
+    return result;
+}
+
+bool
+obj_ForEachExport(const SModule* module, void (* function)(const char*, intptr_t), intptr_t data) {
+    SReader reader = { module->data, module->byteLength, 0, false, 0, NULL, 0 };
+
+    reader.version = readVersion(&reader);
+    if (reader.version > 6)
+        return false;
+
+    bool result = readModule(&reader, function, data);
+
+    if (reader.strings != NULL)
+        mem_Free(reader.strings);
+
+    return result;
+}
@@ -0,0 +1,33 @@
+/*  Copyright 2008-2022 Carsten Elton Sorensen and contributors
+
+    This file is part of ASMotor.
+
+    ASMotor is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ASMotor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef XLIB_OBJECT_H_INCLUDED_
+#define XLIB_OBJECT_H_INCLUDED_
+
+#include <stdint.h>
+
+#include "types.h"
+
+#include "module.h"
+
+// Calls function for every symbol exported by the module. Returns false if the module is not a
+// recognised XOB object file, in which case the exports cannot be indexed.
+extern bool
+obj_ForEachExport(const SModule* module, void (* function)(const char*, intptr_t), intptr_t data);
+
+#endif
@@ -16,11 +16,28 @@
     along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <stdlib.h>
+
+#include "mem.h"
+
+#include "assign.h"
 #include "section.h"
 #include "xlink.h"
 
 typedef bool (*sectionPredicate)(SSection*);
 
+static bool g_bestFit = false;
+
+static bool
+allocateMemory(SSection* section) {
+	if (g_bestFit)
+		return group_AllocateBestFit(section->group->name, section->size, section->cpuBank, &section->cpuByteLocation,
+		                             &section->cpuBank, &section->imageLocation);
+
+	return group_AllocateMemory(section->group->name, section->size, section->cpuBank, &section->cpuByteLocation,
+	                            &section->cpuBank, &section->imageLocation);
+}
+
 static void
 assignOrgAndBankFixedSection(SSection* section, intptr_t data) {
 	sectionPredicate predicate = (sectionPredicate) data;
@@ -49,8 +66,7 @@ static void
 assignBankFixedSection(SSection* section, intptr_t data) {
 	sectionPredicate predicate = (sectionPredicate) data;
     if (predicate(section) && section->cpuByteLocation == -1 && section->cpuBank != -1) {
-        if (!group_AllocateMemory(section->group->name, section->size, section->cpuBank, &section->cpuByteLocation,
-                                  &section->cpuBank, &section->imageLocation))
+        if (!allocateMemory(section))
             error("No space for section \"%s\"", section->name);
 
         section->cpuLocation = section->cpuByteLocation / section->minimumWordSize;
@@ -85,8 +101,7 @@ assignSection(SSection* section, intptr_t data) {
 			section->imageLocation = -1;
 			section->assigned = true;
 		} else if (predicate(section)) {
-			if (!group_AllocateMemory(section->group->name, section->size, section->cpuBank, &section->cpuByteLocation,
-									&section->cpuBank, &section->imageLocation))
+			if (!allocateMemory(section))
 				error("No space for section \"%s\"", section->name);
 
 			section->cpuLocation = section->cpuByteLocation / section->minimumWordSize;
@@ -130,6 +145,48 @@ truePredicate(SSection* section) {
 	return true;
 }
 
+static int
+compareSectionSizes(const void* element1, const void* element2) {
+	const SSection* section1 = *(const SSection**) element1;
+	const SSection* section2 = *(const SSection**) element2;
+
+	if (section1->size != section2->size)
+		return section1->size < section2->size ? 1 : -1;
+
+	return section1->sectionId < section2->sectionId ? -1 : section1->sectionId > section2->sectionId;
+}
+
+static void
+forEachUsedSectionBySize(void (* function)(SSection*, intptr_t), intptr_t data) {
+	uint32_t totalSections = 0;
+	for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
+		if (section->used)
+			++totalSections;
+	}
+
+	SSection** sections = mem_Alloc(sizeof(SSection*) * (totalSections + 1));
+	uint32_t index = 0;
+	for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
+		if (section->used)
+			sections[index++] = section;
+	}
+
+	qsort(sections, totalSections, sizeof(SSection*), compareSectionSizes);
+
+	for (uint32_t i = 0; i < totalSections; ++i)
+		function(sections[i], data);
+
+	mem_Free(sections);
+}
+
+static void
+forEachFloatingSection(void (* function)(SSection*, intptr_t), intptr_t data) {
+	if (g_bestFit)
+		forEachUsedSectionBySize(function, data);
+	else
+		sect_ForEachUsedSection(function, data);
+}
+
 #define TOTAL_PREDICATES 6
 static sectionPredicate sectionPredicates[TOTAL_PREDICATES] = {
 	isCodeShared, isCode,
@@ -138,15 +195,17 @@ static sectionPredicate sectionPredicates[TOTAL_PREDICATES] = {
 };
 
 void
-assign_Process(void) {
+assign_Process(bool bestFit) {
+	g_bestFit = bestFit;
+
 	for (int i = 0; i < TOTAL_PREDICATES; ++i) {
 		intptr_t pred = (intptr_t) sectionPredicates[i];
 
 		sect_ForEachUsedSection(assignOrgAndBankFixedSection, pred);
 		sect_ForEachUsedSection(assignOrgFixedSection, pred);
-		sect_ForEachUsedSection(assignBankFixedSection, pred);
+		forEachFloatingSection(assignBankFixedSection, pred);
 		sect_ForEachUsedSection(assignAlignedSection, pred);
-		sect_ForEachUsedSection(assignSection, pred);
+		forEachFloatingSection(assignSection, pred);
 	}
 	sect_ForEachUsedSection(assignSection, (intptr_t) truePredicate);
 
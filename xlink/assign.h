@@ -19,7 +19,9 @@
 #ifndef XLINK_ASSIGN_H_INCLUDED_
 #define XLINK_ASSIGN_H_INCLUDED_
 
+#include "types.h"
+
 extern void
-assign_Process(void);
+assign_Process(bool bestFit);
 
 #endif
@@ -0,0 +1,289 @@
+/*  Copyright 2008-2022 Carsten Elton Sorensen and contributors
+
+    This file is part of ASMotor.
+
+    ASMotor is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ASMotor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The link cache is enabled with -i. It records the options, inputs and outputs of a link, so the
+ * next link can be skipped if the options and all input files are unchanged and the output files
+ * are intact. It is not an incremental link, if anything changed the link is done in full.
+ *
+ * A file whose size and modification time match the previous link is taken to be unchanged without
+ * reading it. Only files that fail that test are read to compare their CRC.
+ *
+ * Format:
+ *
+ * "XLC" BYTE Version (2)
+ * LONG    Fingerprint of the options
+ * LONG    NumberOfInputs
+ * REPT    NumberOfInputs
+ *         ASCIIZ  FileName
+ *         LONG    Size
+ *         LONG    Modified         ; 0 if too recent to be trusted
+ *         LONG    CRC32
+ * ENDR
+ * LONG    NumberOfOutputs
+ * REPT    NumberOfOutputs
+ *         ASCIIZ  FileName
+ *         LONG    Size
+ *         LONG    Modified         ; 0 if too recent to be trusted
+ *         LONG    CRC32
+ * ENDR
+ */
+
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+// From util
+#include "crc32.h"
+#include "file.h"
+#include "mem.h"
+#include "str.h"
+
+// From xlink
+#include "cache.h"
+#include "xlink.h"
+
+#define CACHE_VERSION 2
+
+typedef struct {
+    const char* fileName;
+    uint32_t size;
+    uint32_t modified;
+    uint32_t crc32;
+} SCachedFile;
+
+typedef struct {
+    uint32_t totalFiles;
+    SCachedFile* files;
+} SCachedFiles;
+
+typedef struct {
+    uint32_t fingerprint;
+    SCachedFiles inputs;
+    SCachedFiles outputs;
+} SLinkState;
+
+static const char* g_fileName = NULL;
+static bool g_havePrevious = false;
+static SLinkState g_previous;
+static SLinkState g_current;
+static time_t g_startTime = 0;
+
+static char*
+copyString(const char* s) {
+    size_t length = strlen(s) + 1;
+    char* copy = mem_Alloc(length);
+    memcpy(copy, s, length);
+    return copy;
+}
+
+static char*
+readFileName(FILE* fileHandle) {
+    string* fileName = fgetstr(fileHandle);
+    char* result = copyString(str_String(fileName));
+    str_Free(fileName);
+    return result;
+}
+
+static bool
+hashFile(const char* fileName, uint32_t* crc) {
+    FILE* fileHandle = fopen(fileName, "rb");
+    if (fileHandle == NULL)
+        return false;
+
+    size_t size = fsize(fileHandle);
+    uint8_t* data = mem_Alloc(size + 1);
+    bool result = fread(data, 1, size, fileHandle) == size;
+
+    *crc = crc32(data, size);
+
+    mem_Free(data);
+    fclose(fileHandle);
+
+    return result;
+}
+
+static bool
+sameState(const SCachedFile* file, const struct stat* status) {
+    return file->modified != 0 && (uint32_t) status->st_mtime == file->modified && (uint32_t) status->st_size == file->size;
+}
+
+static bool
+getFileState(const char* fileName, SCachedFile* file, const SCachedFile* previous) {
+    struct stat status;
+    if (stat(fileName, &status) != 0)
+        return false;
+
+    file->fileName = copyString(fileName);
+    file->size = (uint32_t) status.st_size;
+    file->modified = status.st_mtime < g_startTime ? (uint32_t) status.st_mtime : 0;
+
+    if (previous != NULL && strcmp(previous->fileName, fileName) == 0 && sameState(previous, &status)) {
+        file->crc32 = previous->crc32;
+        return true;
+    }
+
+    return hashFile(fileName, &file->crc32);
+}
+
+static void
+addFile(SCachedFiles* files, const char* fileName, const SCachedFiles* previousFiles) {
+    const SCachedFile* previous = g_havePrevious && files->totalFiles < previousFiles->totalFiles ? &previousFiles->files[files->totalFiles] : NULL;
+
+    files->files = mem_Realloc(files->files, sizeof(SCachedFile) * (files->totalFiles + 1));
+    if (!getFileState(fileName, &files->files[files->totalFiles], previous))
+        error("Unable to read \"%s\"", fileName);
+
+    ++files->totalFiles;
+}
+
+static bool
+equalFile(const SCachedFile* file1, const SCachedFile* file2) {
+    return strcmp(file1->fileName, file2->fileName) == 0 && file1->size == file2->size && file1->crc32 == file2->crc32;
+}
+
+static bool
+equalFiles(const SCachedFiles* files1, const SCachedFiles* files2) {
+    if (files1->totalFiles != files2->totalFiles)
+        return false;
+
+    for (uint32_t i = 0; i < files1->totalFiles; ++i) {
+        if (!equalFile(&files1->files[i], &files2->files[i]))
+            return false;
+    }
+
+    return true;
+}
+
+static bool
+filesIntact(const SCachedFiles* files) {
+    for (uint32_t i = 0; i < files->totalFiles; ++i) {
+        const SCachedFile* file = &files->files[i];
+
+        struct stat status;
+        if (stat(file->fileName, &status) != 0 || (uint32_t) status.st_size != file->size)
+            return false;
+
+        uint32_t crc;
+        if (!sameState(file, &status) && (!hashFile(file->fileName, &crc) || crc != file->crc32))
+            return false;
+    }
+
+    return true;
+}
+
+static void
+readFiles(FILE* fileHandle, SCachedFiles* files) {
+    files->totalFiles = fgetll(fileHandle);
+    files->files = mem_Alloc(sizeof(SCachedFile) * (files->totalFiles + 1));
+
+    for (uint32_t i = 0; i < files->totalFiles; ++i) {
+        SCachedFile* file = &files->files[i];
+        file->fileName = readFileName(fileHandle);
+        file->size = fgetll(fileHandle);
+        file->modified = fgetll(fileHandle);
+        file->crc32 = fgetll(fileHandle);
+    }
+}
+
+static void
+writeFiles(FILE* fileHandle, const SCachedFiles* files) {
+    fputll(files->totalFiles, fileHandle);
+
+    for (uint32_t i = 0; i < files->totalFiles; ++i) {
+        const SCachedFile* file = &files->files[i];
+        fputsz(file->fileName, fileHandle);
+        fputll(file->size, fileHandle);
+        fputll(file->modified, fileHandle);
+        fputll(file->crc32, fileHandle);
+    }
+}
+
+static bool
+readState(FILE* fileHandle, SLinkState* state) {
+    char id[4];
+    if (fread(id, 1, 4, fileHandle) != 4 || memcmp(id, "XLC", 3) != 0 || id[3] != CACHE_VERSION)
+        return false;
+
+    state->fingerprint = fgetll(fileHandle);
+    readFiles(fileHandle, &state->inputs);
+    readFiles(fileHandle, &state->outputs);
+
+    return !feof(fileHandle) && !ferror(fileHandle);
+}
+
+
+/* Exported functions */
+
+extern void
+cache_Open(const char* fileName) {
+    g_fileName = fileName;
+    g_startTime = time(NULL);
+    g_current.fingerprint = crc32((const uint8_t*) ASMOTOR_VERSION, strlen(ASMOTOR_VERSION));
+
+    FILE* fileHandle = fopen(fileName, "rb");
+    if (fileHandle != NULL) {
+        g_havePrevious = readState(fileHandle, &g_previous);
+        fclose(fileHandle);
+    }
+}
+
+extern void
+cache_AddOption(const char* option) {
+    if (g_fileName != NULL)
+        g_current.fingerprint = g_current.fingerprint * 31 + crc32((const uint8_t*) option, strlen(option));
+}
+
+extern void
+cache_AddInput(const char* fileName) {
+    if (g_fileName != NULL)
+        addFile(&g_current.inputs, fileName, &g_previous.inputs);
+}
+
+extern void
+cache_AddOutput(const char* fileName) {
+    if (g_fileName != NULL)
+        addFile(&g_current.outputs, fileName, &g_previous.outputs);
+}
+
+extern bool
+cache_IsUpToDate(void) {
+    return g_fileName != NULL && g_havePrevious
+        && g_previous.fingerprint == g_current.fingerprint
+        && equalFiles(&g_previous.inputs, &g_current.inputs)
+        && g_previous.outputs.totalFiles > 0
+        && filesIntact(&g_previous.outputs);
+}
+
+extern void
+cache_Write(void) {
+    if (g_fileName == NULL)
+        return;
+
+    FILE* fileHandle = fopen(g_fileName, "wb");
+    if (fileHandle == NULL)
+        error("Unable to open \"%s\" for writing", g_fileName);
+
+    fwrite("XLC", 1, 3, fileHandle);
+    fputc(CACHE_VERSION, fileHandle);
+    fputll(g_current.fingerprint, fileHandle);
+    writeFiles(fileHandle, &g_current.inputs);
+    writeFiles(fileHandle, &g_current.outputs);
+
+    fclose(fileHandle);
+}
@@ -0,0 +1,45 @@
+/*  Copyright 2008-2022 Carsten Elton Sorensen and contributors
+
+    This file is part of ASMotor.
+
+    ASMotor is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ASMotor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef XLINK_CACHE_H_INCLUDED_
+#define XLINK_CACHE_H_INCLUDED_
+
+#include "types.h"
+
+// Enables the link cache and reads the state of the previous link from fileName, if present
+extern void
+cache_Open(const char* fileName);
+
+// Adds an option to the fingerprint of the link configuration
+extern void
+cache_AddOption(const char* option);
+
+extern void
+cache_AddInput(const char* fileName);
+
+extern void
+cache_AddOutput(const char* fileName);
+
+// Returns true if the previous link had the same configuration and inputs, and its outputs are intact
+extern bool
+cache_IsUpToDate(void);
+
+extern void
+cache_Write(void);
+
+#endif
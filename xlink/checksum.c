@@ -0,0 +1,86 @@
+/*  Copyright 2008-2022 Carsten Elton Sorensen and contributors
+
+    This file is part of ASMotor.
+
+    ASMotor is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ASMotor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Checksum kernels used when finalizing ROM images. SSE2 is used when the compiler targets it,
+ * processing 16 bytes at a time with SAD instructions, otherwise the plain loops are used.
+ */
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define CHECKSUM_SSE2
+#   include <emmintrin.h>
+#endif
+
+#include "checksum.h"
+
+#if defined(CHECKSUM_SSE2)
+static uint32_t
+horizontalSum(__m128i sums) {
+    return (uint32_t) _mm_cvtsi128_si32(sums) + (uint32_t) _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+}
+#endif
+
+extern uint32_t
+checksum_SumBytes(const uint8_t* data, size_t length) {
+    uint32_t sum = 0;
+    size_t i = 0;
+
+#if defined(CHECKSUM_SSE2)
+    __m128i zero = _mm_setzero_si128();
+    __m128i sums = zero;
+
+    for (; i + 16 <= length; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*) &data[i]);
+        sums = _mm_add_epi64(sums, _mm_sad_epu8(bytes, zero));
+    }
+
+    sum = horizontalSum(sums);
+#endif
+
+    for (; i < length; ++i)
+        sum += data[i];
+
+    return sum;
+}
+
+extern uint16_t
+checksum_SumBigEndianWords(const uint8_t* data, size_t length) {
+    uint16_t sum = 0;
+    size_t i = 0;
+
+#if defined(CHECKSUM_SSE2)
+    // The high byte of each word is at an even offset, the low byte at an odd offset
+    __m128i zero = _mm_setzero_si128();
+    __m128i evenMask = _mm_set1_epi16(0x00FF);
+    __m128i highSums = zero;
+    __m128i lowSums = zero;
+
+    for (; i + 16 <= length; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*) &data[i]);
+        highSums = _mm_add_epi64(highSums, _mm_sad_epu8(_mm_and_si128(bytes, evenMask), zero));
+        lowSums = _mm_add_epi64(lowSums, _mm_sad_epu8(_mm_srli_epi16(bytes, 8), zero));
+    }
+
+    sum = (uint16_t) ((horizontalSum(highSums) << 8u) + horizontalSum(lowSums));
+#endif
+
+    for (; i + 1 < length; i += 2)
+        sum += (uint16_t) (data[i] << 8u | data[i + 1]);
+
+    return sum;
+}
@@ -0,0 +1,34 @@
+/*  Copyright 2008-2022 Carsten Elton Sorensen and contributors
+
+    This file is part of ASMotor.
+
+    ASMotor is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ASMotor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef XLINK_CHECKSUM_H_INCLUDED_
+#define XLINK_CHECKSUM_H_INCLUDED_
+
+#include <stddef.h>
+
+#include "types.h"
+
+// Sum of all bytes, modulo 2^32
+extern uint32_t
+checksum_SumBytes(const uint8_t* data, size_t length);
+
+// Sum of all big endian 16 bit words, a trailing odd byte is ignored
+extern uint16_t
+checksum_SumBigEndianWords(const uint8_t* data, size_t length);
+
+#endif
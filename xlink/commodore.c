@@ -97,9 +97,7 @@ writeHeader(FILE* fileHandle, const char* entry, uint32_t baseAddress) {
 
 extern void
 commodore_WritePrg(const char* outputFilename, const char* entry, uint32_t baseAddress) {
-    FILE* fileHandle = fopen(outputFilename, "wb");
-    if (fileHandle == NULL)
-        error("Unable to open \"%s\" for writing", outputFilename);
+    FILE* fileHandle = image_OpenFile(outputFilename);
 
     writeHeader(fileHandle, entry, baseAddress);
 
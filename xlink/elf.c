@@ -810,9 +810,6 @@ sectionToXlink(const ElfHeader* elf, const ElfSectionHeader* header, uint32_t se
 	section->totalSymbols = 0;
 	section->symbols = NULL;
 
-	section->totalLineMappings = 0;
-	section->lineMappings = NULL;
-
 	section->size = header->sh_size;
 	if (header->sh_type == SHT_PROGBITS) {
 		section->data = mem_Alloc(section->size);
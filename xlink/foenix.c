@@ -81,17 +81,9 @@ writePGZSections(FILE* fileHandle) {
 }
 
 
-static void
-writeRepeatedBytes(FILE* fileHandle, uint32_t offset, int bytes) {
-    fseek(fileHandle, offset, SEEK_SET);
-	ffill(0xFF, bytes, fileHandle);
-}
-
-
 static void
 writeKUPSections(FILE* fileHandle, int firstSlot, bool pad) {
-	int imageStart = firstSlot * 8192;
-    uint32_t currentFileSize = ftell(fileHandle);
+	uint32_t imageStart = firstSlot * F256_SLOT_SIZE;
 
     for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
         //	This is a special exported EQU symbol section
@@ -99,29 +91,13 @@ writeKUPSections(FILE* fileHandle, int firstSlot, bool pad) {
             continue;
 
         if (section->used && section->assigned && section->imageLocation != -1 && section->group->type != GROUP_BSS) {
-			if (section->imageLocation < imageStart + F256_HEADER_SIZE) {
+			if ((uint32_t) section->imageLocation < imageStart + F256_HEADER_SIZE) {
 				error("Section \"%s\" overlaps header", section->name);
 			}
-
-            uint32_t startOffset = section->imageLocation - imageStart;
-            uint32_t endOffset = startOffset + section->size;
-
-            if (startOffset > currentFileSize) {
-                fseek(fileHandle, currentFileSize, SEEK_SET);
-                writeRepeatedBytes(fileHandle, currentFileSize, startOffset - currentFileSize);
-            }
-
-            fseek(fileHandle, startOffset, SEEK_SET);
-            fwrite(section->data, 1, section->size, fileHandle);
-            if (endOffset > currentFileSize)
-                currentFileSize = endOffset;
         }
     }
 
-	if (pad) {
-		int bytesToPad = F256_SLOT_SIZE - currentFileSize % F256_SLOT_SIZE;
-		writeRepeatedBytes(fileHandle, currentFileSize, bytesToPad);
-	}
+	image_WriteSections(fileHandle, imageStart + F256_HEADER_SIZE, pad ? F256_SLOT_SIZE : -1);
 }
 
 
@@ -156,10 +132,7 @@ foenix_WriteExecutablePGZ(const char* outputFilename, const char* entry) {
 
 extern void
 foenix_WriteExecutableKUP(const char* outputFilename, const char* entry, bool pad) {
-	FILE* fileHandle = fopen(outputFilename, "wb");
-	if (fileHandle == NULL) {
-		error("Unable to open \"%s\" for writing", outputFilename);
-	}
+	FILE* fileHandle = image_OpenFile(outputFilename);
 
 	// Start address section
     int startAddress = 0;
@@ -16,9 +16,11 @@
     along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include "file.h"
+#include <string.h>
+
 #include "types.h"
 
+#include "checksum.h"
 #include "gameboy.h"
 #include "image.h"
 #include "xlink.h"
@@ -37,113 +39,92 @@ static uint8_t g_nintendoChar[48] = {
 };
 
 static void
-updateNintendoCharacterArea(FILE* fileHandle) {
-    fseek(fileHandle, POS_NINTENDO_LOGO, SEEK_SET);
-    fwrite(g_nintendoChar, sizeof(uint8_t), sizeof(g_nintendoChar), fileHandle);
+updateNintendoCharacterArea(SImage* image) {
+    image_Extend(image, POS_NINTENDO_LOGO + sizeof(g_nintendoChar));
+    memcpy(&image->data[POS_NINTENDO_LOGO], g_nintendoChar, sizeof(g_nintendoChar));
+}
+
+static uint8_t
+readByte(const SImage* image, uint32_t offset) {
+    return offset < image->size ? image->data[offset] : 0x00;
 }
 
 static void
-updateRomSize(FILE* fileHandle) {
-    fflush(fileHandle);
-    fseek(fileHandle, POS_ROM_SIZE, SEEK_SET);
+writeByte(SImage* image, uint32_t offset, uint8_t value) {
+    image_Extend(image, offset + 1);
+    image->data[offset] = value;
+}
 
-    int cartRomSize = fgetc(fileHandle);
-    if (cartRomSize == EOF)
-        cartRomSize = 0x00;
+static void
+updateRomSize(SImage* image) {
+    uint8_t cartRomSize = readByte(image, POS_ROM_SIZE);
 
     uint8_t calculatedRomSize = 0;
-    size_t romSize = fsize(fileHandle);
-    while (romSize > (0x8000UL << calculatedRomSize))
+    while (image->size > (0x8000UL << calculatedRomSize))
         ++calculatedRomSize;
 
-    if (calculatedRomSize != cartRomSize) {
-        fseek(fileHandle, POS_ROM_SIZE, SEEK_SET);
-        fwrite(&calculatedRomSize, 1, 1, fileHandle);
-    }
+    if (calculatedRomSize != cartRomSize)
+        writeByte(image, POS_ROM_SIZE, calculatedRomSize);
 }
 
 static void
-updateCartridgeType(FILE* fileHandle) {
-    fseek(fileHandle, POS_CARTRIDGE_TYPE, SEEK_SET);
-
-    int cartType = fgetc(fileHandle);
-    if (cartType == EOF)
-        cartType = 0x00;
+updateCartridgeType(SImage* image) {
+    uint8_t cartType = readByte(image, POS_CARTRIDGE_TYPE);
 
-    if (fsize(fileHandle) <= 0x8000UL || cartType != 0x00) {
+    if (image->size <= 0x8000UL || cartType != 0x00) {
         // cart type byte can be anything
         return;
     }
 
-    cartType = 0x01;
-    fseek(fileHandle, POS_CARTRIDGE_TYPE, SEEK_SET);
-    fwrite(&cartType, 1, 1, fileHandle);
+    writeByte(image, POS_CARTRIDGE_TYPE, 0x01);
+}
+
+static uint16_t
+sumBytes(const SImage* image, uint32_t start, uint32_t end) {
+    if (end > image->size)
+        end = image->size;
+
+    return start < end ? (uint16_t) checksum_SumBytes(&image->data[start], end - start) : 0;
 }
 
 static void
-updateChecksum(FILE* fileHandle) {
-    size_t romSize = fsize(fileHandle);
-
-    uint16_t cartChecksum = 0;
-    uint16_t calculatedChecksum = 0;
-    uint8_t cartCompChecksum = 0;
-    uint8_t calculatedCompChecksum = 0;
-
-    fseek(fileHandle, 0, SEEK_SET);
-
-    for (size_t i = 0; i < romSize; ++i) {
-        int ch = fgetc(fileHandle);
-        if (ch == EOF)
-            ch = 0;
-
-        if (i < 0x0134L) {
-            calculatedChecksum += (uint16_t) ch;
-        } else if (i < 0x014DL) {
-            calculatedCompChecksum += (uint8_t) ch;
-            calculatedChecksum += (uint16_t) ch;
-        } else if (i == 0x014DL) {
-            cartCompChecksum = (uint8_t) ch;
-        } else if (i == 0x014EL) {
-            cartChecksum = (uint16_t) ch << 8U;
-        } else if (i == 0x014FL) {
-            cartChecksum |= (uint16_t) ch;
-        } else {
-            calculatedChecksum += (uint16_t) ch;
-        }
-    }
+updateChecksum(SImage* image) {
+    uint8_t cartCompChecksum = readByte(image, POS_COMP_CHECKSUM);
+    uint16_t cartChecksum = (uint16_t) (readByte(image, POS_CHECKSUM) << 8U | readByte(image, POS_CHECKSUM + 1));
 
-    calculatedCompChecksum = (uint8_t) (0xE7U - calculatedCompChecksum);
-    calculatedChecksum += calculatedCompChecksum;
+    uint8_t calculatedCompChecksum = (uint8_t) (0xE7U - sumBytes(image, POS_CARTRIDGE_TITLE, POS_COMP_CHECKSUM));
+    uint16_t calculatedChecksum = sumBytes(image, 0, POS_COMP_CHECKSUM) + sumBytes(image, POS_CHECKSUM + 2, image->size) + calculatedCompChecksum;
 
     if (cartChecksum != calculatedChecksum) {
-        fseek(fileHandle, POS_CHECKSUM, SEEK_SET);
-        fputc(calculatedChecksum >> 8U, fileHandle);
-        fputc(calculatedChecksum & 0xFFU, fileHandle);
+        writeByte(image, POS_CHECKSUM, (uint8_t) (calculatedChecksum >> 8U));
+        writeByte(image, POS_CHECKSUM + 1, (uint8_t) (calculatedChecksum & 0xFFU));
     }
 
-    if (cartCompChecksum != calculatedCompChecksum) {
-        fseek(fileHandle, POS_COMP_CHECKSUM, SEEK_SET);
-        fwrite(&calculatedCompChecksum, 1, 1, fileHandle);
-    }
+    if (cartCompChecksum != calculatedCompChecksum)
+        writeByte(image, POS_COMP_CHECKSUM, calculatedCompChecksum);
 }
 
 static void
-updateGameBoyHeader(FILE* fileHandle) {
-    updateNintendoCharacterArea(fileHandle);
-    updateRomSize(fileHandle);
-    updateCartridgeType(fileHandle);
-    updateChecksum(fileHandle);
+updateGameBoyHeader(SImage* image) {
+    updateNintendoCharacterArea(image);
+    updateRomSize(image);
+    updateCartridgeType(image);
+    updateChecksum(image);
 }
 
 void
 gameboy_WriteImage(const char* outputFilename) {
-    FILE* fileHandle = fopen(outputFilename, "w+b");
+    FILE* fileHandle = fopen(outputFilename, "wb");
     if (fileHandle == NULL)
         error("Unable to open \"%s\" for writing", outputFilename);
 
-    image_WriteBinaryToFile(fileHandle, 0);
+    SImage image;
+    image_Compose(&image, 0, 0);
+
+    updateGameBoyHeader(&image);
 
-    updateGameBoyHeader(fileHandle);
+    image_Write(&image, fileHandle);
+    image_Free(&image);
 
     fclose(fileHandle);
 }
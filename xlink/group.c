@@ -28,59 +28,250 @@
 
 #define HC800_MAX_BANKS 128
 
-typedef struct MemoryChunk_ {
-    struct MemoryChunk_* nextChunk;
+#define CHUNKS_PER_BLOCK 64U
+#define NO_CHUNK UINT32_MAX
 
+typedef struct MemoryChunk_ {
     uint32_t cpuByteLocation;
     uint32_t size;
 } MemoryChunk;
 
+typedef struct MemoryChunkBlock_ {
+    struct MemoryChunkBlock_* nextBlock;
+    uint32_t totalChunks;
+    MemoryChunk chunks[CHUNKS_PER_BLOCK];
+} MemoryChunkBlock;
+
 static MemoryGroup* s_machineGroups = NULL;
 
+static MemoryChunk*
+pool_NewChunk(MemoryPool* pool, uint32_t cpuByteLocation, uint32_t size) {
+    MemoryChunkBlock* block = pool->chunkBlocks;
+
+    if (block == NULL || block->totalChunks == CHUNKS_PER_BLOCK) {
+        block = (MemoryChunkBlock*) mem_Alloc(sizeof(MemoryChunkBlock));
+        block->nextBlock = pool->chunkBlocks;
+        block->totalChunks = 0;
+        pool->chunkBlocks = block;
+    }
+
+    MemoryChunk* chunk = &block->chunks[block->totalChunks++];
+    chunk->cpuByteLocation = cpuByteLocation;
+    chunk->size = size;
+
+    return chunk;
+}
+
+static uint32_t
+pool_LowerBoundBySize(MemoryPool* pool, uint32_t size, uint32_t cpuByteLocation) {
+    uint32_t low = 0;
+    uint32_t high = pool->totalChunksBySize;
+
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        MemoryChunk* chunk = pool->chunksBySize[middle];
+
+        if (chunk->size < size || (chunk->size == size && chunk->cpuByteLocation < cpuByteLocation))
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+static void
+pool_IndexChunk(MemoryPool* pool, MemoryChunk* chunk) {
+    if (chunk->size == 0)
+        return;
+
+    if (pool->totalChunksBySize == pool->chunksBySizeCapacity) {
+        pool->chunksBySizeCapacity = pool->chunksBySizeCapacity == 0 ? 8 : pool->chunksBySizeCapacity * 2;
+        pool->chunksBySize = (MemoryChunk**) mem_Realloc(pool->chunksBySize, sizeof(MemoryChunk*) * pool->chunksBySizeCapacity);
+    }
+
+    uint32_t index = pool_LowerBoundBySize(pool, chunk->size, chunk->cpuByteLocation);
+    memmove(&pool->chunksBySize[index + 1], &pool->chunksBySize[index], sizeof(MemoryChunk*) * (pool->totalChunksBySize - index));
+    pool->chunksBySize[index] = chunk;
+    pool->totalChunksBySize += 1;
+}
+
+static void
+pool_UnindexChunk(MemoryPool* pool, MemoryChunk* chunk) {
+    if (chunk->size == 0)
+        return;
+
+    uint32_t index = pool_LowerBoundBySize(pool, chunk->size, chunk->cpuByteLocation);
+    pool->totalChunksBySize -= 1;
+    memmove(&pool->chunksBySize[index], &pool->chunksBySize[index + 1], sizeof(MemoryChunk*) * (pool->totalChunksBySize - index));
+}
+
+static MemoryChunk*
+pool_FindBestFit(MemoryPool* pool, uint32_t size) {
+    uint32_t index = pool_LowerBoundBySize(pool, size, 0);
+    return index < pool->totalChunksBySize ? pool->chunksBySize[index] : NULL;
+}
+
+static void
+pool_UpdateLargestChunk(MemoryPool* pool, uint32_t index) {
+    uint32_t* largest = pool->largestChunks;
+    uint32_t node = index + pool->chunksCapacity;
+
+    largest[node] = pool->chunks[index]->size;
+    for (node >>= 1u; node != 0; node >>= 1u)
+        largest[node] = largest[node * 2] > largest[node * 2 + 1] ? largest[node * 2] : largest[node * 2 + 1];
+}
+
+static void
+pool_RebuildLargestChunks(MemoryPool* pool, uint32_t firstIndex) {
+    // Rebuild the tree for chunks from firstIndex and onwards
+    uint32_t* largest = pool->largestChunks;
+    uint32_t first = firstIndex + pool->chunksCapacity;
+    uint32_t last = pool->totalChunks - 1 + pool->chunksCapacity;
+
+    for (uint32_t node = first; node <= last; ++node)
+        largest[node] = pool->chunks[node - pool->chunksCapacity]->size;
+
+    for (first >>= 1u, last >>= 1u; first != 0; first >>= 1u, last >>= 1u) {
+        for (uint32_t node = first; node <= last; ++node)
+            largest[node] = largest[node * 2] > largest[node * 2 + 1] ? largest[node * 2] : largest[node * 2 + 1];
+    }
+}
+
+static void
+pool_InsertChunk(MemoryPool* pool, uint32_t index, MemoryChunk* chunk) {
+    uint32_t rebuildIndex = index;
+
+    if (pool->totalChunks == pool->chunksCapacity) {
+        pool->chunksCapacity = pool->chunksCapacity == 0 ? 8 : pool->chunksCapacity * 2;
+        pool->chunks = (MemoryChunk**) mem_Realloc(pool->chunks, sizeof(MemoryChunk*) * pool->chunksCapacity);
+        pool->largestChunks = (uint32_t*) mem_Realloc(pool->largestChunks, sizeof(uint32_t) * pool->chunksCapacity * 2);
+
+        // The tree's leaves have moved, everything must be rebuilt
+        memset(pool->largestChunks, 0, sizeof(uint32_t) * pool->chunksCapacity * 2);
+        rebuildIndex = 0;
+    }
+
+    memmove(&pool->chunks[index + 1], &pool->chunks[index], sizeof(MemoryChunk*) * (pool->totalChunks - index));
+    pool->chunks[index] = chunk;
+    pool->totalChunks += 1;
+
+    pool_RebuildLargestChunks(pool, rebuildIndex);
+    pool_IndexChunk(pool, chunk);
+}
+
+static void
+pool_ResizeChunk(MemoryPool* pool, uint32_t index, uint32_t cpuByteLocation, uint32_t size) {
+    MemoryChunk* chunk = pool->chunks[index];
+
+    pool_UnindexChunk(pool, chunk);
+    chunk->cpuByteLocation = cpuByteLocation;
+    chunk->size = size;
+    pool_IndexChunk(pool, chunk);
+
+    pool_UpdateLargestChunk(pool, index);
+}
+
+static uint32_t
+pool_ChunkIndex(MemoryPool* pool, MemoryChunk* chunk) {
+    uint32_t low = 0;
+    uint32_t high = pool->totalChunks;
+
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (pool->chunks[middle]->cpuByteLocation < chunk->cpuByteLocation)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    // Empty chunks may share the location
+    while (pool->chunks[low] != chunk)
+        ++low;
+
+    return low;
+}
+
+static uint32_t
+pool_FindChunk(MemoryPool* pool, uint32_t firstIndex, uint32_t size) {
+    // Find the first chunk, from firstIndex and in location order, that is at least size bytes
+    uint32_t* largest = pool->largestChunks;
+
+    if (firstIndex >= pool->totalChunks)
+        return NO_CHUNK;
+
+    uint32_t node = firstIndex + pool->chunksCapacity;
+    if (largest[node] < size) {
+        for (;;) {
+            while (node & 1u)
+                node >>= 1u;
+
+            if (node == 0)
+                return NO_CHUNK;
+
+            node += 1;
+            if (largest[node] >= size)
+                break;
+        }
+
+        while (node < pool->chunksCapacity)
+            node = largest[node * 2] >= size ? node * 2 : node * 2 + 1;
+    }
+
+    uint32_t index = node - pool->chunksCapacity;
+    return index < pool->totalChunks ? index : NO_CHUNK;
+}
+
 static bool
 pool_AllocateMemory(MemoryPool* pool, uint32_t size, int32_t* cpuByteLocation) {
-    for (MemoryChunk* chunk = pool->freeChunks; chunk != NULL; chunk = chunk->nextChunk) {
-        if (chunk->size >= size) {
-            *cpuByteLocation = chunk->cpuByteLocation;
+    uint32_t index = pool_FindChunk(pool, 0, size);
 
-            chunk->cpuByteLocation += size;
-            chunk->size -= size;
+    if (index != NO_CHUNK) {
+        MemoryChunk* chunk = pool->chunks[index];
+        *cpuByteLocation = chunk->cpuByteLocation;
 
-            return true;
-        }
+        pool_ResizeChunk(pool, index, chunk->cpuByteLocation + size, chunk->size - size);
+
+        return true;
     }
 
     return false;
 }
 
 static void
-pool_CarveRange(MemoryChunk* chunk, uint32_t size, uint32_t cpuByteLocation) {
+pool_CarveRange(MemoryPool* pool, uint32_t index, uint32_t size, uint32_t cpuByteLocation) {
+	MemoryChunk* chunk = pool->chunks[index];
+
 	if (cpuByteLocation == chunk->cpuByteLocation) {
-		chunk->cpuByteLocation += size;
-		chunk->size -= size;
+		pool_ResizeChunk(pool, index, chunk->cpuByteLocation + size, chunk->size - size);
 	} else {
-		MemoryChunk* newChunk = (MemoryChunk*) mem_Alloc(sizeof(MemoryChunk));
-
-		newChunk->nextChunk = chunk->nextChunk;
-		chunk->nextChunk = newChunk;
-
-		newChunk->cpuByteLocation = cpuByteLocation + size;
-		newChunk->size = chunk->cpuByteLocation + chunk->size - (cpuByteLocation + size);
+		uint32_t chunkEnd = chunk->cpuByteLocation + chunk->size;
 
-		chunk->size = cpuByteLocation - chunk->cpuByteLocation;
+		pool_ResizeChunk(pool, index, chunk->cpuByteLocation, cpuByteLocation - chunk->cpuByteLocation);
+		pool_InsertChunk(pool, index + 1, pool_NewChunk(pool, cpuByteLocation + size, chunkEnd - (cpuByteLocation + size)));
 	}
 }
 
 
 static bool
 pool_AllocateAbsolute(MemoryPool* pool, uint32_t size, uint32_t cpuByteLocation) {
-    for (MemoryChunk* chunk = pool->freeChunks; chunk != NULL; chunk = chunk->nextChunk) {
-        if (cpuByteLocation >= chunk->cpuByteLocation
-            && cpuByteLocation + size <= chunk->cpuByteLocation + chunk->size) {
+    // Chunks are ordered, the first chunk ending at or after the range is the only one that may contain it
+    uint32_t low = 0;
+    uint32_t high = pool->totalChunks;
+
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        MemoryChunk* chunk = pool->chunks[middle];
+
+        if (chunk->cpuByteLocation + chunk->size < cpuByteLocation + size)
+            low = middle + 1;
+        else
+            high = middle;
+    }
 
-			pool_CarveRange(chunk, size, cpuByteLocation);
-            return true;
-        }
+    if (low < pool->totalChunks && cpuByteLocation >= pool->chunks[low]->cpuByteLocation) {
+        pool_CarveRange(pool, low, size, cpuByteLocation);
+        return true;
     }
 
     return false;
@@ -88,13 +279,15 @@ pool_AllocateAbsolute(MemoryPool* pool, uint32_t size, uint32_t cpuByteLocation)
 
 static bool
 pool_AllocateAligned(MemoryPool* pool, uint32_t size, uint32_t byteAlign, int32_t* resultLocation) {
-    for (MemoryChunk* chunk = pool->freeChunks; chunk != NULL; chunk = chunk->nextChunk) {
+    for (uint32_t index = pool_FindChunk(pool, 0, size); index != NO_CHUNK; index = pool_FindChunk(pool, index + 1, size)) {
+        MemoryChunk* chunk = pool->chunks[index];
+
 		uint32_t cpuByteLocation = chunk->cpuByteLocation + byteAlign - 1;
 		cpuByteLocation -= cpuByteLocation % byteAlign;
         if (cpuByteLocation >= chunk->cpuByteLocation
             && cpuByteLocation + size <= chunk->cpuByteLocation + chunk->size) {
 
-			pool_CarveRange(chunk, size, cpuByteLocation);
+			pool_CarveRange(pool, index, size, cpuByteLocation);
 
 			*resultLocation = cpuByteLocation;
             return true;
@@ -152,6 +345,38 @@ group_AllocateMemoryFromGroup(MemoryGroup* group, uint32_t size, int32_t bankId,
     return false;
 }
 
+static bool
+group_AllocateBestFitFromGroup(MemoryGroup* group, uint32_t size, int32_t bankId, int32_t* cpuByteLocation,
+                               int32_t* cpuBank, int32_t* imageLocation) {
+    if (size == 0)
+        return group_AllocateMemoryFromGroup(group, size, bankId, cpuByteLocation, cpuBank, imageLocation);
+
+    MemoryPool* bestPool = NULL;
+    MemoryChunk* bestChunk = NULL;
+
+    for (int32_t i = 0; i < group->totalPools; ++i) {
+        MemoryPool* pool = group->pools[i];
+
+        if (!pool->onlyAbs && (bankId == -1 || bankId == pool->cpuBank)) {
+            MemoryChunk* chunk = pool_FindBestFit(pool, size);
+            if (chunk != NULL && (bestChunk == NULL || chunk->size < bestChunk->size)) {
+                bestPool = pool;
+                bestChunk = chunk;
+            }
+        }
+    }
+
+    if (bestChunk == NULL)
+        return false;
+
+    *cpuByteLocation = bestChunk->cpuByteLocation;
+    *cpuBank = bestPool->cpuBank;
+    *imageLocation = bestPool->imageLocation == -1 ? -1 : bestPool->imageLocation + *cpuByteLocation - (int32_t) bestPool->cpuByteLocation;
+
+    pool_ResizeChunk(bestPool, pool_ChunkIndex(bestPool, bestChunk), bestChunk->cpuByteLocation + size, bestChunk->size - size);
+    return true;
+}
+
 static bool
 group_AllocateAbsoluteFromGroup(MemoryGroup* group, uint32_t size, int32_t bankId, int32_t cpuByteLocation,
                                 int32_t* cpuBank, int32_t* imageLocation) {
@@ -193,11 +418,9 @@ group_InitMemoryChunks(void) {
         for (int32_t i = 0; i < group->totalPools; ++i) {
             MemoryPool* pool = group->pools[i];
 
-            if ((pool->freeChunks = (MemoryChunk*) mem_Alloc(sizeof(MemoryChunk))) != NULL) {
-                pool->freeChunks->cpuByteLocation = pool->cpuByteLocation;
-                pool->freeChunks->size = pool->size;
-                pool->freeChunks->nextChunk = NULL;
-            }
+            // Pools may be shared by several groups
+            if (pool->chunks == NULL)
+                pool_InsertChunk(pool, 0, pool_NewChunk(pool, pool->cpuByteLocation, pool->size));
         }
     }
 }
@@ -229,7 +452,14 @@ pool_Create(int32_t imageLocation, uint32_t cpuByteLocation, int32_t cpuBank, ui
     pool->size = size;
 	pool->onlyAbs = onlyAbs;
 
-    pool->freeChunks = NULL;
+    pool->chunkBlocks = NULL;
+    pool->chunks = NULL;
+    pool->largestChunks = NULL;
+    pool->totalChunks = 0;
+    pool->chunksCapacity = 0;
+    pool->chunksBySize = NULL;
+    pool->totalChunksBySize = 0;
+    pool->chunksBySizeCapacity = 0;
 
     return pool;
 }
@@ -237,13 +467,16 @@ pool_Create(int32_t imageLocation, uint32_t cpuByteLocation, int32_t cpuBank, ui
 
 extern void
 pool_Free(MemoryPool* pool) {
-	MemoryChunk* chunk = pool->freeChunks;
-	while (chunk != NULL) {
-		MemoryChunk* next = chunk->nextChunk;
-		mem_Free(chunk);
-		chunk = next;
+	MemoryChunkBlock* block = pool->chunkBlocks;
+	while (block != NULL) {
+		MemoryChunkBlock* next = block->nextBlock;
+		mem_Free(block);
+		block = next;
 	}
 
+	mem_Free(pool->chunks);
+	mem_Free(pool->largestChunks);
+	mem_Free(pool->chunksBySize);
 	mem_Free(pool);
 }
 
@@ -256,6 +489,13 @@ group_AllocateMemory(const char* groupName, uint32_t size, int32_t bankId, int32
 
 }
 
+bool
+group_AllocateBestFit(const char* groupName, uint32_t size, int32_t bankId, int32_t* cpuByteLocation, int32_t* cpuBank,
+                      int32_t* imageLocation) {
+    MemoryGroup* group = group_FindByName(groupName);
+    return group_AllocateBestFitFromGroup(group, size, bankId, cpuByteLocation, cpuBank, imageLocation);
+}
+
 bool
 group_AllocateAbsolute(const char* groupName, uint32_t size, int32_t bankId, int32_t cpuByteLocation, int32_t* cpuBank,
                        int32_t* imageLocation) {
@@ -270,6 +510,78 @@ group_AllocateAligned(const char* groupName, uint32_t size, int32_t bankId, int3
     return group_AllocateAlignedFromGroup(group, size, bankId, byteAlign, cpuByteLocation, cpuBank, imageLocation);
 }
 
+typedef struct {
+    FILE* fileHandle;
+    uint32_t totalUnused;
+} SFillReport;
+
+static void
+pool_WriteFillReport(MemoryPool* pool, intptr_t data) {
+    SFillReport* report = (SFillReport*) data;
+    uint32_t largest;
+    uint32_t used = pool->size - pool_FreeBytes(pool, &largest);
+
+    if (used == 0) {
+        ++report->totalUnused;
+        return;
+    }
+
+    uint32_t percent = pool->size != 0 ? (uint32_t) ((uint64_t) used * 100 / pool->size) : 0;
+
+    fprintf(report->fileHandle, "    Bank %3d $%06X-$%06X: %8u of %8u bytes used (%3u%%), largest free block %u bytes\n",
+            pool->cpuBank, pool->cpuByteLocation, pool->cpuByteLocation + pool->size - 1, used, pool->size, percent, largest);
+}
+
+extern uint32_t
+pool_FreeBytes(const MemoryPool* pool, uint32_t* outLargest) {
+    uint32_t free = 0;
+    uint32_t largest = 0;
+
+    for (uint32_t i = 0; i < pool->totalChunks; ++i) {
+        MemoryChunk* chunk = pool->chunks[i];
+        free += chunk->size;
+        if (chunk->size > largest)
+            largest = chunk->size;
+    }
+
+    *outLargest = largest;
+    return free;
+}
+
+extern void
+group_ForEachPool(void (* function)(MemoryPool*, intptr_t), intptr_t data) {
+    // Pools may be shared by several groups, visit each only once
+    for (MemoryGroup* group = s_machineGroups; group != NULL; group = group->nextGroup) {
+        for (int32_t i = 0; i < group->totalPools; ++i) {
+            MemoryPool* pool = group->pools[i];
+            bool visited = false;
+
+            for (MemoryGroup* previous = s_machineGroups; previous != NULL && !visited; previous = previous->nextGroup) {
+                int32_t total = previous == group ? i : previous->totalPools;
+                for (int32_t j = 0; j < total && !visited; ++j)
+                    visited = previous->pools[j] == pool;
+                if (previous == group)
+                    break;
+            }
+
+            if (!visited && pool->chunks != NULL)
+                function(pool, data);
+        }
+    }
+}
+
+extern void
+group_WriteFillReport(FILE* fileHandle) {
+    SFillReport report = {fileHandle, 0};
+
+    fprintf(fileHandle, "\nBank usage:\n");
+
+    group_ForEachPool(pool_WriteFillReport, (intptr_t) &report);
+
+    if (report.totalUnused != 0)
+        fprintf(fileHandle, "    %u unused banks not shown\n", report.totalUnused);
+}
+
 void
 group_SetupGameboy(void) {
     MemoryPool* codepools[256];
@@ -19,11 +19,14 @@
 #ifndef XLINK_GROUP_H_INCLUDED_
 #define XLINK_GROUP_H_INCLUDED_
 
+#include <stdio.h>
+
 #include "types.h"
 
 #include "symbol.h"
 
 struct MemoryChunk_;
+struct MemoryChunkBlock_;
 
 typedef struct {
     int32_t imageLocation;      // This pool's position in the ROM image, -1 if not written
@@ -32,7 +35,14 @@ typedef struct {
     uint32_t size;              // Size of pool seen from the CPU
 	bool onlyAbs;				// Only allow absolute placement, never allocate dynamically
 
-    struct MemoryChunk_* freeChunks;
+    struct MemoryChunkBlock_* chunkBlocks;	// Storage for free chunks
+    struct MemoryChunk_** chunks;			// Free chunks ordered by location
+    uint32_t* largestChunks;				// Tree of the largest free chunk size in each range of chunks
+    uint32_t totalChunks;
+    uint32_t chunksCapacity;
+    struct MemoryChunk_** chunksBySize;		// Non-empty free chunks ordered by size, then location
+    uint32_t totalChunksBySize;
+    uint32_t chunksBySizeCapacity;
 } MemoryPool;
 
 typedef struct MemoryGroup_ {
@@ -99,10 +109,24 @@ group_SetupCoCo(void);
 extern bool
 group_AllocateMemory(const char* groupName, uint32_t size, int32_t bankId, int32_t* cpuByteLocation, int32_t* cpuBank, int32_t* imageLocation);
 
+extern bool
+group_AllocateBestFit(const char* groupName, uint32_t size, int32_t bankId, int32_t* cpuByteLocation, int32_t* cpuBank, int32_t* imageLocation);
+
 extern bool
 group_AllocateAbsolute(const char* groupName, uint32_t size, int32_t bankId, int32_t cpuByteLocation, int32_t* cpuBank, int32_t* imageLocation);
 
 extern bool
 group_AllocateAligned(const char* groupName, uint32_t size, int32_t bankId, int32_t byteAlign, int32_t* cpuByteLocation, int32_t* cpuBank, int32_t* imageLocation);
 
+extern void
+group_WriteFillReport(FILE* fileHandle);
+
+// Calls function once for every pool used by the machine's groups, in group order
+extern void
+group_ForEachPool(void (* function)(MemoryPool*, intptr_t), intptr_t data);
+
+// Returns the number of free bytes in the pool, and the size of the largest free block in outLargest
+extern uint32_t
+pool_FreeBytes(const MemoryPool* pool, uint32_t* outLargest);
+
 #endif
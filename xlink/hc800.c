@@ -23,6 +23,7 @@
 #include "str.h"
 
 #include "xlink.h"
+#include "checksum.h"
 #include "hc800.h"
 #include "image.h"
 #include "section.h"
@@ -169,35 +170,31 @@ hc800_WriteExecutable(const char* outputFilename, uint8_t* configuration) {
 }
 
 static void
-updateKernalHeader(FILE* f) {
+updateKernalHeader(SImage* image) {
 	// Zero checksum byte
-	fseek(f, 7, SEEK_SET);
-	fputc(0, f);
+	image_Extend(image, 8);
+	image->data[7] = 0;
 
 	// Calculate checksum
-
-	fseek(f, 0, SEEK_SET);
-	int c;
-	int8_t checksum = 0;
-	while ((c = fgetc(f)) != EOF) {
-		checksum += c;
-	}
-	checksum = 0xA5 - checksum;
+	int8_t checksum = (int8_t) (0xA5 - checksum_SumBytes(image->data, image->size));
 
 	// Update checksum in image
-	fseek(f, 7, SEEK_SET);
-	fputc(checksum, f);
+	image->data[7] = checksum;
 }
 
 extern void
 hc800_WriteKernal(const char* outputFilename) {
-	FILE* fileHandle = fopen(outputFilename, "w+b");
+	FILE* fileHandle = fopen(outputFilename, "wb");
 	if (fileHandle == NULL)
 		error("Unable to open \"%s\" for writing", outputFilename);
 
-	image_WriteBinaryToFile(fileHandle, 0);
+	SImage image;
+	image_Compose(&image, 0, 0);
+
+	updateKernalHeader(&image);
 
-	updateKernalHeader(fileHandle);
+	image_Write(&image, fileHandle);
+	image_Free(&image);
 
 	fclose(fileHandle);
 }
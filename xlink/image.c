@@ -17,6 +17,7 @@
 */
 
 #include <memory.h>
+#include <stdlib.h>
 
 // From util
 #include "file.h"
@@ -24,75 +25,184 @@
 #include "mem.h"
 
 // From xlink
+#include "image.h"
 #include "section.h"
 #include "xlink.h"
 
-#define WRITE_BLOCK_SIZE 16384
+#define FILL_BLOCK_SIZE 0x10000u
+#define FILE_BUFFER_SIZE 0x100000u
+
+static bool
+containsSection(SSection* section) {
+    return section->used && section->assigned && section->imageLocation != -1
+        && !sect_IsEquSection(section) && section->group->type != GROUP_BSS;
+}
+
+static uint32_t
+paddingSize(uint32_t fileSize, int padding) {
+    if (padding == -1)
+        return 0;
+
+    return padding == 0 ? (2u << log2n(fileSize)) - fileSize : padding - fileSize % padding;
+}
+
+static void
+writeBytes(const void* data, size_t size, FILE* fileHandle) {
+    if (size != fwrite(data, 1, size, fileHandle))
+        error("Disk possibly full");
+}
 
 static void
-writeRepeatedBytes(FILE* fileHandle, void* data, uint32_t offset, int bytes) {
-    fseek(fileHandle, offset, SEEK_SET);
-    while (bytes > 0) {
-        uint32_t towrite = bytes > WRITE_BLOCK_SIZE ? WRITE_BLOCK_SIZE : bytes;
-        if (towrite != fwrite(data, 1, towrite, fileHandle))
-            error("Disk possibly full");
-        bytes -= towrite;
+writeFill(uint32_t size, FILE* fileHandle) {
+    static uint8_t fill[FILL_BLOCK_SIZE];
+
+    if (fill[0] != 0xFF)
+        memset(fill, 0xFF, sizeof(fill));
+
+    while (size > 0) {
+        uint32_t blockSize = size < FILL_BLOCK_SIZE ? size : FILL_BLOCK_SIZE;
+        writeBytes(fill, blockSize, fileHandle);
+        size -= blockSize;
     }
 }
 
-static void*
-allocEmptyBytes(void) {
-    void* data = (char*) mem_Alloc(WRITE_BLOCK_SIZE);
-    if (data == NULL)
-        error("Out of memory");
+static int
+compareImageLocations(const void* element1, const void* element2) {
+    const SSection* section1 = *(const SSection**) element1;
+    const SSection* section2 = *(const SSection**) element2;
+
+    if (section1->imageLocation != section2->imageLocation)
+        return section1->imageLocation < section2->imageLocation ? -1 : 1;
+
+    return section1->sectionId < section2->sectionId ? -1 : section1->sectionId > section2->sectionId;
+}
+
+static bool
+writesSection(SSection* section, uint32_t start) {
+    return containsSection(section) && section->size > 0 && (uint32_t) section->imageLocation >= start;
+}
+
+// Overlapping sections are rare, they are composed in memory so later sections win as in image_Compose
+static void
+writeComposedRange(FILE* fileHandle, uint32_t start, uint32_t end) {
+    uint8_t* data = mem_Alloc(end - start);
+    memset(data, 0xFF, end - start);
 
-    memset(data, 0xFF, WRITE_BLOCK_SIZE);
+    for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
+        if (writesSection(section, start))
+            memcpy(&data[section->imageLocation - start], section->data, section->size);
+    }
 
-    return data;
+    writeBytes(data, end - start, fileHandle);
+    mem_Free(data);
 }
 
 extern void
-image_WriteBinaryToFile(FILE* fileHandle, int padding) {
-    uint32_t headerSize = ftell(fileHandle);
-    char* emptyBytes = allocEmptyBytes();
-    uint32_t currentFileSize = headerSize;
+image_Extend(SImage* image, uint32_t size) {
+    if (size > image->size) {
+        image->data = mem_Realloc(image->data, size);
+        memset(&image->data[image->size], 0, size - image->size);
+        image->size = size;
+    }
+}
+
+extern void
+image_Compose(SImage* image, uint32_t headerSize, int padding) {
+    uint32_t imageSize = 0;
 
     for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
-        //	This is a special exported EQU symbol section
-        if (sect_IsEquSection(section))
-            continue;
-
-        if (section->used && section->assigned && section->imageLocation != -1 && section->group->type != GROUP_BSS) {
-            uint32_t startOffset = section->imageLocation + headerSize;
-            uint32_t endOffset = startOffset + section->size;
-
-            if (startOffset > currentFileSize) {
-                fseek(fileHandle, currentFileSize, SEEK_SET);
-                writeRepeatedBytes(fileHandle, emptyBytes, currentFileSize, startOffset - currentFileSize);
-            }
-
-            fseek(fileHandle, startOffset, SEEK_SET);
-            fwrite(section->data, 1, section->size, fileHandle);
-            if (endOffset > currentFileSize)
-                currentFileSize = endOffset;
-        }
+        if (containsSection(section) && section->imageLocation + section->size > imageSize)
+            imageSize = section->imageLocation + section->size;
     }
 
-    if (padding != -1) {
-        int bytesToPad =
-                padding == 0 ? (2u << log2n(currentFileSize)) - currentFileSize : padding - currentFileSize % padding;
-        writeRepeatedBytes(fileHandle, emptyBytes, currentFileSize, bytesToPad);
+    imageSize += paddingSize(headerSize + imageSize, padding);
+
+    image->size = imageSize;
+    image->data = mem_Alloc(imageSize);
+    memset(image->data, 0xFF, imageSize);
+
+    for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
+        if (containsSection(section) && section->size > 0)
+            memcpy(&image->data[section->imageLocation], section->data, section->size);
     }
+}
 
-    mem_Free(emptyBytes);
+extern void
+image_Write(const SImage* image, FILE* fileHandle) {
+    if (image->size != fwrite(image->data, 1, image->size, fileHandle))
+        error("Disk possibly full");
 }
 
 extern void
-image_WriteBinary(const char* outputFilename, int padding) {
+image_Free(SImage* image) {
+    mem_Free(image->data);
+    image->data = NULL;
+    image->size = 0;
+}
+
+extern void
+image_WriteSections(FILE* fileHandle, uint32_t start, int padding) {
+    uint32_t totalSections = 0;
+    for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
+        if (writesSection(section, start))
+            ++totalSections;
+    }
+
+    SSection** sections = mem_Alloc(sizeof(SSection*) * (totalSections + 1));
+    uint32_t index = 0;
+    for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
+        if (writesSection(section, start))
+            sections[index++] = section;
+    }
+
+    qsort(sections, totalSections, sizeof(SSection*), compareImageLocations);
+
+    bool overlapping = false;
+    uint32_t end = start;
+    for (uint32_t i = 0; i < totalSections; ++i) {
+        if ((uint32_t) sections[i]->imageLocation < end)
+            overlapping = true;
+        if (sections[i]->imageLocation + sections[i]->size > end)
+            end = sections[i]->imageLocation + sections[i]->size;
+    }
+
+    uint32_t fileSize = (uint32_t) ftell(fileHandle) + end - start;
+
+    if (overlapping) {
+        writeComposedRange(fileHandle, start, end);
+    } else {
+        uint32_t position = start;
+        for (uint32_t i = 0; i < totalSections; ++i) {
+            writeFill(sections[i]->imageLocation - position, fileHandle);
+            writeBytes(sections[i]->data, sections[i]->size, fileHandle);
+            position = sections[i]->imageLocation + sections[i]->size;
+        }
+    }
+
+    writeFill(paddingSize(fileSize, padding), fileHandle);
+
+    mem_Free(sections);
+}
+
+extern FILE*
+image_OpenFile(const char* outputFilename) {
     FILE* fileHandle = fopen(outputFilename, "wb");
     if (fileHandle == NULL)
         error("Unable to open \"%s\" for writing", outputFilename);
 
+    setvbuf(fileHandle, NULL, _IOFBF, FILE_BUFFER_SIZE);
+    return fileHandle;
+}
+
+extern void
+image_WriteBinaryToFile(FILE* fileHandle, int padding) {
+    image_WriteSections(fileHandle, 0, padding);
+}
+
+extern void
+image_WriteBinary(const char* outputFilename, int padding) {
+    FILE* fileHandle = image_OpenFile(outputFilename);
+
     image_WriteBinaryToFile(fileHandle, padding);
 
     fclose(fileHandle);
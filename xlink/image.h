@@ -21,12 +21,49 @@
 
 #include <stdio.h>
 
-/* padding:
+#include "types.h"
+
+typedef struct {
+    uint8_t* data;
+    uint32_t size;
+} SImage;
+
+/* Builds the image of all placed sections in memory, gaps are filled with $FF.
+ * headerSize is the number of bytes that precede the image in the file, which is
+ * taken into account when padding.
+ *
+ * padding:
  * -1 - no padding
  *  0 - pad length to power of two
  * >0 - pad length to multiple of argument
  */
 extern void
+image_Compose(SImage* image, uint32_t headerSize, int padding);
+
+// Grows the image to at least size bytes, new bytes are zero
+extern void
+image_Extend(SImage* image, uint32_t size);
+
+extern void
+image_Write(const SImage* image, FILE* fileHandle);
+
+extern void
+image_Free(SImage* image);
+
+/* Writes the image from location start onwards at the current position of the file,
+ * without composing it in memory. Sections are written in image order straight from
+ * their data, gaps and padding are filled with $FF. Padding is applied to the total
+ * file size, as in image_Compose.
+ */
+extern void
+image_WriteSections(FILE* fileHandle, uint32_t start, int padding);
+
+// Opens a file for writing an image, with a buffer large enough to coalesce small sections
+extern FILE*
+image_OpenFile(const char* name);
+
+// Writes the image at the current position of the file
+extern void
 image_WriteBinaryToFile(FILE* fileHandle, int padding);
 
 extern void
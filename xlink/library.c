@@ -0,0 +1,237 @@
+/*  Copyright 2008-2022 Carsten Elton Sorensen and contributors
+
+    This file is part of ASMotor.
+
+    ASMotor is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ASMotor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Indexed libraries ("XLB\1") are not read in full. Only the directory is read, members are
+ * linked on demand when they export a symbol that is imported by an already linked section.
+ */
+
+#include <string.h>
+
+// from util
+#include "file.h"
+#include "mem.h"
+#include "str.h"
+#include "strcoll.h"
+
+// from xlink
+#include "library.h"
+#include "object.h"
+#include "section.h"
+#include "xlink.h"
+
+struct Library;
+
+typedef struct LibraryMember {
+    struct Library* library;
+    uint32_t offset;
+    bool alwaysLinked;
+    bool linked;
+} SLibraryMember;
+
+typedef struct Library {
+    string* fileName;
+    FILE* fileHandle;
+    uint32_t totalMembers;
+    SLibraryMember* members;
+    struct Library* nextLibrary;
+} SLibrary;
+
+static SLibrary* g_libraries = NULL;
+static strmap_t* g_libraryExports = NULL;
+
+static void
+freeNothing(intptr_t userData, intptr_t element) {
+}
+
+static void
+mapInsertSymbol(strmap_t* map, const char* name, intptr_t value) {
+    string* key = str_Create(name);
+    intptr_t existing;
+    if (!strmap_Value(map, key, &existing))
+        strmap_Insert(map, key, value);
+    str_Free(key);
+}
+
+static void
+linkMember(SLibraryMember* member) {
+    SLibrary* library = member->library;
+
+    member->linked = true;
+
+    if (library->fileHandle == NULL) {
+        if ((library->fileHandle = fopen(str_String(library->fileName), "rb")) == NULL)
+            error("File \"%s\" not found", str_String(library->fileName));
+    }
+
+    fseek(library->fileHandle, member->offset, SEEK_SET);
+    obj_ReadModule(library->fileHandle);
+}
+
+static void
+addExportedSymbols(SSection* first, SSection* last, strmap_t* definedSymbols) {
+    for (SSection* section = first; section != NULL; section = section->nextSection) {
+        for (uint32_t i = 0; i < section->totalSymbols; ++i) {
+            if (section->symbols[i].type == SYM_EXPORT)
+                mapInsertSymbol(definedSymbols, section->symbols[i].name, 0);
+        }
+        if (section == last)
+            break;
+    }
+}
+
+static bool
+linkMemberExporting(const char* name, strmap_t* definedSymbols) {
+    string* key = str_Create(name);
+    intptr_t value;
+    bool found = !strmap_Value(definedSymbols, key, &value) && strmap_Value(g_libraryExports, key, &value);
+    str_Free(key);
+
+    if (found) {
+        SLibraryMember* member = (SLibraryMember*) value;
+        if (!member->linked) {
+            // Everything the member exports is defined from now on, so no other member is linked for it in this pass
+            SSection* last = sect_LastSection();
+            linkMember(member);
+            addExportedSymbols(last != NULL ? last->nextSection : sect_Sections, NULL, definedSymbols);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool
+linkAlwaysLinkedMembers(void) {
+    bool linked = false;
+
+    for (SLibrary* library = g_libraries; library != NULL; library = library->nextLibrary) {
+        for (uint32_t i = 0; i < library->totalMembers; ++i) {
+            SLibraryMember* member = &library->members[i];
+            if (member->alwaysLinked && !member->linked) {
+                linkMember(member);
+                linked = true;
+            }
+        }
+    }
+
+    return linked;
+}
+
+static bool
+linkImportedSymbols(SSection* first, SSection* last, strmap_t* definedSymbols) {
+    bool linked = false;
+
+    for (SSection* section = first; section != NULL; section = section->nextSection) {
+        for (uint32_t i = 0; i < section->totalSymbols; ++i) {
+            if (section->symbols[i].type == SYM_IMPORT)
+                linked |= linkMemberExporting(section->symbols[i].name, definedSymbols);
+        }
+        if (section == last)
+            break;
+    }
+
+    return linked;
+}
+
+static void
+freeLibraries(void) {
+    while (g_libraries != NULL) {
+        SLibrary* library = g_libraries;
+        g_libraries = library->nextLibrary;
+
+        if (library->fileHandle != NULL)
+            fclose(library->fileHandle);
+
+        str_Free(library->fileName);
+        mem_Free(library->members);
+        mem_Free(library);
+    }
+
+    strmap_Free(g_libraryExports);
+    g_libraryExports = NULL;
+}
+
+/* Exported functions */
+
+extern void
+lib_ReadIndexed(FILE* fileHandle, const char* fileName) {
+    SLibrary** next = &g_libraries;
+    while (*next != NULL)
+        next = &(*next)->nextLibrary;
+
+    SLibrary* library = *next = mem_Alloc(sizeof(SLibrary));
+    library->fileName = str_Create(fileName);
+    library->fileHandle = NULL;
+    library->totalMembers = fgetll(fileHandle);
+    library->members = mem_Alloc(sizeof(SLibraryMember) * (library->totalMembers + 1));
+    library->nextLibrary = NULL;
+
+    if (g_libraryExports == NULL)
+        g_libraryExports = strmap_Create(freeNothing);
+
+    for (uint32_t i = 0; i < library->totalMembers; ++i) {
+        SLibraryMember* member = &library->members[i];
+        char name[MAX_SYMBOL_NAME_LENGTH];
+
+        fgetsz(name, MAX_SYMBOL_NAME_LENGTH, fileHandle);
+        member->library = library;
+        member->offset = fgetll(fileHandle);
+        fgetll(fileHandle);  // Skip size
+        member->linked = false;
+
+        uint32_t totalExports = fgetll(fileHandle);
+        member->alwaysLinked = totalExports == UINT32_MAX;
+        if (!member->alwaysLinked) {
+            while (totalExports--) {
+                fgetsz(name, MAX_SYMBOL_NAME_LENGTH, fileHandle);
+                mapInsertSymbol(g_libraryExports, name, (intptr_t) member);
+            }
+        }
+    }
+}
+
+extern void
+lib_LinkRequiredMembers(const char* rootSymbol) {
+    if (g_libraries == NULL)
+        return;
+
+    strmap_t* definedSymbols = strmap_Create(freeNothing);
+
+    linkAlwaysLinkedMembers();
+
+    if (rootSymbol != NULL) {
+        addExportedSymbols(sect_Sections, NULL, definedSymbols);
+        linkMemberExporting(rootSymbol, definedSymbols);
+    }
+
+    // Each pass only considers the sections linked in by the previous pass, until no more members are needed
+    SSection* first = sect_Sections;
+    while (first != NULL) {
+        SSection* last = sect_LastSection();
+
+        addExportedSymbols(first, last, definedSymbols);
+        if (!linkImportedSymbols(first, last, definedSymbols))
+            break;
+
+        first = last->nextSection;
+    }
+
+    strmap_Free(definedSymbols);
+    freeLibraries();
+}
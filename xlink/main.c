@@ -18,13 +18,16 @@
 
 #include <ctype.h>
 #include <stdarg.h>
+#include <string.h>
 
 #include "util.h"
 #include "file.h"
+#include "mem.h"
 #include "str.h"
 
 #include "amiga.h"
 #include "assign.h"
+#include "cache.h"
 #include "coco.h"
 #include "commodore.h"
 #include "foenix.h"
@@ -32,13 +35,16 @@
 #include "group.h"
 #include "hc800.h"
 #include "image.h"
+#include "library.h"
 #include "mapfile.h"
 #include "memorymap.h"
+#include "merge.h"
 #include "object.h"
 #include "patch.h"
 #include "section.h"
 #include "sega.h"
 #include "smart.h"
+#include "stats.h"
 #include "xlink.h"
 
 #define FF_GAME_BOY			(FILE_FORMAT_BINARY | FILE_FORMAT_GAME_BOY)
@@ -61,6 +67,11 @@ static int g_binaryPad = -1;
 static const char* g_smartlink = NULL;
 static const char* g_entry = NULL;
 static const char* g_mapFilename = NULL;
+static const char* g_reportFilename = NULL;
+static const char* g_cacheFilename = NULL;
+static string* g_machineDefinition = NULL;
+static bool g_bestFit = false;
+static bool g_foldCode = false;
 static bool g_targetDefined = false;
 
 const char* g_outputFilename = NULL;
@@ -118,6 +129,8 @@ printUsage(void) {
            "          -cfxf256jrs Foenix F256 Jr. small mode (64 KiB, I/O hole)\n"
 		   "          -ccoco      Tandy TRS-80 Color Computer\n"
 		   "\n"
+           "    -d  Fold identical code sections into one\n"
+		   "\n"
            "    -e<symbol>  Code entry point when supported by output format.\n"
 		   "                Will override \"-s\" option\n"
 		   "\n"
@@ -136,12 +149,29 @@ printUsage(void) {
            "          -ffxkupp    Foenix F256 Kernel User Program, slot padding\n"
            "          -fcocobin   TRS-80 Color Computer .bin\n"
 		   "\n"
+           "    -i[cache]   Keep a link cache in file [cache], default is the output\n"
+           "                filename with \".cache\" appended. The link is skipped if the\n"
+           "                options and inputs are unchanged and the outputs are intact\n"
+		   "\n"
            "    -m<mapfile> Write a mapfile to <mapfile>\n"
+           "                A .json or .csv extension selects a machine readable map with\n"
+           "                bank usage, section placement and symbol sizes\n"
 		   "\n"
            "    -o<output>  Write output to file <output>\n"
 		   "\n"
+           "    -p<placement>  Placement of sections without a fixed address\n"
+           "          -pfirst     First fit, in command line order (default)\n"
+           "          -pbest      Best fit, largest sections first\n"
+		   "\n"
+           "    -r<report>  Write a report of kept and stripped sections and bank usage\n"
+           "                to <report>\n"
+		   "\n"
            "    -s<symbol>  Strip unused sections, rooting the section containing <symbol>\n"
            "                <symbol> is used as entry point when support by output format\n"
+		   "\n"
+           "    -v[trace]   Print the time spent in each phase of the link, counts of\n"
+           "                sections, symbols and patches, bytes read and written and peak\n"
+           "                memory use. Also write a Chrome trace event file to [trace]\n"
     );
     exit(EXIT_SUCCESS);
 }
@@ -446,6 +476,66 @@ writeOutput(const char* g_outputFilename) {
 }
 
 
+static void
+handlePlacementOption(const string* placement) {
+	if (str_EqualConst(placement, "first")) {
+		g_bestFit = false;
+	} else if (str_EqualConst(placement, "best")) {
+		g_bestFit = true;
+	} else {
+		error("Unknown placement \"%s\"", str_String(placement));
+	}
+}
+
+static void
+writeReport(const char* name, bool bankUsage) {
+	FILE* fileHandle = fopen(name, "wt");
+	if (fileHandle == NULL)
+		error("Unable to open file \"%s\" for writing", name);
+
+	smart_WriteReport(fileHandle);
+	if (bankUsage)
+		group_WriteFillReport(fileHandle);
+
+	fclose(fileHandle);
+}
+
+static void
+openCache(int argc, char* argv[], int firstInput) {
+	if (*g_cacheFilename == 0) {
+		if (g_outputFilename == NULL)
+			error("option \"i\" needs an argument when there is no output file");
+
+		size_t length = strlen(g_outputFilename) + 7;
+		char* cacheFilename = mem_Alloc(length);
+		snprintf(cacheFilename, length, "%s.cache", g_outputFilename);
+		g_cacheFilename = cacheFilename;
+	}
+
+	cache_Open(g_cacheFilename);
+
+	for (int i = 1; i < firstInput; ++i)
+		cache_AddOption(argv[i]);
+
+	if (g_machineDefinition != NULL)
+		cache_AddInput(str_String(g_machineDefinition));
+
+	for (int i = firstInput; i < argc; ++i)
+		cache_AddInput(argv[i]);
+}
+
+static void
+addCacheOutputs(void) {
+	if (g_outputFilename != NULL)
+		cache_AddOutput(g_outputFilename);
+
+	if (g_mapFilename != NULL)
+		cache_AddOutput(g_mapFilename);
+
+	if (g_reportFilename != NULL)
+		cache_AddOutput(g_reportFilename);
+}
+
 static bool
 handleOption(const char* option) {
 	switch (tolower(option[0])) {
@@ -457,9 +547,8 @@ handleOption(const char* option) {
 			if (g_targetDefined) error("more than one target (option \"a\", \"t\", \"c\") defined");
 
 			g_targetDefined = true;
-			string* filename = str_ToLower(str_Create(&option[1]));
-			mmap_Read(filename);
-			str_Free(filename);
+			g_machineDefinition = str_ToLower(str_Create(&option[1]));
+			mmap_Read(g_machineDefinition);
 			return true;
 		}
 		case 'c': {	/* Memory configuration */
@@ -471,6 +560,9 @@ handleOption(const char* option) {
 			str_Free(target);
 			return true;
 		}
+		case 'd':	/* Identical code folding */
+			g_foldCode = true;
+			return true;
 		case 'e':	/* Entry point */
 			if (option[1] == 0) error("option \"e\" needs an argument");
 			g_entry = &option[1];
@@ -482,6 +574,9 @@ handleOption(const char* option) {
 			str_Free(target);
 			return true;
 		}
+		case 'i':	/* Link cache */
+			g_cacheFilename = &option[1];
+			return true;
 		case 'm':	/* Map file */
 			if (option[1] == 0) error("option \"m\" needs an argument");
 
@@ -492,6 +587,17 @@ handleOption(const char* option) {
 
 			g_outputFilename = &option[1];
 			return true;
+		case 'p': {	/* Placement */
+			string* placement = str_ToLower(str_Create(&option[1]));
+			handlePlacementOption(placement);
+			str_Free(placement);
+			return true;
+		}
+		case 'r':	/* Link report */
+			if (option[1] == 0) error("option \"r\" needs an argument");
+
+			g_reportFilename = &option[1];
+			return true;
 		case 's':	/* Smart linking */
 			if (option[1] == 0) error("option \"s\" needs an argument");
 
@@ -499,6 +605,9 @@ handleOption(const char* option) {
 			if (g_entry == NULL)
 				g_entry = g_smartlink;
 
+			return true;
+		case 'v':	/* Statistics */
+			stats_Enable(option[1] != 0 ? &option[1] : NULL);
 			return true;
 		case 't': {	/* Target */
 			if (g_targetDefined) error("more than one target (option \"a\", \"t\", \"c\") defined");
@@ -539,36 +648,77 @@ main(int argc, char* argv[]) {
 		error("Memory/machine configuration does not support output format");
 	}
 
+	if (g_cacheFilename != NULL) {
+		stats_Phase("check cache");
+		openCache(argc, argv, argn);
+
+		if (cache_IsUpToDate()) {
+			stats_Write(stdout);
+			return EXIT_SUCCESS;
+		}
+	}
+
 	group_InitMemoryChunks();
 
+	stats_Phase("read objects");
     while (argn < argc && argv[argn]) {
         obj_Read(argv[argn++]);
     }
 
+	stats_Phase("link libraries");
+    lib_LinkRequiredMembers(g_smartlink);
+
+	stats_Phase("smart link");
     smart_Process(g_smartlink);
 
     if (!format_SupportsReloc(g_outputFormat)) {
-        assign_Process();
+		stats_Phase("merge sections");
+		merge_Process(g_foldCode);
+
+		stats_Phase("place sections");
+        assign_Process(g_bestFit);
+
+		stats_Phase("resolve symbols");
 		sect_ResolveUnresolved();
 	}
 
+	if (g_reportFilename != NULL) {
+		stats_Phase("write report");
+		writeReport(g_reportFilename, !format_SupportsReloc(g_outputFormat));
+		stats_AddOutputFile(g_reportFilename);
+	}
+
+	stats_Phase("patch");
     patch_Process(
 		format_SupportsReloc(g_outputFormat),
 		format_SupportsOnlySectionRelativeReloc(g_outputFormat),
         format_SupportsImports(g_outputFormat));
 
 	if (g_outputFilename != NULL) {
+		stats_Phase("write output");
 		writeOutput(g_outputFilename);
+		stats_AddOutputFile(g_outputFilename);
 	}
 
     if (g_mapFilename != NULL) {
         if (!format_SupportsReloc(g_outputFormat)) {
+			stats_Phase("write map");
             sect_SortSections();
             map_Write(g_mapFilename);
+			stats_AddOutputFile(g_mapFilename);
         } else {
             error("Output format does not support producing a mapfile");
         }
     }
 
+	if (g_cacheFilename != NULL) {
+		stats_Phase("write cache");
+		addCacheOutputs();
+		cache_Write();
+		stats_AddOutputFile(g_cacheFilename);
+	}
+
+	stats_Write(stdout);
+
     return EXIT_SUCCESS;
 }
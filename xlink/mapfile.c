@@ -16,52 +16,449 @@
     along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "file.h"
+#include "mem.h"
 
+#include "group.h"
+#include "mapfile.h"
+#include "object.h"
 #include "section.h"
+#include "smart.h"
 #include "xlink.h"
 
+/*
+ * All map file formats are written from a single index of the resolved symbols in used sections,
+ * ordered by section (in section list order) and then by value. The symbols of a section folded into
+ * an identical one are listed with that section, at the address they resolve to. The section's own
+ * symbol array is left untouched.
+ */
+
+typedef struct {
+    SSection* section;
+    SSymbol* symbol;
+    uint32_t sectionIndex;
+    uint32_t definingSectionIndex;
+    uint32_t symbolIndex;
+    uint32_t size;
+    bool hasSize;
+} SMapEntry;
+
+typedef struct {
+    SMapEntry* entries;
+    uint32_t totalEntries;
+} SMapIndex;
+
+typedef struct {
+    const SSection* section;
+    uint32_t index;
+} SSectionOrder;
+
+typedef enum {
+    MAP_TEXT,
+    MAP_JSON,
+    MAP_CSV
+} EMapFormat;
+
 static int
-compareSymbols(const void* element1, const void* element2) {
-    const SSymbol* symbol1 = (const SSymbol*) element1;
-    const SSymbol* symbol2 = (const SSymbol*) element2;
+compareEntries(const void* element1, const void* element2) {
+    const SMapEntry* entry1 = (const SMapEntry*) element1;
+    const SMapEntry* entry2 = (const SMapEntry*) element2;
+
+    if (entry1->sectionIndex != entry2->sectionIndex)
+        return entry1->sectionIndex < entry2->sectionIndex ? -1 : 1;
+
+    if (entry1->symbol->value != entry2->symbol->value)
+        return entry1->symbol->value < entry2->symbol->value ? -1 : 1;
 
-    bool symbol1Import = sym_IsImport(symbol1);
-    bool symbol2Import = sym_IsImport(symbol2);
+    // A section's own symbols are listed before the symbols of sections folded into it
+    bool folded1 = entry1->definingSectionIndex != entry1->sectionIndex;
+    bool folded2 = entry2->definingSectionIndex != entry2->sectionIndex;
+    if (folded1 != folded2)
+        return folded1 ? 1 : -1;
+
+    if (entry1->definingSectionIndex != entry2->definingSectionIndex)
+        return entry1->definingSectionIndex < entry2->definingSectionIndex ? -1 : 1;
+
+    return entry1->symbolIndex < entry2->symbolIndex ? -1 : entry1->symbolIndex > entry2->symbolIndex;
+}
+
+static int
+compareSectionOrder(const void* element1, const void* element2) {
+    uintptr_t section1 = (uintptr_t) ((const SSectionOrder*) element1)->section;
+    uintptr_t section2 = (uintptr_t) ((const SSectionOrder*) element2)->section;
+
+    return section1 < section2 ? -1 : section1 > section2;
+}
 
-    if (symbol1Import != symbol2Import)
-        return symbol1Import - symbol2Import;
+static bool
+isMapSection(const SSection* section) {
+    return section->used || section->foldedInto != NULL;
+}
 
-    return symbol1->value - symbol2->value;
+static bool
+isMapSymbol(const SSymbol* symbol) {
+    return !sym_IsImport(symbol) && symbol->resolved;
 }
 
+// A symbol's size is the distance to the next higher symbol in the section, or to the end of the section.
+// Symbols at the same address, such as those of a folded section, have the same size.
 static void
-sortSymbols(SSymbol* symbolArray, uint32_t totalSymbols) {
-    qsort(symbolArray, totalSymbols, sizeof(SSymbol), compareSymbols);
+calculateSymbolSizes(SMapIndex* index) {
+    for (uint32_t i = 0; i < index->totalEntries; ++i) {
+        SMapEntry* entry = &index->entries[i];
+        SSection* section = entry->section;
+
+        if (sect_IsEquSection(section) || section->cpuLocation == -1)
+            continue;
+
+        uint32_t next = i + 1;
+        while (next < index->totalEntries && index->entries[next].section == section && index->entries[next].symbol->value == entry->symbol->value)
+            ++next;
+
+        int32_t end = section->cpuLocation + (int32_t) section->size;
+        if (next < index->totalEntries && index->entries[next].section == section && index->entries[next].symbol->value < end)
+            end = index->entries[next].symbol->value;
+
+        entry->hasSize = end >= entry->symbol->value;
+        entry->size = entry->hasSize ? (uint32_t) (end - entry->symbol->value) : 0;
+    }
+}
+
+// Returns the position in the section list of every section, ordered by address for lookup
+static SSectionOrder*
+buildSectionOrder(void) {
+    SSectionOrder* order = mem_Alloc(sizeof(SSectionOrder) * (sect_TotalSections() + 1));
+
+    uint32_t sectionIndex = 0;
+    for (SSection* section = sect_Sections; section != NULL; section = section->nextSection, ++sectionIndex) {
+        order[sectionIndex].section = section;
+        order[sectionIndex].index = sectionIndex;
+    }
+
+    qsort(order, sectionIndex, sizeof(SSectionOrder), compareSectionOrder);
+    return order;
+}
+
+static uint32_t
+sectionIndexOf(const SSectionOrder* order, const SSection* section) {
+    SSectionOrder key = {section, 0};
+    const SSectionOrder* found = bsearch(&key, order, sect_TotalSections(), sizeof(SSectionOrder), compareSectionOrder);
+
+    return found->index;
 }
 
 static void
-writeSectionToMapFile(SSection* section, intptr_t data) {
-    FILE* fileHandle = (FILE*) data;
+buildIndex(SMapIndex* index) {
+    uint32_t totalEntries = 0;
+    for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
+        if (isMapSection(section)) {
+            for (uint32_t i = 0; i < section->totalSymbols; ++i) {
+                if (isMapSymbol(&section->symbols[i]))
+                    ++totalEntries;
+            }
+        }
+    }
+
+    index->entries = mem_Alloc(sizeof(SMapEntry) * (totalEntries + 1));
+    index->totalEntries = totalEntries;
 
-    sortSymbols(section->symbols, section->totalSymbols);
+    SSectionOrder* order = buildSectionOrder();
 
-    for (uint32_t i = 0; i < section->totalSymbols; ++i) {
-        SSymbol* symbol = &section->symbols[i];
+    SMapEntry* entry = index->entries;
+    uint32_t sectionIndex = 0;
+    for (SSection* section = sect_Sections; section != NULL; section = section->nextSection, ++sectionIndex) {
+        if (isMapSection(section)) {
+            // The symbols of a folded section have been resolved to the section it was folded into
+            SSection* mappedSection = section->foldedInto != NULL ? section->foldedInto : section;
+            uint32_t mappedIndex = section->foldedInto != NULL ? sectionIndexOf(order, mappedSection) : sectionIndex;
 
-        if (!sym_IsImport(symbol) && symbol->resolved) {
-            if (section->cpuBank != -1) {
-                fprintf(fileHandle, "%X:", section->cpuBank);
+            for (uint32_t i = 0; i < section->totalSymbols; ++i) {
+                if (isMapSymbol(&section->symbols[i])) {
+                    entry->section = mappedSection;
+                    entry->symbol = &section->symbols[i];
+                    entry->sectionIndex = mappedIndex;
+                    entry->definingSectionIndex = sectionIndex;
+                    entry->symbolIndex = i;
+                    entry->size = 0;
+                    entry->hasSize = false;
+                    ++entry;
+                }
             }
+        }
+    }
+
+    mem_Free(order);
+
+    qsort(index->entries, totalEntries, sizeof(SMapEntry), compareEntries);
+    calculateSymbolSizes(index);
+}
+
+static void
+freeIndex(SMapIndex* index) {
+    mem_Free(index->entries);
+    index->entries = NULL;
+    index->totalEntries = 0;
+}
+
+static const char*
+keptReasonName(EKeptReason reason) {
+    switch (reason) {
+        case KEPT_ENTRY:
+            return "entry";
+        case KEPT_ROOT:
+            return "root";
+        case KEPT_REFERENCED:
+            return "referenced";
+        case KEPT_NONE:
+        default:
+            return "unknown";
+    }
+}
 
-            fprintf(fileHandle, "%X %s\n", symbol->value, symbol->name);
+// Returns why the section is in the output or not, optionally with the symbol and section responsible
+static const char*
+sectionReason(const SSection* section, const char** outThrough, const SSection** outBy) {
+    *outThrough = NULL;
+    *outBy = NULL;
+
+    if (section->foldedInto != NULL)
+        return "folded";
+
+    if (!smart_Enabled())
+        return "all";
+
+    if (!section->used)
+        return "unreferenced";
+
+    return keptReasonName(smart_KeptReason(section, outThrough, outBy));
+}
+
+
+/* Text format */
+
+static void
+writeText(FILE* fileHandle, const SMapIndex* index) {
+    for (uint32_t i = 0; i < index->totalEntries; ++i) {
+        const SMapEntry* entry = &index->entries[i];
+
+        if (entry->section->cpuBank != -1) {
+            fprintf(fileHandle, "%X:", entry->section->cpuBank);
         }
+
+        fprintf(fileHandle, "%X %s\n", entry->symbol->value, entry->symbol->name);
+    }
+}
+
+
+/* JSON format */
+
+static void
+writeJsonString(FILE* fileHandle, const char* string) {
+    fputc('"', fileHandle);
+    for (const char* ch = string; *ch != 0; ++ch) {
+        if (*ch == '"' || *ch == '\\')
+            fprintf(fileHandle, "\\%c", *ch);
+        else if ((uint8_t) *ch < 0x20)
+            fprintf(fileHandle, "\\u%04X", (uint8_t) *ch);
+        else
+            fputc(*ch, fileHandle);
+    }
+    fputc('"', fileHandle);
+}
+
+static void
+writeJsonOptionalString(FILE* fileHandle, const char* string) {
+    if (string != NULL)
+        writeJsonString(fileHandle, string);
+    else
+        fputs("null", fileHandle);
+}
+
+static void
+writeJsonOptionalInt(FILE* fileHandle, bool present, int32_t value) {
+    if (present)
+        fprintf(fileHandle, "%d", value);
+    else
+        fputs("null", fileHandle);
+}
+
+typedef struct {
+    FILE* fileHandle;
+    bool first;
+} SJsonList;
+
+static void
+writeJsonPool(MemoryPool* pool, intptr_t data) {
+    SJsonList* list = (SJsonList*) data;
+    uint32_t largest;
+    uint32_t free = pool_FreeBytes(pool, &largest);
+
+    fputs(list->first ? "\n    {\"bank\": " : ",\n    {\"bank\": ", list->fileHandle);
+    fprintf(list->fileHandle, "%d, \"address\": %u, \"imageLocation\": ", pool->cpuBank, pool->cpuByteLocation);
+    writeJsonOptionalInt(list->fileHandle, pool->imageLocation != -1, pool->imageLocation);
+    fprintf(list->fileHandle, ", \"size\": %u, \"used\": %u, \"free\": %u, \"largestFree\": %u}",
+            pool->size, pool->size - free, free, largest);
+    list->first = false;
+}
+
+static void
+writeJson(FILE* fileHandle, const SMapIndex* index) {
+    SJsonList banks = {fileHandle, true};
+
+    fputs("{\n  \"banks\": [", fileHandle);
+    group_ForEachPool(writeJsonPool, (intptr_t) &banks);
+
+    fputs("\n  ],\n  \"sections\": [", fileHandle);
+    bool first = true;
+    for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
+        if (sect_IsEquSection(section))
+            continue;
+
+        const char* through;
+        const SSection* by;
+        const char* reason = sectionReason(section, &through, &by);
+        bool placed = section->used && section->cpuLocation != -1;
+
+        fputs(first ? "\n    {\"name\": " : ",\n    {\"name\": ", fileHandle);
+        writeJsonString(fileHandle, section->name);
+        fputs(", \"group\": ", fileHandle);
+        writeJsonString(fileHandle, group_Name(section->group));
+        fputs(", \"bank\": ", fileHandle);
+        writeJsonOptionalInt(fileHandle, placed && section->cpuBank != -1, section->cpuBank);
+        fputs(", \"address\": ", fileHandle);
+        writeJsonOptionalInt(fileHandle, placed, section->cpuLocation);
+        fputs(", \"imageLocation\": ", fileHandle);
+        writeJsonOptionalInt(fileHandle, placed && section->imageLocation != -1, section->imageLocation);
+        fprintf(fileHandle, ", \"size\": %u, \"kept\": %s, \"reason\": \"%s\", \"keptThrough\": ",
+                section->size, section->used ? "true" : "false", reason);
+        writeJsonOptionalString(fileHandle, through);
+        fputs(", \"keptBy\": ", fileHandle);
+        writeJsonOptionalString(fileHandle, by != NULL ? by->name : NULL);
+        fputc('}', fileHandle);
+        first = false;
+    }
+
+    fputs("\n  ],\n  \"symbols\": [", fileHandle);
+    for (uint32_t i = 0; i < index->totalEntries; ++i) {
+        const SMapEntry* entry = &index->entries[i];
+        bool equ = sect_IsEquSection(entry->section);
+
+        fputs(i == 0 ? "\n    {\"name\": " : ",\n    {\"name\": ", fileHandle);
+        writeJsonString(fileHandle, entry->symbol->name);
+        fputs(", \"section\": ", fileHandle);
+        writeJsonOptionalString(fileHandle, equ ? NULL : entry->section->name);
+        fputs(", \"bank\": ", fileHandle);
+        writeJsonOptionalInt(fileHandle, entry->section->cpuBank != -1, entry->section->cpuBank);
+        fprintf(fileHandle, ", \"value\": %d, \"size\": ", entry->symbol->value);
+        writeJsonOptionalInt(fileHandle, entry->hasSize, (int32_t) entry->size);
+        fputc('}', fileHandle);
+    }
+
+    fputs("\n  ]\n}\n", fileHandle);
+}
+
+
+/* CSV format, one record per line with the kind of record in the first column */
+
+static void
+writeCsvString(FILE* fileHandle, const char* string) {
+    if (string == NULL)
+        return;
+
+    if (strpbrk(string, ",\"\r\n") == NULL) {
+        fputs(string, fileHandle);
+        return;
+    }
+
+    fputc('"', fileHandle);
+    for (const char* ch = string; *ch != 0; ++ch) {
+        if (*ch == '"')
+            fputc('"', fileHandle);
+        fputc(*ch, fileHandle);
     }
+    fputc('"', fileHandle);
 }
 
 static void
-writeMapFile(FILE* fileHandle) {
-    sect_ForEachUsedSection(writeSectionToMapFile, (intptr_t) fileHandle);
+writeCsvOptionalInt(FILE* fileHandle, bool present, int32_t value) {
+    if (present)
+        fprintf(fileHandle, "%d", value);
+}
+
+static void
+writeCsvPool(MemoryPool* pool, intptr_t data) {
+    FILE* fileHandle = (FILE*) data;
+    uint32_t largest;
+    uint32_t free = pool_FreeBytes(pool, &largest);
+
+    fprintf(fileHandle, "bank,,,,%d,%u,", pool->cpuBank, pool->cpuByteLocation);
+    writeCsvOptionalInt(fileHandle, pool->imageLocation != -1, pool->imageLocation);
+    fprintf(fileHandle, ",%u,%u,%u,%u,,,\n", pool->size, pool->size - free, free, largest);
+}
+
+static void
+writeCsv(FILE* fileHandle, const SMapIndex* index) {
+    fputs("kind,name,section,group,bank,address,imagelocation,size,used,free,largestfree,reason,keptthrough,keptby\n", fileHandle);
+
+    group_ForEachPool(writeCsvPool, (intptr_t) fileHandle);
+
+    for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
+        if (sect_IsEquSection(section))
+            continue;
+
+        const char* through;
+        const SSection* by;
+        const char* reason = sectionReason(section, &through, &by);
+        bool placed = section->used && section->cpuLocation != -1;
+
+        fputs("section,", fileHandle);
+        writeCsvString(fileHandle, section->name);
+        fputs(",,", fileHandle);
+        writeCsvString(fileHandle, group_Name(section->group));
+        fputc(',', fileHandle);
+        writeCsvOptionalInt(fileHandle, placed && section->cpuBank != -1, section->cpuBank);
+        fputc(',', fileHandle);
+        writeCsvOptionalInt(fileHandle, placed, section->cpuLocation);
+        fputc(',', fileHandle);
+        writeCsvOptionalInt(fileHandle, placed && section->imageLocation != -1, section->imageLocation);
+        fprintf(fileHandle, ",%u,,,,%s,", section->size, reason);
+        writeCsvString(fileHandle, through);
+        fputc(',', fileHandle);
+        writeCsvString(fileHandle, by != NULL ? by->name : NULL);
+        fputc('\n', fileHandle);
+    }
+
+    for (uint32_t i = 0; i < index->totalEntries; ++i) {
+        const SMapEntry* entry = &index->entries[i];
+
+        fputs("symbol,", fileHandle);
+        writeCsvString(fileHandle, entry->symbol->name);
+        fputc(',', fileHandle);
+        writeCsvString(fileHandle, sect_IsEquSection(entry->section) ? NULL : entry->section->name);
+        fputs(",,", fileHandle);
+        writeCsvOptionalInt(fileHandle, entry->section->cpuBank != -1, entry->section->cpuBank);
+        fprintf(fileHandle, ",%d,,", entry->symbol->value);
+        writeCsvOptionalInt(fileHandle, entry->hasSize, (int32_t) entry->size);
+        fputs(",,,,,,\n", fileHandle);
+    }
+}
+
+
+static EMapFormat
+mapFormat(const char* name) {
+    const char* extension = strrchr(name, '.');
+
+    if (extension != NULL) {
+        if (strcmp(extension, ".json") == 0 || strcmp(extension, ".JSON") == 0)
+            return MAP_JSON;
+        if (strcmp(extension, ".csv") == 0 || strcmp(extension, ".CSV") == 0)
+            return MAP_CSV;
+    }
+
+    return MAP_TEXT;
 }
 
 void
@@ -70,5 +467,22 @@ map_Write(const char* name) {
     if (fileHandle == NULL) {
         error("Unable to open file \"%s\" for writing", name);
     } 
-    writeMapFile(fileHandle);
+
+    SMapIndex index;
+    buildIndex(&index);
+
+    switch (mapFormat(name)) {
+        case MAP_JSON:
+            writeJson(fileHandle, &index);
+            break;
+        case MAP_CSV:
+            writeCsv(fileHandle, &index);
+            break;
+        case MAP_TEXT:
+            writeText(fileHandle, &index);
+            break;
+    }
+
+    freeIndex(&index);
+    fclose(fileHandle);
 }
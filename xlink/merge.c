@@ -0,0 +1,261 @@
+/*  Copyright 2008-2022 Carsten Elton Sorensen and contributors
+
+    This file is part of ASMotor.
+
+    ASMotor is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ASMotor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Sections flagged as mergeable by the assembler, such as literal pools and constant tables, are
+ * often identical across objects built from the same macros. Each such section is folded into the
+ * first used section with the same group, placement requirements, data and patches. A folded
+ * section is no longer used, so it isn't placed or written, and its symbols resolve to the section
+ * it was folded into. Identical code folding extends this to every code section.
+ *
+ * Patches are identical when their expressions are identical, where a symbol defined in the section
+ * itself must be at the same offset, and imported symbols must bind to the same definition, or to
+ * the same offset in sections that were folded together. Folding a section may make the sections
+ * referencing it identical, so sections are compared again until no more sections are folded.
+ */
+
+#include <string.h>
+
+#include "crc32.h"
+#include "mem.h"
+
+#include "merge.h"
+#include "patch.h"
+#include "section.h"
+#include "xlink.h"
+
+#define MERGE_HASH_SIZE 1024U
+
+typedef struct MergeEntry {
+    SSection* section;
+    uint32_t hash;
+    struct MergeEntry* nextEntry;
+} SMergeEntry;
+
+static uint32_t g_totalFolded = 0;
+static uint32_t g_bytesSaved = 0;
+
+
+static uint32_t
+readOperand(const uint8_t* expression) {
+    return (uint32_t) expression[0] | (uint32_t) expression[1] << 8u | (uint32_t) expression[2] << 16u | (uint32_t) expression[3] << 24u;
+}
+
+static SSection*
+foldedSection(SSection* section) {
+    return section->foldedInto != NULL ? section->foldedInto : section;
+}
+
+static bool
+identicalDefinitions(SSection* section1, SSymbol* symbol1, SSection* section2, SSymbol* symbol2) {
+    SSection* definingSection1;
+    SSection* definingSection2;
+    SSymbol* definition1 = sect_FindDefinition(section1, symbol1, &definingSection1);
+    SSymbol* definition2 = sect_FindDefinition(section2, symbol2, &definingSection2);
+
+    if (definition1 == NULL || definition2 == NULL)
+        return false;
+
+    if (definition1 == definition2)
+        return true;
+
+    if (sect_IsEquSection(definingSection1) || sect_IsEquSection(definingSection2))
+        return sect_IsEquSection(definingSection1) && sect_IsEquSection(definingSection2) && definition1->value == definition2->value;
+
+    return foldedSection(definingSection1) == foldedSection(definingSection2) && definition1->value == definition2->value;
+}
+
+static bool
+identicalSymbols(SSection* section1, uint32_t symbolId1, SSection* section2, uint32_t symbolId2) {
+    if (symbolId1 >= section1->totalSymbols || symbolId2 >= section2->totalSymbols)
+        return false;
+
+    SSymbol* symbol1 = &section1->symbols[symbolId1];
+    SSymbol* symbol2 = &section2->symbols[symbolId2];
+
+    if (sym_IsImport(symbol1) || sym_IsImport(symbol2)) {
+        return sym_IsImport(symbol1) && sym_IsImport(symbol2)
+            && identicalDefinitions(section1, symbol1, section2, symbol2);
+    }
+
+    // Both refer to their own section
+    return symbol1->value == symbol2->value;
+}
+
+static bool
+identicalPatches(SSection* section1, const SPatch* patch1, SSection* section2, const SPatch* patch2) {
+    if (patch1->offset != patch2->offset || patch1->type != patch2->type || patch1->expressionSize != patch2->expressionSize)
+        return false;
+
+    const uint8_t* expression1 = patch1->expression;
+    const uint8_t* expression2 = patch2->expression;
+    const uint8_t* end = expression1 + patch1->expressionSize;
+
+    while (expression1 < end) {
+        uint8_t operator = *expression1++;
+        if (operator != *expression2++)
+            return false;
+
+        if (operator == OBJ_CONSTANT || operator == OBJ_SYMBOL || operator == OBJ_FUNC_BANK) {
+            if (end - expression1 < 4)
+                return false;
+
+            uint32_t operand1 = readOperand(expression1);
+            uint32_t operand2 = readOperand(expression2);
+            expression1 += 4;
+            expression2 += 4;
+
+            if (operator == OBJ_CONSTANT ? operand1 != operand2 : !identicalSymbols(section1, operand1, section2, operand2))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// Returns true if section may take the place of the earlier section representative
+static bool
+identicalSections(SSection* representative, SSection* section) {
+    if (representative->size != section->size
+    ||  representative->cpuBank != section->cpuBank
+    ||  representative->minimumWordSize != section->minimumWordSize
+    ||  representative->group->type != section->group->type
+    ||  representative->group->flags != section->group->flags
+    ||  strcmp(representative->group->name, section->group->name) != 0)
+        return false;
+
+    if (section->byteAlign != -1 && (representative->byteAlign == -1 || representative->byteAlign % section->byteAlign != 0))
+        return false;
+
+    uint32_t totalPatches1 = representative->patches != NULL ? representative->patches->totalPatches : 0;
+    uint32_t totalPatches2 = section->patches != NULL ? section->patches->totalPatches : 0;
+    if (totalPatches1 != totalPatches2 || memcmp(representative->data, section->data, section->size) != 0)
+        return false;
+
+    for (uint32_t i = 0; i < totalPatches1; ++i) {
+        if (!identicalPatches(representative, &representative->patches->patches[i], section, &section->patches->patches[i]))
+            return false;
+    }
+
+    return true;
+}
+
+// The hash covers the data and the shape of the patches, but not the symbols they refer to
+static uint32_t
+hashSection(const SSection* section) {
+    uint32_t hash = crc32(section->data, section->size);
+
+    if (section->patches != NULL) {
+        for (uint32_t i = 0; i < section->patches->totalPatches; ++i) {
+            const SPatch* patch = &section->patches->patches[i];
+            hash = hash * 31 + patch->offset;
+            hash = hash * 31 + patch->type;
+            hash = hash * 31 + patch->expressionSize;
+        }
+    }
+
+    return hash;
+}
+
+static bool
+isCandidate(SSection* section, bool foldCode) {
+    if (!section->used || sect_IsEquSection(section) || !group_isText(section->group)
+    ||  section->data == NULL || section->size == 0 || section->cpuByteLocation != -1 || section->cpuLocation != -1)
+        return false;
+
+    // Folding must not be observable, so writable data and sections rooted for their address are never folded
+    return section->mergeable || (foldCode && !section->root && (section->group->flags & GROUP_FLAG_DATA) == 0);
+}
+
+// Folds candidates into earlier identical candidates, returns the number of sections folded
+static uint32_t
+foldSections(SSection** candidates, uint32_t totalCandidates, SMergeEntry** buckets, SMergeEntry* entries) {
+    SMergeEntry* nextEntry = entries;
+    uint32_t totalFolded = 0;
+
+    memset(buckets, 0, sizeof(SMergeEntry*) * MERGE_HASH_SIZE);
+
+    for (uint32_t i = 0; i < totalCandidates; ++i) {
+        SSection* section = candidates[i];
+        if (section->foldedInto != NULL)
+            continue;
+
+        uint32_t hash = hashSection(section);
+        SMergeEntry** bucket = &buckets[hash % MERGE_HASH_SIZE];
+
+        SMergeEntry* entry;
+        for (entry = *bucket; entry != NULL; entry = entry->nextEntry) {
+            if (entry->hash == hash && identicalSections(entry->section, section))
+                break;
+        }
+
+        if (entry != NULL) {
+            section->used = false;
+            section->foldedInto = entry->section;
+            g_totalFolded += 1;
+            g_bytesSaved += section->size;
+            totalFolded += 1;
+        } else {
+            nextEntry->section = section;
+            nextEntry->hash = hash;
+            nextEntry->nextEntry = *bucket;
+            *bucket = nextEntry++;
+        }
+    }
+
+    // A section folded in an earlier pass may have had its replacement folded in this one
+    for (uint32_t i = 0; i < totalCandidates; ++i) {
+        SSection* section = candidates[i];
+        if (section->foldedInto != NULL)
+            section->foldedInto = foldedSection(section->foldedInto);
+    }
+
+    return totalFolded;
+}
+
+
+extern void
+merge_Process(bool foldCode) {
+    SSection** candidates = mem_Alloc(sizeof(SSection*) * (sect_TotalSections() + 1));
+    uint32_t totalCandidates = 0;
+
+    for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
+        if (isCandidate(section, foldCode))
+            candidates[totalCandidates++] = section;
+    }
+
+    SMergeEntry** buckets = mem_Alloc(sizeof(SMergeEntry*) * MERGE_HASH_SIZE);
+    SMergeEntry* entries = mem_Alloc(sizeof(SMergeEntry) * (totalCandidates + 1));
+
+    while (foldSections(candidates, totalCandidates, buckets, entries) != 0)
+        continue;
+
+    mem_Free(entries);
+    mem_Free(buckets);
+    mem_Free(candidates);
+}
+
+extern uint32_t
+merge_TotalFolded(void) {
+    return g_totalFolded;
+}
+
+extern uint32_t
+merge_BytesSaved(void) {
+    return g_bytesSaved;
+}
@@ -0,0 +1,35 @@
+/*  Copyright 2008-2022 Carsten Elton Sorensen and contributors
+
+    This file is part of ASMotor.
+
+    ASMotor is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ASMotor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef XLINK_MERGE_H_INCLUDED_
+#define XLINK_MERGE_H_INCLUDED_
+
+#include "types.h"
+
+// Folds every used mergeable section, and every code section if foldCode is true, into the first
+// used section with identical contents
+extern void
+merge_Process(bool foldCode);
+
+extern uint32_t
+merge_TotalFolded(void);
+
+extern uint32_t
+merge_BytesSaved(void);
+
+#endif
@@ -19,11 +19,17 @@
 /*
  * xLink - OBJECT.C
  *
- *	char	ID[4]="XOB\4";
+ *	char	ID[4]="XOB\6";
  *	[>=v1] char	MinimumWordSize ; Used for address calculations.
  *							; 1 - A CPU address points to a byte in memory
  *							; 2 - A CPU address points to a 16 bit word in memory (CPU address 0x1000 is the 0x2000th byte)
  *							; 4 - A CPU address points to a 32 bit word in memory (CPU address 0x1000 is the 0x4000th byte)
+ *	IF Version >= 6
+ *		uint32_t NumberOfStrings
+ *		REPT NumberOfStrings
+ *			ASCIIZ		String
+ *		ENDR
+ *	ENDC
  *	IF Version >= 2
  *		uint32_t NumberOfFiles
  *		REPT NumberOfFiles
@@ -44,7 +50,7 @@
  *			int32_t	Position; -1 = not fixed
  *			[>=v1] int32_t BasePC	; -1 = not fixed
  *			[>=v3] int32_t ByteAlign ; -1 = not aligned
- *			[>=v4] uint8_t Rooted ; != 0 is rooted
+ *			[>=v4] uint8_t Flags ; bit 0 = rooted, bit 1 = mergeable
  *			uint32_t	NumberOfSymbols
  *			REPT	NumberOfSymbols
  *					ASCIIZ	Name
@@ -57,7 +63,13 @@
  *						int32_t	value
  *					ENDC
  *			ENDR
- *          IF Version >= 2
+ *          IF Version >= 5
+ *				uint32_t	NumberOfLineMappings
+ *				IF NumberOfLineMappings != 0
+ *					uint32_t	LineMappingsSize
+ *					uint8_t		LineMappings[LineMappingsSize]	; delta encoded, see below
+ *				ENDC
+ *          ELIF Version >= 2
  *				uint32_t	NumberOfLineMappings
  *				REPT NumberOfLineMappings
  *					uint32_t	FileId
@@ -77,6 +89,15 @@
  *					ENDR
  *			ENDC
  *	ENDR
+ *
+ * Each delta encoded line mapping is an unsigned LEB128 number holding the zigzag encoded line number delta shifted
+ * left once, with bit 0 set if the file changed. If it did, the file id follows, then the zigzag encoded offset delta.
+ * Deltas are relative to the previous mapping, the first mapping's to line 0 and offset 0.
+ *
+ * From version 6, integers are LEB128 encoded, int32_t fields as signed and the others as unsigned LEB128. Only
+ * CRC32 remains a 32 bit word. ASCIIZ names are stored as the unsigned LEB128 index of the name in the string table.
+ * In expressions, the operand of OBJ_CONSTANT is signed LEB128, the symbol id of OBJ_SYMBOL and OBJ_FUNC_BANK unsigned
+ * LEB128, and the operators 0x80-0xFF push the constants 0-127.
  */
 
 #include <string.h>
@@ -89,9 +110,11 @@
 // from xlink
 #include "elf.h"
 #include "group.h"
+#include "library.h"
 #include "object.h"
 #include "patch.h"
 #include "section.h"
+#include "stats.h"
 #include "symbol.h"
 #include "xlink.h"
 
@@ -103,13 +126,128 @@ static uint32_t g_minimumWordSize = 0;
 static uint32_t g_fileInfoCount = 0;
 static SFileInfo* g_fileInfo = NULL;
 
+static uint32_t g_totalStrings = 0;
+static string** g_strings = NULL;
+
+static uint32_t
+fgetUnsigned(FILE* fileHandle) {
+    uint32_t value = 0;
+    for (uint32_t shift = 0; shift < 35; shift += 7) {
+        int byte = fgetc(fileHandle);
+        if (byte == EOF)
+            error("File read failed");
+
+        value |= (uint32_t) (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return value;
+    }
+    error("Malformed integer");
+}
+
+static int32_t
+fgetSigned(FILE* fileHandle) {
+    uint32_t value = 0;
+    for (uint32_t shift = 0; shift < 35; shift += 7) {
+        int byte = fgetc(fileHandle);
+        if (byte == EOF)
+            error("File read failed");
+
+        value |= (uint32_t) (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            if (shift < 25 && (byte & 0x40) != 0)
+                value |= UINT32_MAX << (shift + 7);
+            return (int32_t) value;
+        }
+    }
+    error("Malformed integer");
+}
+
+static const uint8_t*
+decodeUnsigned(const uint8_t* data, const uint8_t* end, uint64_t* value) {
+    *value = 0;
+    for (uint32_t shift = 0; data < end && shift < 64; shift += 7) {
+        uint8_t byte = *data++;
+        *value |= (uint64_t) (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return data;
+    }
+    error("Malformed integer");
+}
+
+static const uint8_t*
+decodeSigned(const uint8_t* data, const uint8_t* end, int32_t* value) {
+    uint32_t result = 0;
+    for (uint32_t shift = 0; data < end && shift < 35; shift += 7) {
+        uint8_t byte = *data++;
+        result |= (uint32_t) (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            if (shift < 25 && (byte & 0x40) != 0)
+                result |= UINT32_MAX << (shift + 7);
+            *value = (int32_t) result;
+            return data;
+        }
+    }
+    error("Malformed integer");
+}
+
+static uint32_t
+readUnsigned(FILE* fileHandle, int version) {
+    return version >= 6 ? fgetUnsigned(fileHandle) : fgetll(fileHandle);
+}
+
+static int32_t
+readSigned(FILE* fileHandle, int version) {
+    return version >= 6 ? fgetSigned(fileHandle) : (int32_t) fgetll(fileHandle);
+}
+
+static string*
+readString(FILE* fileHandle, int version) {
+    if (version >= 6) {
+        uint32_t id = fgetUnsigned(fileHandle);
+        if (id >= g_totalStrings)
+            error("Malformed string table");
+        return str_Copy(g_strings[id]);
+    }
+    return fgetstr(fileHandle);
+}
+
 static void
-readGroup(FILE* fileHandle, Group* group) {
+readName(FILE* fileHandle, int version, char* name) {
+    if (version >= 6) {
+        string* str = readString(fileHandle, version);
+        strncpy(name, str_String(str), MAX_SYMBOL_NAME_LENGTH - 1);
+        name[MAX_SYMBOL_NAME_LENGTH - 1] = 0;
+        str_Free(str);
+    } else {
+        fgetsz(name, MAX_SYMBOL_NAME_LENGTH, fileHandle);
+    }
+}
+
+static void
+readStrings(FILE* fileHandle) {
+    g_totalStrings = fgetUnsigned(fileHandle);
+    g_strings = mem_Alloc(sizeof(string*) * g_totalStrings);
+    for (uint32_t i = 0; i < g_totalStrings; ++i)
+        g_strings[i] = fgetstr(fileHandle);
+}
+
+static void
+freeStrings(void) {
+    for (uint32_t i = 0; i < g_totalStrings; ++i)
+        str_Free(g_strings[i]);
+    mem_Free(g_strings);
+
+    g_totalStrings = 0;
+    g_strings = NULL;
+}
+
+static void
+readGroup(FILE* fileHandle, Group* group, int version) {
     uint32_t flags;
     uint32_t type;
 
-    fgetsz(group->name, MAX_SYMBOL_NAME_LENGTH, fileHandle);
-    type = fgetll(fileHandle);
+    readName(fileHandle, version, group->name);
+    type = readUnsigned(fileHandle, version);
 
     flags = type & (GROUP_FLAG_DATA | GROUP_FLAG_SHARED);
     type &= ~flags;
@@ -131,17 +269,17 @@ allocateGroups(uint32_t totalGroups) {
 }
 
 static Groups*
-readGroups(FILE* fileHandle) {
+readGroups(FILE* fileHandle, int version) {
     Groups* groups;
     uint32_t totalGroups;
 
-    totalGroups = fgetll(fileHandle);
+    totalGroups = readUnsigned(fileHandle, version);
 
     if ((groups = allocateGroups(totalGroups)) != NULL) {
         Group* group = groups->groups;
 
         for (uint32_t i = 0; i < totalGroups; i += 1)
-            readGroup(fileHandle, group++);
+            readGroup(fileHandle, group++, version);
     } else {
         error("Out of memory");
     }
@@ -150,13 +288,13 @@ readGroups(FILE* fileHandle) {
 }
 
 static void
-readSymbol(FILE* fileHandle, SSymbol* symbol) {
-    fgetsz(symbol->name, MAX_SYMBOL_NAME_LENGTH, fileHandle);
+readSymbol(FILE* fileHandle, SSymbol* symbol, int version) {
+    readName(fileHandle, version, symbol->name);
 
-    symbol->type = (ESymbolType) fgetll(fileHandle);
+    symbol->type = (ESymbolType) readUnsigned(fileHandle, version);
 
     if (symbol->type != SYM_IMPORT && symbol->type != SYM_LOCALIMPORT)
-        symbol->value = fgetll(fileHandle);
+        symbol->value = readSigned(fileHandle, version);
     else
         symbol->value = 0;
 
@@ -165,8 +303,8 @@ readSymbol(FILE* fileHandle, SSymbol* symbol) {
 }
 
 static uint32_t
-readSymbols(FILE* fileHandle, SSymbol** outputSymbols) {
-    uint32_t totalSymbols = fgetll(fileHandle);
+readSymbols(FILE* fileHandle, SSymbol** outputSymbols, int version) {
+    uint32_t totalSymbols = readUnsigned(fileHandle, version);
 
     if (totalSymbols == 0) {
         *outputSymbols = NULL;
@@ -177,7 +315,7 @@ readSymbols(FILE* fileHandle, SSymbol** outputSymbols) {
             *outputSymbols = symbol;
 
             for (uint32_t i = 0; i < totalSymbols; i += 1)
-                readSymbol(fileHandle, symbol++);
+                readSymbol(fileHandle, symbol++, version);
 
             return totalSymbols;
         }
@@ -186,13 +324,61 @@ readSymbols(FILE* fileHandle, SSymbol** outputSymbols) {
     error("Out of memory");
 }
 
+static uint8_t*
+putOperand(uint8_t* expression, uint32_t operand) {
+    *expression++ = (uint8_t) operand;
+    *expression++ = (uint8_t) (operand >> 8u);
+    *expression++ = (uint8_t) (operand >> 16u);
+    *expression++ = (uint8_t) (operand >> 24u);
+    return expression;
+}
+
+// Version 6 expressions have compact operands, they are expanded to the 32 bit operands used when linking
+static void
+expandExpression(SPatch* patch) {
+    const uint8_t* compact = patch->expression;
+    const uint8_t* end = compact + patch->expressionSize;
+
+    // An operator and its operand expand to at most five bytes
+    uint8_t* expression = mem_Alloc(patch->expressionSize * 5);
+    uint8_t* output = expression;
+
+    while (compact < end) {
+        uint8_t operator = *compact++;
+
+        if (operator >= OBJ_SMALL_CONSTANT) {
+            *output++ = OBJ_CONSTANT;
+            output = putOperand(output, operator - OBJ_SMALL_CONSTANT);
+        } else if (operator == OBJ_CONSTANT || operator == OBJ_SYMBOL || operator == OBJ_FUNC_BANK) {
+            uint32_t operand;
+            if (operator == OBJ_CONSTANT) {
+                int32_t value;
+                compact = decodeSigned(compact, end, &value);
+                operand = (uint32_t) value;
+            } else {
+                uint64_t value;
+                compact = decodeUnsigned(compact, end, &value);
+                operand = (uint32_t) value;
+            }
+            *output++ = operator;
+            output = putOperand(output, operand);
+        } else {
+            *output++ = operator;
+        }
+    }
+
+    mem_Free(patch->expression);
+    patch->expressionSize = (uint32_t) (output - expression);
+    patch->expression = mem_Realloc(expression, patch->expressionSize);
+}
+
 static void
-readPatch(FILE* fileHandle, SPatch* patch) {
-    patch->offset = fgetll(fileHandle);
+readPatch(FILE* fileHandle, SPatch* patch, int version) {
+    patch->offset = readUnsigned(fileHandle, version);
     patch->valueSymbol = NULL;
     patch->valueSection = NULL;
-    patch->type = (EPatchType) fgetll(fileHandle);
-    patch->expressionSize = fgetll(fileHandle);
+    patch->type = (EPatchType) readUnsigned(fileHandle, version);
+    patch->expressionSize = readUnsigned(fileHandle, version);
 
     if ((patch->expression = mem_Alloc(patch->expressionSize)) != NULL) {
         if (patch->expressionSize != fread(patch->expression, 1, patch->expressionSize, fileHandle))
@@ -200,19 +386,22 @@ readPatch(FILE* fileHandle, SPatch* patch) {
     } else {
         error("Out of memory");
     }
+
+    if (version >= 6)
+        expandExpression(patch);
 }
 
 static SPatches*
-readPatches(FILE* fileHandle) {
+readPatches(FILE* fileHandle, int version) {
     SPatches* patches;
-    int totalPatches = fgetll(fileHandle);
+    int totalPatches = readUnsigned(fileHandle, version);
 
     if ((patches = patch_Alloc(totalPatches)) != NULL) {
         SPatch* patch = patches->patches;
         int i;
 
         for (i = 0; i < totalPatches; i += 1)
-            readPatch(fileHandle, patch++);
+            readPatch(fileHandle, patch++, version);
 
         return patches;
     }
@@ -220,70 +409,61 @@ readPatches(FILE* fileHandle) {
     error("Out of memory");
 }
 
+// Line mappings are not used by the linker
 static void
-readLineMapping(FILE* fileHandle, SLineMapping* lineMapping, uint32_t fileInfoIndex) {
-    lineMapping->fileInfo = &g_fileInfo[fileInfoIndex + fgetll(fileHandle)];
-    lineMapping->lineNumber = fgetll(fileHandle);
-    lineMapping->offset = fgetll(fileHandle);
-}
-
-static uint32_t
-readLineMappings(FILE* fileHandle, SLineMapping** lineMappings, uint32_t fileInfoIndex) {
-    uint32_t total = fgetll(fileHandle);
-    if (total > 0) {
-        *lineMappings = (SLineMapping*) mem_Alloc(sizeof(SLineMapping) * total);
-        for (uint32_t i = 0; i < total; ++i) {
-            readLineMapping(fileHandle, &(*lineMappings)[i], fileInfoIndex);
-        }
-    } else {
-        *lineMappings = NULL;
-    }
-    return total;
+skipLineMappings(FILE* fileHandle, int version) {
+    uint32_t totalLineMappings = readUnsigned(fileHandle, version);
+    if (totalLineMappings == 0)
+        return;
+
+    long size = version >= 5 ? (long) readUnsigned(fileHandle, version) : (long) totalLineMappings * 4 * 3;
+    if (fseek(fileHandle, size, SEEK_CUR) != 0)
+        error("File read failed");
 }
 
 static void
-readSection(FILE* fileHandle, SSection* section, Groups* groups, int version, uint32_t fileInfoIndex) {
-    section->group = groups_GetGroup(groups, fgetll(fileHandle));
-    fgetsz(section->name, MAX_SYMBOL_NAME_LENGTH, fileHandle);
-    section->cpuBank = fgetll(fileHandle);
-    section->cpuByteLocation = fgetll(fileHandle);
+readSection(FILE* fileHandle, SSection* section, Groups* groups, int version) {
+    section->group = groups_GetGroup(groups, (uint32_t) readSigned(fileHandle, version));
+    readName(fileHandle, version, section->name);
+    section->cpuBank = readSigned(fileHandle, version);
+    section->cpuByteLocation = readSigned(fileHandle, version);
     if (version >= 1)
-        section->cpuLocation = fgetll(fileHandle);
+        section->cpuLocation = readSigned(fileHandle, version);
     else
         section->cpuLocation = section->cpuByteLocation;
 
     if (version >= 3)
-        section->byteAlign = fgetll(fileHandle);
+        section->byteAlign = readSigned(fileHandle, version);
     else
         section->byteAlign = -1;
 
-    if (version >= 4)
-        section->root = fgetc(fileHandle) != 0;
-    else
+    if (version >= 4) {
+        int flags = fgetc(fileHandle);
+        section->root = (flags & 1) != 0;
+        section->mergeable = (flags & 2) != 0;
+    } else {
         section->root = false;
+        section->mergeable = false;
+    }
 
-    section->totalSymbols = readSymbols(fileHandle, &section->symbols);
+    section->totalSymbols = readSymbols(fileHandle, &section->symbols, version);
 
-    if (version >= 2) {
-        section->totalLineMappings = readLineMappings(fileHandle, &section->lineMappings, fileInfoIndex);
-    } else {
-        section->totalLineMappings = 0;
-        section->lineMappings = NULL;
-    }
+    if (version >= 2)
+        skipLineMappings(fileHandle, version);
 
-    section->size = fgetll(fileHandle);
+    section->size = readUnsigned(fileHandle, version);
     if (group_isText(section->group)) {
         if ((section->data = mem_Alloc(section->size)) != NULL) {
             if (section->size != fread(section->data, 1, section->size, fileHandle))
                 error("File read failed");
-            section->patches = readPatches(fileHandle);
+            section->patches = readPatches(fileHandle, version);
         }
     }
 }
 
 static SSection**
-readSections(Groups* groups, FILE* fileHandle, int version, uint32_t fileInfoIndex, uint32_t fileId) {
-    uint32_t totalSections = fgetll(fileHandle);
+readSections(Groups* groups, FILE* fileHandle, int version, uint32_t fileId) {
+    uint32_t totalSections = readUnsigned(fileHandle, version);
     SSection** sections = mem_Alloc(sizeof(SSection*) * totalSections);
 
     for (uint32_t i = 0; i < totalSections; ++i) {
@@ -293,7 +473,7 @@ readSections(Groups* groups, FILE* fileHandle, int version, uint32_t fileInfoInd
         section->minimumWordSize = g_minimumWordSize;
         section->fileId = fileId;
 
-        readSection(fileHandle, section, groups, version, fileInfoIndex);
+        readSection(fileHandle, section, groups, version);
 
         if (group_isText(section->group) && strcmp(section->group->name, "HOME") == 0) {
             section->cpuBank = 0;
@@ -314,10 +494,10 @@ findFileInfo(string* filename, uint32_t crc32) {
     return NULL;
 }
 
-static uint32_t
-readFileInfo(FILE* fileHandle) {
+static void
+readFileInfo(FILE* fileHandle, int version) {
     uint32_t fileInfoIndex = g_fileInfoCount;
-    uint32_t fileInfoInObject = fgetll(fileHandle);
+    uint32_t fileInfoInObject = readUnsigned(fileHandle, version);
 
     g_fileInfoCount += fileInfoInObject;
     if (g_fileInfoCount > 0) {
@@ -325,7 +505,7 @@ readFileInfo(FILE* fileHandle) {
 
         for (uint32_t i = 0; i < fileInfoInObject; ++i) {
             uint32_t index = i + fileInfoIndex;
-            g_fileInfo[index].fileName = fgetstr(fileHandle);
+            g_fileInfo[index].fileName = readString(fileHandle, version);
             g_fileInfo[index].crc32 = fgetll(fileHandle);
 
             SFileInfo* fileInfo = findFileInfo(g_fileInfo[i].fileName, g_fileInfo[i].crc32);
@@ -336,34 +516,37 @@ readFileInfo(FILE* fileHandle) {
             }
         } 
     }
-
-    return fileInfoIndex;
 }
 
 static void
 readXOB0(FILE* fileHandle, uint32_t fileId) {
     g_minimumWordSize = 1;
-    SSection** sections = readSections(readGroups(fileHandle), fileHandle, 0, 0, fileId);
+    SSection** sections = readSections(readGroups(fileHandle, 0), fileHandle, 0, fileId);
     mem_Free(sections);
 }
 
 static void
 readXOB1(FILE* fileHandle, uint32_t fileId) {
     g_minimumWordSize = fgetc(fileHandle);
-    SSection** sections = readSections(readGroups(fileHandle), fileHandle, 1, 0, fileId);
+    SSection** sections = readSections(readGroups(fileHandle, 1), fileHandle, 1, fileId);
     mem_Free(sections);
 }
 
 static void
 readXOBn(FILE* fileHandle, int32_t version, uint32_t fileId) {
     g_minimumWordSize = fgetc(fileHandle);
-    uint32_t fileInfoIndex = readFileInfo(fileHandle);
-    SSection** sections = readSections(readGroups(fileHandle), fileHandle, version, fileInfoIndex, fileId);
+    if (version >= 6)
+        readStrings(fileHandle);
+
+    readFileInfo(fileHandle, version);
+    SSection** sections = readSections(readGroups(fileHandle, version), fileHandle, version, fileId);
     mem_Free(sections);
+
+    freeStrings();
 }
 
 static bool
-readChunk(FILE* fileHandle);
+readChunk(FILE* fileHandle, const char* fileName);
 
 static void
 readXLB0(FILE* fileHandle) {
@@ -374,14 +557,18 @@ readXLB0(FILE* fileHandle) {
         }  // Skip name
         fgetll(fileHandle);           // Skip length
 
-        readChunk(fileHandle);
+        readChunk(fileHandle, NULL);
     }
 }
 
+// fileName is NULL when the chunk is a library member
 static bool
-readChunk(FILE* fileHandle) {
+readChunk(FILE* fileHandle, const char* fileName) {
     uint32_t id = fgetll(fileHandle);
 
+    if (id != MAKE_ID('X', 'L', 'B', 0) && id != MAKE_ID('X', 'L', 'B', 1))
+        stats_Add(STAT_MODULES, 1);
+
     switch (id) {
         case MAKE_ID('X', 'O', 'B', 0): {
             readXOB0(fileHandle, g_fileId++);
@@ -408,11 +595,29 @@ readChunk(FILE* fileHandle) {
             return true;
         }
 
+        case MAKE_ID('X', 'O', 'B', 5): {
+            readXOBn(fileHandle, 5, g_fileId++);
+            return true;
+        }
+
+        case MAKE_ID('X', 'O', 'B', 6): {
+            readXOBn(fileHandle, 6, g_fileId++);
+            return true;
+        }
+
         case MAKE_ID('X', 'L', 'B', 0): {
             readXLB0(fileHandle);
             return true;
         }
 
+        case MAKE_ID('X', 'L', 'B', 1): {
+            if (fileName == NULL)
+                error("Indexed libraries cannot be library members");
+
+            lib_ReadIndexed(fileHandle, fileName);
+            return false;
+        }
+
         case MAKE_ID(0x7F, 'E', 'L', 'F'): {
             elf_Read(fileHandle, g_fileId++);
             return false;
@@ -430,9 +635,10 @@ obj_Read(char* fileName) {
 
     if ((fileHandle = fopen(fileName, "rb")) != NULL) {
         size_t size = fsize(fileHandle);
+        stats_Add(STAT_BYTES_READ, size);
 
         while ((size_t) ftell(fileHandle) < size
-             && readChunk(fileHandle))
+             && readChunk(fileHandle, fileName))
         {}
 
         fclose(fileHandle);
@@ -440,3 +646,9 @@ obj_Read(char* fileName) {
         error("File \"%s\" not found", fileName);
     }
 }
+
+void
+obj_ReadModule(FILE* fileHandle) {
+    readChunk(fileHandle, NULL);
+}
+
@@ -20,6 +20,7 @@
 #define XLINK_OBJECT_H_INCLUDED_
 
 #include <stdint.h>
+#include <stdio.h>
 
 #include "symbol.h"
 
@@ -60,4 +61,7 @@ groups_GetGroup(Groups* groups, uint32_t groupId) {
 extern void
 obj_Read(char* fileName);
 
+extern void
+obj_ReadModule(FILE* fileHandle);
+
 #endif
@@ -16,8 +16,18 @@
     along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <setjmp.h>
 #include <string.h>
 
+#if defined(HAVE_THREADS)
+#	if defined(_WIN32)
+#		include <windows.h>
+#	else
+#		include <pthread.h>
+#		include <unistd.h>
+#	endif
+#endif
+
 #include "fmath.h"
 #include "mem.h"
 #include "str.h"
@@ -38,15 +48,14 @@ typedef struct StackEntry_ {
 } StackEntry;
 
 static char* g_stringStack[STACKSIZE];
-static StackEntry g_stack[STACKSIZE];
-static int32_t g_stackIndex;
+static int32_t g_stringStackIndex;
 
 static void
 pushString(char* stringValue) {
-    if (g_stackIndex >= STACKSIZE)
+    if (g_stringStackIndex >= STACKSIZE)
         error("patch too complex");
 
-    g_stringStack[g_stackIndex++] = stringValue;
+    g_stringStack[g_stringStackIndex++] = stringValue;
 }
 
 static void
@@ -68,8 +77,8 @@ pushIntAsString(uint32_t intValue) {
 
 static char*
 popString(void) {
-    if (g_stackIndex > 0)
-        return g_stringStack[--g_stackIndex];
+    if (g_stringStackIndex > 0)
+        return g_stringStack[--g_stringStackIndex];
 
     error("mangled patch");
     return NULL;
@@ -81,35 +90,6 @@ popStringPair(char** outLeft, char** outRight) {
     *outLeft = popString();
 }
 
-static void
-pushSymbolInt(SSymbol* symbol, int32_t value) {
-    if (g_stackIndex >= STACKSIZE)
-        error("patch too complex");
-
-    StackEntry entry = {symbol, value};
-    g_stack[g_stackIndex++] = entry;
-}
-
-static void
-pushInt(int32_t value) {
-    pushSymbolInt(NULL, value);
-}
-
-static StackEntry
-popInt(void) {
-    if (g_stackIndex > 0)
-        return g_stack[--g_stackIndex];
-
-    error("mangled patch");
-    return g_stack[0]; // dummy return
-}
-
-static void
-popIntPair(StackEntry* outLeft, StackEntry* outRight) {
-    *outRight = popInt();
-    *outLeft = popInt();
-}
-
 static void
 combinePatchStrings(char* operator) {
     char* left;
@@ -167,7 +147,7 @@ makePatchString(SPatch* patch, SSection* section) {
     int32_t size = patch->expressionSize;
     uint8_t* expression = patch->expression;
 
-    g_stackIndex = 0;
+    g_stringStackIndex = 0;
 
     while (size-- > 0) {
         char* left;
@@ -332,302 +312,499 @@ makePatchString(SPatch* patch, SSection* section) {
     return popString();
 }
 
-#define combine_bitwise(left, right, operator) \
-    popIntPair(&(left), &(right)); \
-    if ((left).symbol == NULL && (right).symbol == NULL) { \
-        pushInt((uint32_t)(left).value operator (uint32_t)(right).value); \
-    } else { \
-        error("Expression \"%s\" at offset %d in section \"%s\" attempts to combine two values from different sections", makePatchString(patch, section), patch->offset, section->name); \
+/*
+ * Patch expressions are stored as RPN byte streams. The most common shapes - a lone constant or
+ * symbol, a symbol plus or minus a constant and a PC relative reference - are recognised directly
+ * from the byte stream and calculated without any stack. All other expressions are first compiled
+ * into an array of operations, each holding the handler that executes it and its operand, with
+ * symbol ids turned into symbol pointers. The evaluator then simply calls one handler after the
+ * other.
+ */
+
+/*
+ * Sections are patched in parallel when there are enough patches to make it worthwhile. Each
+ * worker has its own context, and instead of reporting an error it abandons the section at the
+ * offending patch. The abandoned sections are then patched serially in section order, which
+ * reports the same error the serial path would.
+ */
+
+#define MIN_PATCHES_PER_WORKER 4096
+#define MAX_WORKERS 16
+
+typedef struct PatchOperation_ SPatchOperation;
+
+typedef struct PatchContext_ {
+    bool allowReloc;
+    bool onlySectionRelativeReloc;
+    bool allowImports;
+
+    SPatchOperation* operations;
+    uint32_t operationsCapacity;
+
+    // When not NULL, errors jump here instead of being reported
+    jmp_buf* failure;
+    uint32_t patchIndex;
+} SPatchContext;
+
+// Abandons the patch when running on a worker, the caller reports the error otherwise
+#define PATCH_ERROR(context, ...) \
+    do { \
+        abandonPatch(context); \
+        error(__VA_ARGS__); \
+    } while (0)
+
+static void
+abandonPatch(SPatchContext* context) {
+    if (context->failure != NULL)
+        longjmp(*context->failure, 1);
+}
+
+typedef struct Evaluator_ {
+    SPatchContext* context;
+    SPatch* patch;
+    SSection* section;
+    uint32_t stackIndex;
+    StackEntry stack[STACKSIZE];
+} SEvaluator;
+
+// Returns false if the value cannot be calculated yet
+typedef bool (*PatchHandler)(SEvaluator* evaluator, const SPatchOperation* operation);
+
+struct PatchOperation_ {
+    PatchHandler handler;
+    union {
+        int32_t value;
+        SSymbol* symbol;
+    } operand;
+};
+
+static void
+pushSymbolInt(SEvaluator* evaluator, SSymbol* symbol, int32_t value) {
+    if (evaluator->stackIndex >= STACKSIZE)
+        PATCH_ERROR(evaluator->context, "patch too complex");
+
+    StackEntry entry = {symbol, value};
+    evaluator->stack[evaluator->stackIndex++] = entry;
+}
+
+static void
+pushInt(SEvaluator* evaluator, int32_t value) {
+    pushSymbolInt(evaluator, NULL, value);
+}
+
+static StackEntry
+popInt(SEvaluator* evaluator) {
+    if (evaluator->stackIndex == 0)
+        PATCH_ERROR(evaluator->context, "mangled patch");
+
+    return evaluator->stack[--evaluator->stackIndex];
+}
+
+static void
+popIntPair(SEvaluator* evaluator, StackEntry* outLeft, StackEntry* outRight) {
+    *outRight = popInt(evaluator);
+    *outLeft = popInt(evaluator);
+}
+
+NORETURN (static void expressionError(SEvaluator* evaluator, const char* problem));
+
+static void
+expressionError(SEvaluator* evaluator, const char* problem) {
+    abandonPatch(evaluator->context);
+    error("Expression \"%s\" at offset %d in section \"%s\" %s",
+          makePatchString(evaluator->patch, evaluator->section), evaluator->patch->offset, evaluator->section->name, problem);
+}
+
+static uint32_t
+readOperand(const uint8_t* expression) {
+    return (uint32_t) expression[0] | (uint32_t) expression[1] << 8u | (uint32_t) expression[2] << 16u | (uint32_t) expression[3] << 24u;
+}
+
+static SSymbol*
+symbolOperand(SPatchContext* context, SSection* section, uint32_t symbolId) {
+    if (symbolId >= section->totalSymbols)
+        PATCH_ERROR(context, "Symbol ID out of range");
+
+    return &section->symbols[symbolId];
+}
+
+/* Symbols are resolved before the workers start, so any symbol still unresolved has no definition.
+ * Resolving it again is harmless for an import when imports are allowed, otherwise it is an error
+ * left for the serial path to report.
+ */
+static void
+resolveSymbol(SPatchContext* context, SSection* section, SSymbol* symbol, bool allowImports) {
+    if (!symbol->resolved) {
+        if (context->failure == NULL)
+            sect_ResolveSymbol(section, symbol, allowImports);
+        else if (!allowImports || symbol->type != SYM_IMPORT)
+            abandonPatch(context);
     }
+}
+
+// A symbol in a section that has been placed is a constant, otherwise it's relative to the section
+static StackEntry
+symbolEntry(SPatchContext* context, SSection* section, SSymbol* symbol) {
+    resolveSymbol(context, section, symbol, context->allowImports);
+
+    if (symbol->section != NULL && (symbol->section->cpuLocation != -1 || symbol->section->group == NULL)) {
+        StackEntry entry = {NULL, symbol->value};
+        return entry;
+    } else {
+        StackEntry entry = {symbol, 0};
+        return entry;
+    }
+}
 
-#define combine_operator(left, right, operator) \
-    popIntPair(&(left), &(right)); \
-    if ((left).symbol == NULL && (right).symbol == NULL) { \
-        pushInt((left).value operator (right).value); \
-    } else { \
-        error("Expression \"%s\" at offset %d in section \"%s\" attempts to combine two values from different sections", makePatchString(patch, section), patch->offset, section->name); \
+#define BITWISE_HANDLER(name, operator) \
+    static bool \
+    name(SEvaluator* evaluator, const SPatchOperation* operation) { \
+        StackEntry left, right; \
+        popIntPair(evaluator, &left, &right); \
+        if (left.symbol != NULL || right.symbol != NULL) \
+            expressionError(evaluator, "attempts to combine two values from different sections"); \
+        pushInt(evaluator, (uint32_t) left.value operator (uint32_t) right.value); \
+        return true; \
     }
 
-#define combine_func(left, right, operator) \
-    popIntPair(&(left), &(right)); \
-    if ((left).symbol == NULL && (right).symbol == NULL) { \
-        pushInt(operator((left).value, (right).value)); \
-    } else { \
-        error("Expression \"%s\" at offset %d in section \"%s\" attempts to combine two values from different sections", makePatchString(patch, section), patch->offset, section->name); \
+#define OPERATOR_HANDLER(name, operator) \
+    static bool \
+    name(SEvaluator* evaluator, const SPatchOperation* operation) { \
+        StackEntry left, right; \
+        popIntPair(evaluator, &left, &right); \
+        if (left.symbol != NULL || right.symbol != NULL) \
+            expressionError(evaluator, "attempts to combine two values from different sections"); \
+        pushInt(evaluator, left.value operator right.value); \
+        return true; \
     }
 
-#define unary(left, operator) \
-    (left) = popInt(); \
-    if ((left).symbol == NULL) { \
-        pushSymbolInt((left).symbol, operator((left).value)); \
-    } else { \
-        error("Expression \"%s\" at offset %d in section \"%s\" attempts to perform a unary operation on a value relative to a section", makePatchString(patch, section), patch->offset, section->name); \
+#define FUNCTION_HANDLER(name, function) \
+    static bool \
+    name(SEvaluator* evaluator, const SPatchOperation* operation) { \
+        StackEntry left, right; \
+        popIntPair(evaluator, &left, &right); \
+        if (left.symbol != NULL || right.symbol != NULL) \
+            expressionError(evaluator, "attempts to combine two values from different sections"); \
+        pushInt(evaluator, function(left.value, right.value)); \
+        return true; \
     }
 
+#define UNARY_HANDLER(name, operator) \
+    static bool \
+    name(SEvaluator* evaluator, const SPatchOperation* operation) { \
+        StackEntry left = popInt(evaluator); \
+        if (left.symbol != NULL) \
+            expressionError(evaluator, "attempts to perform a unary operation on a value relative to a section"); \
+        pushInt(evaluator, operator(left.value)); \
+        return true; \
+    }
+
+BITWISE_HANDLER(handleXor, ^)
+BITWISE_HANDLER(handleOr, |)
+BITWISE_HANDLER(handleAnd, &)
+OPERATOR_HANDLER(handleShiftLeft, <<)
+OPERATOR_HANDLER(handleShiftRight, >>)
+OPERATOR_HANDLER(handleMultiply, *)
+OPERATOR_HANDLER(handleDivide, /)
+OPERATOR_HANDLER(handleModulo, %)
+OPERATOR_HANDLER(handleBooleanOr, ||)
+OPERATOR_HANDLER(handleBooleanAnd, &&)
+OPERATOR_HANDLER(handleGreaterOrEqual, >=)
+OPERATOR_HANDLER(handleGreaterThan, >)
+OPERATOR_HANDLER(handleLessOrEqual, <=)
+OPERATOR_HANDLER(handleLessThan, <)
+OPERATOR_HANDLER(handleEquals, ==)
+OPERATOR_HANDLER(handleNotEquals, !=)
+FUNCTION_HANDLER(handleFdiv, fdiv)
+FUNCTION_HANDLER(handleFmul, fmul)
+FUNCTION_HANDLER(handleAtan2, fatan2)
+UNARY_HANDLER(handleBooleanNot, !)
+UNARY_HANDLER(handleSin, fsin)
+UNARY_HANDLER(handleCos, fcos)
+UNARY_HANDLER(handleTan, ftan)
+UNARY_HANDLER(handleAsin, fasin)
+UNARY_HANDLER(handleAcos, facos)
+UNARY_HANDLER(handleAtan, fatan)
+
 static bool
-calculatePatchValue(SPatch* patch, SSection* section, bool allowImports, int32_t* outValue, SSymbol** outSymbol) {
-    int32_t size = patch->expressionSize;
-    uint8_t* expression = patch->expression;
+handleSubtract(SEvaluator* evaluator, const SPatchOperation* operation) {
+    StackEntry left, right;
+    popIntPair(evaluator, &left, &right);
+
+    if (left.symbol == NULL && right.symbol == NULL)
+        pushInt(evaluator, left.value - right.value);
+    else if (left.symbol != NULL && right.symbol == NULL)
+        pushSymbolInt(evaluator, left.symbol, left.value - right.value);
+    else if (left.symbol != NULL && right.symbol != NULL && left.symbol->section == right.symbol->section)
+        pushInt(evaluator, left.symbol->value - right.symbol->value);
+    else
+        expressionError(evaluator, "attempts to subtract two values from different sections");
+
+    return true;
+}
 
-    g_stackIndex = 0;
+static bool
+handleAdd(SEvaluator* evaluator, const SPatchOperation* operation) {
+    StackEntry left, right;
+    popIntPair(evaluator, &left, &right);
+
+    if (left.symbol == NULL && right.symbol == NULL)
+        pushInt(evaluator, left.value + right.value);
+    else if (right.symbol == NULL)
+        pushSymbolInt(evaluator, left.symbol, left.value + right.value);
+    else if (left.symbol == NULL)
+        pushSymbolInt(evaluator, right.symbol, left.value + right.value);
+    else
+        expressionError(evaluator, "attempts to add two values from different sections");
+
+    return true;
+}
 
-    while (size > 0) {
-        StackEntry left, right;
+static bool
+handleLowLimit(SEvaluator* evaluator, const SPatchOperation* operation) {
+    StackEntry left, right;
+    popIntPair(evaluator, &left, &right);
 
-        --size;
+    if (left.symbol != NULL || right.symbol != NULL || left.value < right.value)
+        PATCH_ERROR(evaluator->context, "Expression \"%s\" at offset %d in section \"%s\" out of range (%d must be >= %d)",
+              makePatchString(evaluator->patch, evaluator->section), evaluator->patch->offset, evaluator->section->name, left.value, right.value);
 
-        switch ((EExpressionOperator) *expression++) {
-            case OBJ_OP_SUB: {
-                popIntPair(&left, &right);
-                if (left.symbol == NULL && right.symbol == NULL)
-                    pushInt(left.value - right.value);
-                else if (left.symbol != NULL && right.symbol == NULL)
-                    pushSymbolInt(left.symbol, left.value - right.value);
-                else if (left.symbol != NULL && right.symbol != NULL && left.symbol->section == right.symbol->section)
-                    pushInt(left.symbol->value - right.symbol->value);
-                else
-                    error("Expression \"%s\" at offset %d in section \"%s\" attempts to subtract two values from different sections",
-                          makePatchString(patch, section), patch->offset, section->name);
-                break;
-            }
-            case OBJ_OP_ADD: {
-                popIntPair(&left, &right);
-                if (left.symbol == NULL && right.symbol == NULL)
-                    pushInt(left.value + right.value);
-                else if (right.symbol == NULL)
-                    pushSymbolInt(left.symbol, left.value + right.value);
-                else if (left.symbol == NULL)
-                    pushSymbolInt(right.symbol, left.value + right.value);
-                else
-                    error("Expression \"%s\" at offset %d in section \"%s\" attempts to add two values from different sections",
-                          makePatchString(patch, section), patch->offset, section->name);
-                break;
-            }
-            case OBJ_OP_XOR: {
-                combine_bitwise(left, right, ^)
-                break;
-            }
-            case OBJ_OP_OR: {
-                combine_bitwise(left, right, |)
-                break;
-            }
-            case OBJ_OP_AND: {
-                combine_bitwise(left, right, &)
-                break;
-            }
-            case OBJ_OP_ASL: {
-                combine_operator(left, right, <<)
-                break;
-            }
-            case OBJ_OP_ASR: {
-                combine_operator(left, right, >>)
-                break;
-            }
-            case OBJ_OP_MUL: {
-                combine_operator(left, right, *)
-                break;
-            }
-            case OBJ_OP_DIV: {
-                combine_operator(left, right, /)
-                break;
-            }
-            case OBJ_OP_MOD: {
-                combine_operator(left, right, %)
-                break;
-            }
-            case OBJ_OP_BOOLEAN_OR: {
-                combine_operator(left, right, ||)
-                break;
-            }
-            case OBJ_OP_BOOLEAN_AND: {
-                combine_operator(left, right, &&)
-                break;
-            }
-            case OBJ_OP_GREATER_OR_EQUAL: {
-                combine_operator(left, right, >=)
-                break;
-            }
-            case OBJ_OP_GREATER_THAN: {
-                combine_operator(left, right, >)
-                break;
-            }
-            case OBJ_OP_LESS_OR_EQUAL: {
-                combine_operator(left, right, <=)
-                break;
-            }
-            case OBJ_OP_LESS_THAN: {
-                combine_operator(left, right, <)
-                break;
-            }
-            case OBJ_OP_EQUALS: {
-                combine_operator(left, right, ==)
-                break;
-            }
-            case OBJ_OP_NOT_EQUALS: {
-                combine_operator(left, right, !=)
-                break;
-            }
-            case OBJ_OP_BOOLEAN_NOT: {
-                unary(left, !)
-                break;
-            }
-            case OBJ_FUNC_SIN: {
-                unary(left, fsin)
-                break;
-            }
-            case OBJ_FUNC_COS: {
-                unary(left, fcos)
-                break;
-            }
-            case OBJ_FUNC_TAN: {
-                unary(left, ftan)
-                break;
-            }
-            case OBJ_FUNC_ASIN: {
-                unary(left, fasin)
-                break;
-            }
-            case OBJ_FUNC_ACOS: {
-                unary(left, facos)
-                break;
-            }
-            case OBJ_FUNC_ATAN: {
-                unary(left, fatan)
-                break;
-            }
-            case OBJ_FUNC_LOW_LIMIT: {
-                popIntPair(&left, &right);
+    pushInt(evaluator, left.value);
+    return true;
+}
 
-                if (left.symbol == NULL && right.symbol == NULL && left.value >= right.value)
-                    pushInt(left.value);
-                else
-                    error("Expression \"%s\" at offset %d in section \"%s\" out of range (%d must be >= %d)",
-                          makePatchString(patch, section), patch->offset, section->name, left.value, right.value);
+static bool
+handleHighLimit(SEvaluator* evaluator, const SPatchOperation* operation) {
+    StackEntry left, right;
+    popIntPair(evaluator, &left, &right);
 
-                break;
-            }
-            case OBJ_FUNC_HIGH_LIMIT: {
-                popIntPair(&left, &right);
+    if (left.symbol != NULL || right.symbol != NULL || left.value > right.value)
+        PATCH_ERROR(evaluator->context, "Expression \"%s\" at offset %d in section \"%s\" out of range (%d must be <= %d)",
+              makePatchString(evaluator->patch, evaluator->section), evaluator->patch->offset, evaluator->section->name, left.value, right.value);
 
-                if (left.symbol == NULL && right.symbol == NULL && left.value <= right.value)
-                    pushInt(left.value);
-                else
-                    error("Expression \"%s\" at offset %d in section \"%s\" out of range (%d must be <= %d)",
-                          makePatchString(patch, section), patch->offset, section->name, left.value, right.value);
+    pushInt(evaluator, left.value);
+    return true;
+}
 
-                break;
-            }
-            case OBJ_FUNC_FDIV: {
-                combine_func(left, right, fdiv)
-                break;
-            }
-            case OBJ_FUNC_FMUL: {
-                combine_func(left, right, fmul)
-                break;
-            }
-            case OBJ_FUNC_ATAN2: {
-                combine_func(left, right, fatan2)
-                break;
-            }
-            case OBJ_CONSTANT: {
-                uint32_t value;
+static bool
+handleAssert(SEvaluator* evaluator, const SPatchOperation* operation) {
+    StackEntry left, right;
+    popIntPair(evaluator, &left, &right);
 
-                value = (*expression++);
-                value |= (*expression++) << 8u;
-                value |= (*expression++) << 16u;
-                value |= (*expression++) << 24u;
+    if (left.symbol != NULL || right.symbol != NULL || right.value == 0)
+        PATCH_ERROR(evaluator->context, "Expression \"%s\" (=%d) at offset %d in section \"%s\" out of range",
+              makePatchString(evaluator->patch, evaluator->section), left.value, evaluator->patch->offset, evaluator->section->name);
 
-                pushInt(value);
+    pushInt(evaluator, left.value);
+    return true;
+}
 
-                size -= 4;
-                break;
-            }
-            case OBJ_SYMBOL: {
-                uint32_t symbolId;
-                SSymbol* symbol;
+static bool
+handleConstant(SEvaluator* evaluator, const SPatchOperation* operation) {
+    pushInt(evaluator, operation->operand.value);
+    return true;
+}
 
-                symbolId = (*expression++);
-                symbolId |= (*expression++) << 8u;
-                symbolId |= (*expression++) << 16u;
-                symbolId |= (*expression++) << 24u;
+static bool
+handleSymbol(SEvaluator* evaluator, const SPatchOperation* operation) {
+    StackEntry entry = symbolEntry(evaluator->context, evaluator->section, operation->operand.symbol);
+    pushSymbolInt(evaluator, entry.symbol, entry.value);
+    return true;
+}
 
-                symbol = sect_GetSymbol(section, symbolId, allowImports);
-                if (symbol->section != NULL && (symbol->section->cpuLocation != -1 || symbol->section->group == NULL))
-                    pushSymbolInt(NULL, symbol->value);
-                else
-                    pushSymbolInt(symbol, 0);
-                size -= 4;
-                break;
-            }
-            case OBJ_FUNC_BANK: {
-                uint32_t symbolId;
-                int32_t bank;
+static bool
+handleBank(SEvaluator* evaluator, const SPatchOperation* operation) {
+    SSymbol* symbol = operation->operand.symbol;
+    resolveSymbol(evaluator->context, evaluator->section, symbol, false);
 
-                symbolId = (*expression++);
-                symbolId |= (*expression++) << 8u;
-                symbolId |= (*expression++) << 16u;
-                symbolId |= (*expression++) << 24u;
+    int32_t bank = symbol->section->cpuBank;
+    if (bank == -1)
+        return false;
 
-                if (!sect_GetConstantSymbolBank(section, symbolId, &bank))
-                    return false;
+    pushInt(evaluator, bank);
+    return true;
+}
 
-                pushInt(bank);
-                size -= 4;
-                break;
-            }
-            case OBJ_PC_REL: {
-                combine_operator(left, right, +)
-                left = popInt();
-                if (left.symbol == NULL)
-                    pushInt(left.value - (section->cpuLocation + patch->offset));
-                else if (left.symbol->section == section)
-                    pushInt(left.symbol->value + left.value - patch->offset);
-                else
-                    error("Illegal PC relative expression \"%s\" at offset %d in section \"%s\" attempts to subtract two values from different sections",
-                          makePatchString(patch, section), patch->offset, section->name);
-                break;
-            }
-            case OBJ_FUNC_ASSERT: {
-                popIntPair(&left, &right);
+static bool
+handlePcRelative(SEvaluator* evaluator, const SPatchOperation* operation) {
+    StackEntry left, right;
+    popIntPair(evaluator, &left, &right);
 
-                if (left.symbol == NULL && right.symbol == NULL && right.value != 0)
-                    pushInt(left.value);
-                else
-                    error("Expression \"%s\" (=%d) at offset %d in section \"%s\" out of range",
-                          makePatchString(patch, section), left.value, patch->offset, section->name);
-                break;
-            }
-            default: {
-                error("Unknown patch operator");
-                break;
+    if (left.symbol != NULL || right.symbol != NULL)
+        expressionError(evaluator, "attempts to combine two values from different sections");
+
+    pushInt(evaluator, left.value + right.value - (evaluator->section->cpuLocation + evaluator->patch->offset));
+    return true;
+}
+
+static const PatchHandler g_handlers[] = {
+    [OBJ_OP_SUB] = handleSubtract,
+    [OBJ_OP_ADD] = handleAdd,
+    [OBJ_OP_XOR] = handleXor,
+    [OBJ_OP_OR] = handleOr,
+    [OBJ_OP_AND] = handleAnd,
+    [OBJ_OP_ASL] = handleShiftLeft,
+    [OBJ_OP_ASR] = handleShiftRight,
+    [OBJ_OP_MUL] = handleMultiply,
+    [OBJ_OP_DIV] = handleDivide,
+    [OBJ_OP_MOD] = handleModulo,
+    [OBJ_OP_BOOLEAN_OR] = handleBooleanOr,
+    [OBJ_OP_BOOLEAN_AND] = handleBooleanAnd,
+    [OBJ_OP_BOOLEAN_NOT] = handleBooleanNot,
+    [OBJ_OP_GREATER_OR_EQUAL] = handleGreaterOrEqual,
+    [OBJ_OP_GREATER_THAN] = handleGreaterThan,
+    [OBJ_OP_LESS_OR_EQUAL] = handleLessOrEqual,
+    [OBJ_OP_LESS_THAN] = handleLessThan,
+    [OBJ_OP_EQUALS] = handleEquals,
+    [OBJ_OP_NOT_EQUALS] = handleNotEquals,
+    [OBJ_FUNC_LOW_LIMIT] = handleLowLimit,
+    [OBJ_FUNC_HIGH_LIMIT] = handleHighLimit,
+    [OBJ_FUNC_FDIV] = handleFdiv,
+    [OBJ_FUNC_FMUL] = handleFmul,
+    [OBJ_FUNC_ATAN2] = handleAtan2,
+    [OBJ_FUNC_SIN] = handleSin,
+    [OBJ_FUNC_COS] = handleCos,
+    [OBJ_FUNC_TAN] = handleTan,
+    [OBJ_FUNC_ASIN] = handleAsin,
+    [OBJ_FUNC_ACOS] = handleAcos,
+    [OBJ_FUNC_ATAN] = handleAtan,
+    [OBJ_CONSTANT] = handleConstant,
+    [OBJ_SYMBOL] = handleSymbol,
+    [OBJ_PC_REL] = handlePcRelative,
+    [OBJ_FUNC_BANK] = handleBank,
+    [OBJ_FUNC_ASSERT] = handleAssert
+};
+
+#define TOTAL_HANDLERS (sizeof(g_handlers) / sizeof(g_handlers[0]))
+
+static uint32_t
+compilePatch(SPatchContext* context, const SPatch* patch, SSection* section) {
+    if (patch->expressionSize > context->operationsCapacity) {
+        context->operationsCapacity = patch->expressionSize;
+        context->operations = mem_Realloc(context->operations, sizeof(SPatchOperation) * context->operationsCapacity);
+    }
+
+    const uint8_t* expression = patch->expression;
+    const uint8_t* end = expression + patch->expressionSize;
+    SPatchOperation* operation = context->operations;
+
+    while (expression < end) {
+        uint8_t operator = *expression++;
+
+        if (operator >= TOTAL_HANDLERS)
+            PATCH_ERROR(context, "Unknown patch operator");
+
+        operation->handler = g_handlers[operator];
+
+        if (operator == OBJ_CONSTANT || operator == OBJ_SYMBOL || operator == OBJ_FUNC_BANK) {
+            if (end - expression < 4)
+                PATCH_ERROR(context, "mangled patch");
+
+            uint32_t operand = readOperand(expression);
+            expression += 4;
+
+            if (operator == OBJ_CONSTANT)
+                operation->operand.value = (int32_t) operand;
+            else
+                operation->operand.symbol = symbolOperand(context, section, operand);
+        }
+
+        ++operation;
+    }
+
+    return (uint32_t) (operation - context->operations);
+}
+
+static bool
+calculateCommonPatchValue(SPatchContext* context, const SPatch* patch, SSection* section, StackEntry* outEntry) {
+    const uint8_t* expression = patch->expression;
+
+    if (patch->expressionSize == 5) {
+        if (expression[0] == OBJ_CONSTANT) {
+            outEntry->symbol = NULL;
+            outEntry->value = (int32_t) readOperand(&expression[1]);
+            return true;
+        } else if (expression[0] == OBJ_SYMBOL) {
+            *outEntry = symbolEntry(context, section, symbolOperand(context, section, readOperand(&expression[1])));
+            return true;
+        }
+    } else if (patch->expressionSize == 11) {
+        uint8_t operator = expression[10];
+
+        if (expression[0] == OBJ_SYMBOL && expression[5] == OBJ_CONSTANT && (operator == OBJ_OP_ADD || operator == OBJ_OP_SUB)) {
+            StackEntry entry = symbolEntry(context, section, symbolOperand(context, section, readOperand(&expression[1])));
+            int32_t constant = (int32_t) readOperand(&expression[6]);
+
+            entry.value = operator == OBJ_OP_ADD ? entry.value + constant : entry.value - constant;
+            *outEntry = entry;
+            return true;
+        } else if (expression[0] == OBJ_CONSTANT && expression[5] == OBJ_SYMBOL && (operator == OBJ_OP_ADD || operator == OBJ_PC_REL)) {
+            int32_t constant = (int32_t) readOperand(&expression[1]);
+            StackEntry entry = symbolEntry(context, section, symbolOperand(context, section, readOperand(&expression[6])));
+
+            if (operator == OBJ_OP_ADD) {
+                entry.value = constant + entry.value;
+                *outEntry = entry;
+                return true;
+            } else if (entry.symbol == NULL) {
+                outEntry->symbol = NULL;
+                outEntry->value = constant + entry.value - (section->cpuLocation + patch->offset);
+                return true;
             }
         }
     }
 
-    StackEntry entry = popInt();
+    return false;
+}
+
+static bool
+calculatePatchValue(SPatchContext* context, SPatch* patch, SSection* section, int32_t* outValue, SSymbol** outSymbol) {
+    StackEntry entry;
+
+    if (!calculateCommonPatchValue(context, patch, section, &entry)) {
+        SEvaluator evaluator;
+        evaluator.context = context;
+        evaluator.patch = patch;
+        evaluator.section = section;
+        evaluator.stackIndex = 0;
+
+        uint32_t totalOperations = compilePatch(context, patch, section);
+        const SPatchOperation* end = context->operations + totalOperations;
+
+        for (const SPatchOperation* operation = context->operations; operation != end; ++operation) {
+            if (!operation->handler(&evaluator, operation))
+                return false;
+        }
+
+        entry = popInt(&evaluator);
+        if (evaluator.stackIndex != 0)
+            return false;
+    }
+
     *outValue = entry.value;
     *outSymbol = entry.symbol;
-    return g_stackIndex == 0;
+    return true;
 }
 
+// Patches the section starting with patch number firstPatch
 static void
-patchSection(SSection* section, bool allowReloc, bool onlySectionRelativeReloc, bool allowImports) {
+patchSection(SPatchContext* context, SSection* section, uint32_t firstPatch) {
     SPatches* patches = section->patches;
+    bool allowReloc = context->allowReloc;
 
     if (patches != NULL) {
-        SPatch* patch = patches->patches;
-
-        for (uint32_t i = patches->totalPatches; i > 0; --i, ++patch) {
+        for (context->patchIndex = firstPatch; context->patchIndex < patches->totalPatches; ++context->patchIndex) {
+            SPatch* patch = &patches->patches[context->patchIndex];
             SSymbol* valueSymbol;
             int32_t value;
 
-            if (calculatePatchValue(patch, section, allowImports, &value, &valueSymbol)) {
+            if (calculatePatchValue(context, patch, section, &value, &valueSymbol)) {
                 if (valueSymbol != NULL) {
                     if (!allowReloc) {
-                        error("Expression \"%s\" at offset %d in section \"%s\" is relocatable",
+                        PATCH_ERROR(context, "Expression \"%s\" at offset %d in section \"%s\" is relocatable",
                               makePatchString(patch, section), patch->offset, section->name);
                         return;
-                    } else if (onlySectionRelativeReloc || symbol_IsLocal(valueSymbol)) {
+                    } else if (context->onlySectionRelativeReloc || symbol_IsLocal(valueSymbol)) {
                         value += valueSymbol->value;
                         patch->valueSection = valueSymbol->section;
                         patch->valueSymbol = NULL;
@@ -643,7 +820,7 @@ patchSection(SSection* section, bool allowReloc, bool onlySectionRelativeReloc,
                         if (valueSymbol == NULL && value >= -128 && value <= 255)
                             section->data[patch->offset] = (uint8_t) value;
                         else
-                            error("Expression \"%s\" at offset %d in section \"%s\" out of range",
+                            PATCH_ERROR(context, "Expression \"%s\" at offset %d in section \"%s\" out of range",
                                   makePatchString(patch, section), patch->offset, section->name);
 
                         break;
@@ -653,7 +830,7 @@ patchSection(SSection* section, bool allowReloc, bool onlySectionRelativeReloc,
                             section->data[patch->offset + 0] = (uint8_t) value;
                             section->data[patch->offset + 1] = (uint8_t) ((uint32_t) value >> 8u);
                         } else {
-                            error("Expression \"%s\" at offset %d in section \"%s\" out of range",
+                            PATCH_ERROR(context, "Expression \"%s\" at offset %d in section \"%s\" out of range",
                                   makePatchString(patch, section), patch->offset, section->name);
                         }
                         break;
@@ -663,7 +840,7 @@ patchSection(SSection* section, bool allowReloc, bool onlySectionRelativeReloc,
                             section->data[patch->offset + 0] = (uint8_t) ((uint32_t) value >> 8u);
                             section->data[patch->offset + 1] = (uint8_t) value;
                         } else {
-                            error("Expression \"%s\" at offset %d in section \"%s\" out of range",
+                            PATCH_ERROR(context, "Expression \"%s\" at offset %d in section \"%s\" out of range",
                                   makePatchString(patch, section), patch->offset, section->name);
                         }
                         break;
@@ -687,7 +864,7 @@ patchSection(SSection* section, bool allowReloc, bool onlySectionRelativeReloc,
                         break;
                     }
                     default: {
-                        error("unhandled patch type");
+                        PATCH_ERROR(context, "unhandled patch type");
                         break;
                     }
                 }
@@ -708,12 +885,222 @@ patchSection(SSection* section, bool allowReloc, bool onlySectionRelativeReloc,
     }
 }
 
+static void
+initContext(SPatchContext* context, bool allowReloc, bool onlySectionRelativeReloc, bool allowImports) {
+    context->allowReloc = allowReloc;
+    context->onlySectionRelativeReloc = onlySectionRelativeReloc;
+    context->allowImports = allowImports;
+    context->operations = NULL;
+    context->operationsCapacity = 0;
+    context->failure = NULL;
+    context->patchIndex = 0;
+}
+
+#if defined(HAVE_THREADS)
+
+typedef struct PatchWorker_ {
+    SPatchContext context;
+    SSection** sections;
+    uint32_t* firstUnpatched;
+    uint32_t first;
+    uint32_t end;
+    uint32_t current;
+} SPatchWorker;
+
+static void
+patchWorkerSections(SPatchWorker* worker) {
+    jmp_buf failure;
+    worker->context.failure = &failure;
+
+    for (worker->current = worker->first; worker->current < worker->end; ++worker->current) {
+        if (setjmp(failure) == 0)
+            patchSection(&worker->context, worker->sections[worker->current], 0);
+        else
+            worker->firstUnpatched[worker->current] = worker->context.patchIndex;
+    }
+}
+
+#if defined(_WIN32)
+
+typedef HANDLE Thread;
+
+static DWORD WINAPI
+workerThread(LPVOID data) {
+    patchWorkerSections((SPatchWorker*) data);
+    return 0;
+}
+
+static bool
+startThread(Thread* thread, SPatchWorker* worker) {
+    *thread = CreateThread(NULL, 0, workerThread, worker, 0, NULL);
+    return *thread != NULL;
+}
+
+static void
+joinThread(Thread thread) {
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+static uint32_t
+totalProcessors(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+}
+
+#else
+
+typedef pthread_t Thread;
+
+static void*
+workerThread(void* data) {
+    patchWorkerSections((SPatchWorker*) data);
+    return NULL;
+}
+
+static bool
+startThread(Thread* thread, SPatchWorker* worker) {
+    return pthread_create(thread, NULL, workerThread, worker) == 0;
+}
+
+static void
+joinThread(Thread thread) {
+    pthread_join(thread, NULL);
+}
+
+static uint32_t
+totalProcessors(void) {
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    return processors > 0 ? (uint32_t) processors : 1;
+}
+
+#endif
+
+static uint32_t
+totalPatches(SSection* section) {
+    return section->patches != NULL ? section->patches->totalPatches : 0;
+}
+
+// Splits the sections into ranges with roughly the same number of patches
+static void
+partitionSections(SPatchWorker* workers, uint32_t totalWorkers, SSection** sections, uint32_t totalSections, uint32_t patches) {
+    uint32_t section = 0;
+    uint32_t patchesSoFar = 0;
+
+    for (uint32_t i = 0; i < totalWorkers; ++i) {
+        uint32_t target = (uint32_t) ((uint64_t) patches * (i + 1) / totalWorkers);
+
+        workers[i].first = section;
+        while (section < totalSections && (patchesSoFar < target || i == totalWorkers - 1))
+            patchesSoFar += totalPatches(sections[section++]);
+        workers[i].end = section;
+    }
+}
+
+static void
+patchInParallel(SPatchContext* context, uint32_t totalWorkers, uint32_t totalUsedSections, uint32_t patches) {
+    SSection** sections = mem_Alloc(sizeof(SSection*) * totalUsedSections);
+    uint32_t* firstUnpatched = mem_Alloc(sizeof(uint32_t) * totalUsedSections);
+    SPatchWorker* workers = mem_Alloc(sizeof(SPatchWorker) * totalWorkers);
+    Thread* threads = mem_Alloc(sizeof(Thread) * totalWorkers);
+
+    uint32_t index = 0;
+    for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
+        if (section->used) {
+            sections[index] = section;
+            firstUnpatched[index] = totalPatches(section);
+            ++index;
+        }
+    }
+
+    partitionSections(workers, totalWorkers, sections, totalUsedSections, patches);
+
+    for (uint32_t i = 0; i < totalWorkers; ++i) {
+        initContext(&workers[i].context, context->allowReloc, context->onlySectionRelativeReloc, context->allowImports);
+        workers[i].sections = sections;
+        workers[i].firstUnpatched = firstUnpatched;
+    }
+
+    // The first range is patched on this thread, as is any range a thread couldn't be started for
+    bool* started = mem_Alloc(sizeof(bool) * totalWorkers);
+    for (uint32_t i = 1; i < totalWorkers; ++i)
+        started[i] = startThread(&threads[i], &workers[i]);
+
+    patchWorkerSections(&workers[0]);
+
+    for (uint32_t i = 1; i < totalWorkers; ++i) {
+        if (started[i])
+            joinThread(threads[i]);
+        else
+            patchWorkerSections(&workers[i]);
+    }
+
+    for (uint32_t i = 0; i < totalUsedSections; ++i) {
+        if (firstUnpatched[i] < totalPatches(sections[i]))
+            patchSection(context, sections[i], firstUnpatched[i]);
+    }
+
+    for (uint32_t i = 0; i < totalWorkers; ++i)
+        mem_Free(workers[i].context.operations);
+
+    mem_Free(started);
+    mem_Free(threads);
+    mem_Free(workers);
+    mem_Free(firstUnpatched);
+    mem_Free(sections);
+}
+
+// Patches the sections on several threads if there are enough patches, returns false if they must be patched serially
+static bool
+patchWithWorkers(SPatchContext* context) {
+    uint32_t totalUsedSections = 0;
+    uint32_t patches = 0;
+    for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
+        if (section->used) {
+            ++totalUsedSections;
+            patches += totalPatches(section);
+        }
+    }
+
+    uint32_t totalWorkers = patches / MIN_PATCHES_PER_WORKER;
+    uint32_t processors = totalProcessors();
+    if (totalWorkers > processors)
+        totalWorkers = processors;
+    if (totalWorkers > MAX_WORKERS)
+        totalWorkers = MAX_WORKERS;
+
+    if (totalWorkers <= 1 || totalUsedSections <= 1)
+        return false;
+
+    sect_ResolveDefined();
+    patchInParallel(context, totalWorkers, totalUsedSections, patches);
+    return true;
+}
+
+#else
+
+// Without threads the sections are always patched serially
+static bool
+patchWithWorkers(SPatchContext* context) {
+    return false;
+}
+
+#endif
+
 extern void
 patch_Process(bool allowReloc, bool onlySectionRelativeReloc, bool allowImports) {
-    for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
-        if (section->used)
-            patchSection(section, allowReloc, onlySectionRelativeReloc, allowImports);
+    SPatchContext context;
+    initContext(&context, allowReloc, onlySectionRelativeReloc, allowImports);
+
+    if (!patchWithWorkers(&context)) {
+        for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
+            if (section->used)
+                patchSection(&context, section, 0);
+        }
     }
+
+    mem_Free(context.operations);
 }
 
 extern SPatches*
@@ -65,6 +65,8 @@ typedef enum {
     OBJ_PC_REL,
     OBJ_FUNC_BANK,
     OBJ_FUNC_ASSERT,
+
+    OBJ_SMALL_CONSTANT = 0x80   // 0x80-0xFF push the constants 0-127, only found in object files
 } EExpressionOperator;
 
 typedef struct {
@@ -28,14 +28,129 @@
 
 SSection* sect_Sections = NULL;
 
+static SSection* g_lastSection = NULL;
+
 static uint32_t g_sectionId = 0;
 
+#define SYMBOL_HASH_SIZE 1024U
+
+typedef struct ExportedSymbol {
+    SSymbol* symbol;
+    SSection* section;
+    struct ExportedSymbol* nextSymbol;
+} SExportedSymbol;
+
+static SExportedSymbol* g_exportedSymbols[SYMBOL_HASH_SIZE];
+static SExportedSymbol* g_exportedSymbolPool = NULL;
+static bool g_exportedSymbolsValid = false;
+
+static uint32_t
+hashSymbolName(const char* name) {
+    uint32_t hash = 0;
+
+    while (*name != 0) {
+        hash += (uint8_t) *name++;
+        hash += hash << 10u;
+        hash ^= hash >> 6u;
+    }
+
+    hash += hash << 3u;
+    hash ^= hash >> 11u;
+    hash += hash << 15u;
+
+    return hash & (SYMBOL_HASH_SIZE - 1);
+}
+
+static bool
+isLinked(const SSection* section) {
+    return section->used || section->foldedInto != NULL;
+}
+
+static bool
+isExported(const SSymbol* symbol) {
+    return symbol->type == SYM_EXPORT || symbol->type == SYM_LOCALEXPORT;
+}
+
+static void
+indexExportedSymbols(void) {
+    uint32_t totalExports = 0;
+    for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
+        for (uint32_t i = 0; i < section->totalSymbols; ++i) {
+            if (isExported(&section->symbols[i]))
+                ++totalExports;
+        }
+    }
+
+    mem_Free(g_exportedSymbolPool);
+    g_exportedSymbolPool = mem_Alloc(sizeof(SExportedSymbol) * (totalExports + 1));
+
+    SExportedSymbol* entry = g_exportedSymbolPool;
+    for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
+        for (uint32_t i = 0; i < section->totalSymbols; ++i) {
+            if (isExported(&section->symbols[i])) {
+                entry->symbol = &section->symbols[i];
+                entry->section = section;
+                ++entry;
+            }
+        }
+    }
+
+    // Insert in reverse, so each bucket lists symbols in section order and the first definition is found first
+    memset(g_exportedSymbols, 0, sizeof(g_exportedSymbols));
+    while (entry-- != g_exportedSymbolPool) {
+        SExportedSymbol** bucket = &g_exportedSymbols[hashSymbolName(entry->symbol->name)];
+        entry->nextSymbol = *bucket;
+        *bucket = entry;
+    }
+
+    g_exportedSymbolsValid = true;
+}
+
+static SExportedSymbol*
+findExportedSymbol(const char* symbolName, ESymbolType symbolType, uint32_t fileId) {
+    if (!g_exportedSymbolsValid)
+        indexExportedSymbols();
+
+    for (SExportedSymbol* entry = g_exportedSymbols[hashSymbolName(symbolName)]; entry != NULL; entry = entry->nextSymbol) {
+        if (entry->symbol->type == symbolType
+        &&  (symbolType != SYM_LOCALEXPORT || entry->section->fileId == fileId)
+        &&  strcmp(entry->symbol->name, symbolName) == 0) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+// Finds the definition an imported symbol binds to, which is the first one in section order. Imports
+// bind to exports in used sections or the EQU section, local imports to any export from the same file.
+static SExportedSymbol*
+findDefinition(const SSymbol* symbol, const SSection* section) {
+    if (!g_exportedSymbolsValid)
+        indexExportedSymbols();
+
+    for (SExportedSymbol* entry = g_exportedSymbols[hashSymbolName(symbol->name)]; entry != NULL; entry = entry->nextSymbol) {
+        SSection* definingSection = entry->section;
+        bool visible = symbol->type == SYM_IMPORT
+            ? entry->symbol->type == SYM_EXPORT && (isLinked(definingSection) || definingSection->group == NULL)
+            : isLinked(definingSection) && definingSection->fileId == section->fileId;
+
+        if (visible && strcmp(entry->symbol->name, symbol->name) == 0)
+            return entry;
+    }
+
+    return NULL;
+}
+
 static void
 resolveSymbol(SSection* section, SSymbol* symbol, bool allowImports) {
     switch (symbol->type) {
         case SYM_LOCALEXPORT:
         case SYM_EXPORT:
         case SYM_LOCAL: {
+            if (section->foldedInto != NULL)
+                section = section->foldedInto;
+
             symbol->resolved = true;
             symbol->section = section;
 
@@ -45,58 +160,22 @@ resolveSymbol(SSection* section, SSymbol* symbol, bool allowImports) {
             break;
         }
 
-        case SYM_IMPORT: {
-            SSection* definingSection;
-
-            for (definingSection = sect_Sections;
-                 definingSection != NULL; definingSection = definingSection->nextSection) {
-                if (definingSection->used || definingSection->group == NULL) {
-                    uint32_t i;
-                    SSymbol* exportedSymbol = definingSection->symbols;
-
-                    for (i = 0; i < definingSection->totalSymbols; ++i, ++exportedSymbol) {
-                        if (exportedSymbol->type == SYM_EXPORT && strcmp(exportedSymbol->name, symbol->name) == 0) {
-                            if (!exportedSymbol->resolved)
-                                resolveSymbol(definingSection, exportedSymbol, allowImports);
-
-                            symbol->resolved = true;
-                            symbol->value = exportedSymbol->value;
-                            symbol->section = definingSection;
+        case SYM_IMPORT:
+        case SYM_LOCALIMPORT: {
+            SExportedSymbol* definition = findDefinition(symbol, section);
 
-                            return;
-                        }
-                    }
-                }
-            }
+            if (definition != NULL) {
+                if (!definition->symbol->resolved)
+                    resolveSymbol(definition->section, definition->symbol, allowImports);
 
-            if (!allowImports)
+                symbol->resolved = true;
+                symbol->value = definition->symbol->value;
+                symbol->section = definition->symbol->section;
+            } else if (symbol->type == SYM_LOCALIMPORT || !allowImports) {
                 error("Unresolved symbol \"%s\"", symbol->name);
-
-            break;
-        }
-
-        case SYM_LOCALIMPORT: {
-            for (SSection* definingSection = sect_Sections; definingSection != NULL; definingSection = definingSection->nextSection) {
-                if (definingSection->used && definingSection->fileId == section->fileId) {
-                    SSymbol* exportedSymbol = definingSection->symbols;
-
-                    for (uint32_t i = 0; i < definingSection->totalSymbols; ++i, ++exportedSymbol) {
-                        if ((exportedSymbol->type == SYM_LOCALEXPORT || exportedSymbol->type == SYM_EXPORT)
-                            && strcmp(exportedSymbol->name, symbol->name) == 0) {
-                            if (!exportedSymbol->resolved)
-                                resolveSymbol(definingSection, exportedSymbol, allowImports);
-
-                            symbol->resolved = true;
-                            symbol->value = exportedSymbol->value;
-                            symbol->section = definingSection;
-
-                            return;
-                        }
-                    }
-                }
             }
 
-            error("Unresolved symbol \"%s\"", symbol->name);
+            break;
         }
 
         default: {
@@ -114,6 +193,16 @@ resolveUnresolvedSymbols(SSection* section, intptr_t data) {
     }
 }
 
+// Resolves the symbols that can be resolved without error, imports without a definition are left alone
+static void
+resolveDefinedSymbols(SSection* section, intptr_t data) {
+    for (uint32_t i = 0; i < section->totalSymbols; ++i) {
+        SSymbol* symbol = &section->symbols[i];
+        if (!symbol->resolved && (!sym_IsImport(symbol) || findDefinition(symbol, section) != NULL))
+            resolveSymbol(section, symbol, true);
+    }
+}
+
 
 static void
 fillSectionArray(SSection** sectionArray) {
@@ -131,6 +220,7 @@ fillSectionList(SSection** sectionArray) {
     }
 
     sectionArray[sect_TotalSections() - 1]->nextSection = NULL;
+    g_lastSection = sectionArray[sect_TotalSections() - 1];
 }
 
 static int
@@ -148,17 +238,6 @@ compareSections(const void* element1, const void* element2) {
 }
 
 
-static SSymbol*
-sectionHasSymbol(SSection* section, const char* symbolName, ESymbolType symbolType) {
-    for (uint32_t i = 0; i < section->totalSymbols; ++i) {
-        SSymbol* symbol = &section->symbols[i];
-        if (symbol->type == symbolType && strcmp(symbol->name, symbolName) == 0)
-            return symbol;
-    }
-
-    return NULL;
-}
-
 static SSection*
 findSectionContainingAddress(int32_t value, uint32_t fileId) {
     for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
@@ -186,6 +265,22 @@ sect_GetSymbol(SSection* section, uint32_t symbolId, bool allowImports) {
     }
 }
 
+extern void
+sect_ResolveSymbol(SSection* section, SSymbol* symbol, bool allowImports) {
+    if (!symbol->resolved)
+        resolveSymbol(section, symbol, allowImports);
+}
+
+extern SSymbol*
+sect_FindDefinition(SSection* section, SSymbol* symbol, SSection** outSection) {
+    SExportedSymbol* definition = findDefinition(symbol, section);
+    if (definition == NULL)
+        return NULL;
+
+    *outSection = definition->section;
+    return definition->symbol;
+}
+
 extern char*
 sect_GetSymbolName(SSection* section, uint32_t symbolId) {
     SSymbol* symbol = &section->symbols[symbolId];
@@ -222,30 +317,45 @@ sect_ForEachUsedSection(void (* function)(SSection*, intptr_t), intptr_t data) {
 
 extern void
 sect_ResolveUnresolved(void) {
-    sect_ForEachUsedSection(resolveUnresolvedSymbols, 0);
+    for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
+        if (isLinked(section))
+            resolveUnresolvedSymbols(section, 0);
+    }
+}
+
+extern void
+sect_ResolveDefined(void) {
+    sect_ForEachUsedSection(resolveDefinedSymbols, 0);
 }
 
 extern SSection*
 sect_CreateNew(void) {
-    SSection** section = &sect_Sections;
-
-    while (*section != NULL)
-        section = &(*section)->nextSection;
+    SSection** section = g_lastSection != NULL ? &g_lastSection->nextSection : &sect_Sections;
 
     *section = (SSection*) mem_Alloc(sizeof(SSection));
     if (*section == NULL)
         error("Out of memory");
 
+    g_exportedSymbolsValid = false;
+
     (*section)->sectionId = g_sectionId++;
     (*section)->nextSection = NULL;
     (*section)->used = false;
     (*section)->assigned = false;
+    (*section)->mergeable = false;
+    (*section)->foldedInto = NULL;
     (*section)->patches = NULL;
 	(*section)->data = NULL;
 
+    g_lastSection = *section;
     return *section;
 }
 
+extern SSection*
+sect_LastSection(void) {
+    return g_lastSection;
+}
+
 extern uint32_t
 sect_TotalSections(void) {
     return g_sectionId;
@@ -260,6 +370,7 @@ sect_SortSections(void) {
     fillSectionList(sections);
 
     mem_Free(sections);
+    g_exportedSymbolsValid = false;
 }
 
 extern bool
@@ -269,41 +380,30 @@ sect_IsEquSection(SSection* section) {
 
 extern SSymbol*
 sect_FindExportedSymbol(const char* symbolName) {
-    for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
-        SSymbol* symbol = sectionHasSymbol(section, symbolName, SYM_EXPORT);
-        if (symbol != NULL) {
-			return symbol;
-        }
-    }
-    return NULL;
+    SExportedSymbol* entry = findExportedSymbol(symbolName, SYM_EXPORT, 0);
+    return entry != NULL ? entry->symbol : NULL;
 }
 
 extern SSection*
 sect_FindSectionWithExportedSymbol(const char* symbolName) {
-    for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
-        SSymbol* symbol = sectionHasSymbol(section, symbolName, SYM_EXPORT);
-        if (symbol != NULL) {
-            if (sect_IsEquSection(section)) {
-                return findSectionContainingAddress(symbol->value, section->fileId);
-            }
-            return section;
+    SExportedSymbol* entry = findExportedSymbol(symbolName, SYM_EXPORT, 0);
+    if (entry != NULL) {
+        if (sect_IsEquSection(entry->section)) {
+            return findSectionContainingAddress(entry->symbol->value, entry->section->fileId);
         }
+        return entry->section;
     }
     return NULL;
 }
 
 extern SSection*
 sect_FindSectionWithLocallyExportedSymbol(const char* symbolName, uint32_t fileId) {
-    for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
-        if (section->fileId == fileId) {
-            SSymbol* symbol = sectionHasSymbol(section, symbolName, SYM_LOCALEXPORT);
-            if (symbol != NULL) {
-                if (sect_IsEquSection(section)) {
-                    return findSectionContainingAddress(symbol->value, section->fileId);
-                }
-                return section;
-            }
+    SExportedSymbol* entry = findExportedSymbol(symbolName, SYM_LOCALEXPORT, fileId);
+    if (entry != NULL) {
+        if (sect_IsEquSection(entry->section)) {
+            return findSectionContainingAddress(entry->symbol->value, entry->section->fileId);
         }
+        return entry->section;
     }
     return sect_FindSectionWithExportedSymbol(symbolName);
 }
@@ -33,12 +33,6 @@ typedef struct FileInfo {
     uint32_t index;
 } SFileInfo;
 
-typedef struct LineMapping {
-    SFileInfo* fileInfo;
-	uint32_t lineNumber;
-	uint32_t offset;
-} SLineMapping;
-
 typedef struct Section {
     uint32_t fileId;
     uint32_t sectionId;
@@ -54,15 +48,13 @@ typedef struct Section {
     int32_t minimumWordSize;
     int32_t byteAlign;
 	bool root;
+	bool mergeable;
 
     char name[MAX_SYMBOL_NAME_LENGTH];
 
     uint32_t totalSymbols;
     SSymbol* symbols;
 
-    uint32_t totalLineMappings;
-    SLineMapping* lineMappings;
-
     uint32_t size;
     uint8_t* data;
 
@@ -71,6 +63,9 @@ typedef struct Section {
     bool used;
     bool assigned;
 
+    // A section folded into an identical one is not used, its symbols resolve to foldedInto instead
+    struct Section* foldedInto;
+
     struct Section* nextSection;
 } SSection;
 
@@ -80,9 +75,19 @@ sect_Sections;
 extern SSection*
 sect_CreateNew(void);
 
+extern SSection*
+sect_LastSection(void);
+
 extern SSymbol*
 sect_GetSymbol(SSection* section, uint32_t symbolId, bool allowImports);
 
+extern void
+sect_ResolveSymbol(SSection* section, SSymbol* symbol, bool allowImports);
+
+// Returns the definition an imported symbol binds to and its section, or NULL
+extern SSymbol*
+sect_FindDefinition(SSection* section, SSymbol* symbol, SSection** outSection);
+
 extern bool
 sect_GetConstantSymbolBank(SSection* section, uint32_t symbolId, int32_t* outValue);
 
@@ -113,6 +118,10 @@ sect_IsEquSection(SSection* section);
 extern void
 sect_ResolveUnresolved(void);
 
+// Resolves every symbol in the used sections that has a definition, reporting no errors
+extern void
+sect_ResolveDefined(void);
+
 extern int
 sect_StartAddressOfFirstCodeSection(void);
 
@@ -16,68 +16,74 @@
     along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include "file.h"
+#include <string.h>
 
+#include "checksum.h"
 #include "image.h"
 #include "xlink.h"
 
 static uint16_t
-sega_CalcMegaDriveChecksum(FILE* fileHandle, size_t length) {
-    uint16_t r = 0;
-    size_t c = (length - 0x200U) >> 1u;
-
-    fseek(fileHandle, 0x200, SEEK_SET);
-    while (c--)
-        r += fgetbw(fileHandle);
+sega_CalcMegaDriveChecksum(const SImage* image, uint32_t length) {
+    return length > 0x200 ? checksum_SumBigEndianWords(&image->data[0x200], length - 0x200) : 0;
+}
 
-    return r;
+static void
+sega_UpdateMegaDriveHeader(SImage* image) {
+    uint32_t length = image->size;
+
+    image_Extend(image, 0x1A8);
+    image->data[0x1A4] = (uint8_t) ((length - 1) >> 24u);
+    image->data[0x1A5] = (uint8_t) ((length - 1) >> 16u);
+    image->data[0x1A6] = (uint8_t) ((length - 1) >> 8u);
+    image->data[0x1A7] = (uint8_t) (length - 1);
+
+    uint16_t checksum = sega_CalcMegaDriveChecksum(image, length);
+    image->data[0x18E] = (uint8_t) (checksum >> 8u);
+    image->data[0x18F] = (uint8_t) checksum;
 }
 
 static void
-sega_UpdateMegaDriveHeader(FILE* fileHandle) {
-    fseek(fileHandle, 0, SEEK_END);
-    long length = ftell(fileHandle);
+sega_WriteImage(const char* outputFilename, SImage* image) {
+    FILE* fileHandle = fopen(outputFilename, "wb");
+    if (fileHandle == NULL)
+        error("Unable to open \"%s\" for writing", outputFilename);
 
-    fseek(fileHandle, 0x1A4, SEEK_SET);
-    fputbl(length - 1, fileHandle);
+    image_Write(image, fileHandle);
 
-    uint16_t checksum = sega_CalcMegaDriveChecksum(fileHandle, length);
-    fseek(fileHandle, 0x18E, SEEK_SET);
-    fputbw(checksum, fileHandle);
+    fclose(fileHandle);
 }
 
 void
 sega_WriteMegaDriveImage(const char* outputFilename) {
-    FILE* fileHandle = fopen(outputFilename, "w+b");
-    if (fileHandle == NULL)
-        error("Unable to open \"%s\" for writing", outputFilename);
+    SImage image;
+    image_Compose(&image, 0, 0);
 
-    image_WriteBinaryToFile(fileHandle, 0);
+    sega_UpdateMegaDriveHeader(&image);
 
-    sega_UpdateMegaDriveHeader(fileHandle);
-
-    fclose(fileHandle);
+    sega_WriteImage(outputFilename, &image);
+    image_Free(&image);
 }
 
 static uint16_t
-sega_CalcMasterSystemCheckSumPart(FILE* fileHandle, int count, uint16_t checkSumIn) {
-    while (count--) {
-        checkSumIn += (uint16_t) fgetc(fileHandle);
-    }
+sega_CalcMasterSystemCheckSumPart(const SImage* image, uint32_t start, uint32_t end, uint16_t checkSumIn) {
+    uint32_t imageEnd = end < image->size ? end : image->size;
+
+    if (start < imageEnd)
+        checkSumIn += (uint16_t) checksum_SumBytes(&image->data[start], imageEnd - start);
+
+    // Bytes beyond the end of the image count as EOF
+    if (end > imageEnd)
+        checkSumIn += (uint16_t) ((end - (start > imageEnd ? start : imageEnd)) * (uint16_t) EOF);
+
     return checkSumIn;
 }
 
 static uint16_t
-sega_CalcMasterSystemCheckSum(FILE* fileHandle, int fileSize, int headerLocation) {
+sega_CalcMasterSystemCheckSum(const SImage* image, uint32_t headerLocation) {
     uint16_t checkSum = 0;
 
-    fseek(fileHandle, 0, SEEK_SET);
-    checkSum = sega_CalcMasterSystemCheckSumPart(fileHandle, headerLocation, checkSum);
-    fseek(fileHandle, 16, SEEK_CUR);
-    fileSize -= headerLocation + 16;
-
-    if (fileSize > 0)
-        checkSum = sega_CalcMasterSystemCheckSumPart(fileHandle, fileSize, checkSum);
+    checkSum = sega_CalcMasterSystemCheckSumPart(image, 0, headerLocation, checkSum);
+    checkSum = sega_CalcMasterSystemCheckSumPart(image, headerLocation + 16, image->size, checkSum);
 
     return checkSum;
 }
@@ -121,36 +127,27 @@ sega_CalcSizeCode(uint8_t code, size_t fileSize) {
 }
 
 void
-sega_UpdateMasterSystemHeader(FILE* fileHandle, int headerLocation) {
-    uint16_t checkSum;
-    int fileSize;
-    uint8_t code;
-
-    fseek(fileHandle, 0, SEEK_END);
-    fileSize = ftell(fileHandle);
-
-    checkSum = sega_CalcMasterSystemCheckSum(fileHandle, fileSize, headerLocation);
-
-    fseek(fileHandle, headerLocation, SEEK_SET);
-    fwrite("TMR SEGA  ", 1, 10, fileHandle);
-    fputlw(checkSum, fileHandle);
-    fseek(fileHandle, 3, SEEK_CUR);
-    code = fgetc(fileHandle);
-    fseek(fileHandle, -1, SEEK_CUR);
-    fputc(sega_CalcSizeCode(code, fileSize), fileHandle);
+sega_UpdateMasterSystemHeader(SImage* image, int headerLocation) {
+    uint32_t fileSize = image->size;
+    uint16_t checkSum = sega_CalcMasterSystemCheckSum(image, headerLocation);
+    uint8_t code = headerLocation + 15 < (int) fileSize ? image->data[headerLocation + 15] : 0xFF;
+
+    image_Extend(image, headerLocation + 16);
+    memcpy(&image->data[headerLocation], "TMR SEGA  ", 10);
+    image->data[headerLocation + 10] = (uint8_t) checkSum;
+    image->data[headerLocation + 11] = (uint8_t) (checkSum >> 8u);
+    image->data[headerLocation + 15] = sega_CalcSizeCode(code, fileSize);
 }
 
 void
 sega_WriteMasterSystemImage(const char* outputFilename, int binaryPad) {
     int headerLocation = (binaryPad == 0) || (binaryPad >= 0x8000) ? 0x8000 : binaryPad;
 
-    FILE* fileHandle = fopen(outputFilename, "w+b");
-    if (fileHandle == NULL)
-        error("Unable to open \"%s\" for writing", outputFilename);
+    SImage image;
+    image_Compose(&image, 0, binaryPad);
 
-    image_WriteBinaryToFile(fileHandle, binaryPad);
+    sega_UpdateMasterSystemHeader(&image, headerLocation - 16);
 
-    sega_UpdateMasterSystemHeader(fileHandle, headerLocation - 16);
-
-    fclose(fileHandle);
+    sega_WriteImage(outputFilename, &image);
+    image_Free(&image);
 }
@@ -16,63 +16,214 @@
     along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <stdio.h>
+
+#include "mem.h"
+
 #include "section.h"
+#include "smart.h"
 #include "xlink.h"
 
-static void
-useSectionWithGlobalExport(const char* name);
+typedef struct {
+    SSection* section;      // NULL if the symbol isn't exported by any section
+    const char* symbolName;
+} SReference;
 
-static void
-useSectionWithLocalExport(const char* name, uint32_t fileId);
+typedef struct {
+    uint32_t totalReferences;
+    SReference* references;
+} SSectionNode;
+
+// Why a section was kept, for the map file and link report
+typedef struct {
+    EKeptReason reason;
+    SSection* keptBy;
+    const char* keptThrough;
+} SKeptSection;
+
+static SSectionNode* g_nodes = NULL;
+static SReference* g_references = NULL;
+static SKeptSection* g_keptSections = NULL;
+
+static SSection** g_worklist = NULL;
+static uint32_t g_worklistSize = 0;
+
+static uint32_t
+countImports(SSection* section) {
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < section->totalSymbols; ++i) {
+        if (sym_IsImport(&section->symbols[i]))
+            ++total;
+    }
+    return total;
+}
+
+static SReference*
+addReferences(SSection* section, SReference* reference) {
+    SSectionNode* node = &g_nodes[section->sectionId];
+    node->references = reference;
 
-static void
-markReferencedSectionsUsed(SSection* section) {
-    section->used = true;
     for (uint32_t i = 0; i < section->totalSymbols; ++i) {
         SSymbol* symbol = &section->symbols[i];
-        if (symbol->type == SYM_LOCALIMPORT)
-            useSectionWithLocalExport(symbol->name, section->fileId);
-        else if (symbol->type == SYM_IMPORT)
-            useSectionWithGlobalExport(symbol->name);
+        SSection* target;
+
+        if (symbol->type == SYM_LOCALIMPORT) {
+            if ((target = sect_FindSectionWithLocallyExportedSymbol(symbol->name, section->fileId)) == NULL)
+                continue;
+        } else if (symbol->type == SYM_IMPORT) {
+            // An exported constant isn't contained in any section and doesn't reference one
+            if ((target = sect_FindSectionWithExportedSymbol(symbol->name)) == NULL && sect_FindExportedSymbol(symbol->name) != NULL)
+                continue;
+        } else {
+            continue;
+        }
+
+        reference->section = target;
+        reference->symbolName = symbol->name;
+        ++reference;
     }
+
+    node->totalReferences = (uint32_t) (reference - node->references);
+    return reference;
 }
 
 static void
-useSectionWithGlobalExport(const char* name) {
-    SSection* section = sect_FindSectionWithExportedSymbol(name);
-    if (section != NULL) {
-		if (!section->used)
-	        markReferencedSectionsUsed(section);
-    } else {
-        error("Symbol \"%s\" not found (it must be exported)", name);
+buildReferenceGraph(void) {
+    uint32_t totalImports = 0;
+    for (SSection* section = sect_Sections; section != NULL; section = section->nextSection)
+        totalImports += countImports(section);
+
+    g_nodes = mem_Alloc(sizeof(SSectionNode) * (sect_TotalSections() + 1));
+    g_keptSections = mem_Alloc(sizeof(SKeptSection) * (sect_TotalSections() + 1));
+    g_references = mem_Alloc(sizeof(SReference) * (totalImports + 1));
+    g_worklist = mem_Alloc(sizeof(SSection*) * (sect_TotalSections() + 1));
+    g_worklistSize = 0;
+
+    SReference* reference = g_references;
+    for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
+        SKeptSection* kept = &g_keptSections[section->sectionId];
+        kept->reason = KEPT_NONE;
+        kept->keptBy = NULL;
+        kept->keptThrough = NULL;
+
+        reference = addReferences(section, reference);
+    }
+}
+
+static void
+useSection(SSection* section, EKeptReason reason, SSection* keptBy, const char* keptThrough) {
+    if (!section->used) {
+        SKeptSection* kept = &g_keptSections[section->sectionId];
+
+        section->used = true;
+        kept->reason = reason;
+        kept->keptBy = keptBy;
+        kept->keptThrough = keptThrough;
+
+        g_worklist[g_worklistSize++] = section;
     }
 }
 
 static void
-useSectionWithLocalExport(const char* name, uint32_t fileId) {
-    SSection* section = sect_FindSectionWithLocallyExportedSymbol(name, fileId);
-    if (section != NULL && !section->used) {
-        markReferencedSectionsUsed(section);
+useReferencedSections(void) {
+    while (g_worklistSize > 0) {
+        SSection* section = g_worklist[--g_worklistSize];
+        SSectionNode* node = &g_nodes[section->sectionId];
+
+        for (uint32_t i = 0; i < node->totalReferences; ++i) {
+            SReference* reference = &node->references[i];
+            if (reference->section == NULL)
+                error("Symbol \"%s\" not found (it must be exported)", reference->symbolName);
+
+            useSection(reference->section, KEPT_REFERENCED, section, reference->symbolName);
+        }
     }
 }
 
+static void
+useEntrySection(const char* name) {
+    SSection* section = sect_FindSectionWithExportedSymbol(name);
+    if (section == NULL)
+        error("Symbol \"%s\" not found (it must be exported)", name);
+
+    useSection(section, KEPT_ENTRY, NULL, name);
+    useReferencedSections();
+}
 
 static void
 useRootedSections(void) {
 	for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
 		if (section->root) {
-			markReferencedSectionsUsed(section);
+			useSection(section, KEPT_ROOT, NULL, NULL);
+			useReferencedSections();
 		}
 	}
 }
 
+static void
+freeReferenceGraph(void) {
+    mem_Free(g_worklist);
+    mem_Free(g_references);
+    mem_Free(g_nodes);
+
+    g_worklist = NULL;
+    g_references = NULL;
+    g_nodes = NULL;
+}
+
+static void
+writeKeptReason(FILE* fileHandle, SSection* section) {
+    SKeptSection* kept = &g_keptSections[section->sectionId];
+
+    fprintf(fileHandle, "    %s \"%s\", %u bytes: ", group_Name(section->group), section->name, section->size);
+
+    switch (kept->reason) {
+        case KEPT_ENTRY:
+            fprintf(fileHandle, "contains entry symbol \"%s\"\n", kept->keptThrough);
+            break;
+        case KEPT_ROOT:
+            fprintf(fileHandle, "ROOT section\n");
+            break;
+        case KEPT_REFERENCED:
+            fprintf(fileHandle, "\"%s\" referenced by \"%s\"\n", kept->keptThrough, kept->keptBy->name);
+            break;
+        case KEPT_NONE:
+            fprintf(fileHandle, "unknown\n");
+            break;
+    }
+}
+
 /* Exported functions */
 
+extern bool
+smart_Enabled(void) {
+    return g_keptSections != NULL;
+}
+
+extern EKeptReason
+smart_KeptReason(const SSection* section, const char** outThrough, const SSection** outBy) {
+    *outThrough = NULL;
+    *outBy = NULL;
+
+    if (g_keptSections == NULL || !section->used)
+        return KEPT_NONE;
+
+    SKeptSection* kept = &g_keptSections[section->sectionId];
+    if (kept->reason == KEPT_ENTRY || kept->reason == KEPT_REFERENCED)
+        *outThrough = kept->keptThrough;
+    if (kept->reason == KEPT_REFERENCED)
+        *outBy = kept->keptBy;
+
+    return kept->reason;
+}
+
 extern void
 smart_Process(const char* name) {
     if (name != NULL) {
-        useSectionWithGlobalExport(name);
+        buildReferenceGraph();
+        useEntrySection(name);
         useRootedSections();
+        freeReferenceGraph();
     } else {
         // Link in all sections
         SSection* section = sect_Sections;
@@ -83,3 +234,60 @@ smart_Process(const char* name) {
         }
     }
 }
+
+static void
+writeFoldedSections(FILE* fileHandle, uint32_t totalFolded, uint32_t foldedBytes) {
+    if (totalFolded == 0)
+        return;
+
+    fprintf(fileHandle, "\nFolded %u sections (%u bytes) into identical sections:\n", totalFolded, foldedBytes);
+    for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
+        if (section->foldedInto != NULL)
+            fprintf(fileHandle, "    %s \"%s\", %u bytes, into \"%s\"\n", group_Name(section->group), section->name, section->size, section->foldedInto->name);
+    }
+}
+
+extern void
+smart_WriteReport(FILE* fileHandle) {
+    uint32_t totalKept = 0, keptBytes = 0;
+    uint32_t totalStripped = 0, strippedBytes = 0;
+    uint32_t totalFolded = 0, foldedBytes = 0;
+
+    for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
+        if (!sect_IsEquSection(section)) {
+            if (section->foldedInto != NULL) {
+                ++totalFolded;
+                foldedBytes += section->size;
+            } else if (section->used) {
+                ++totalKept;
+                keptBytes += section->size;
+            } else {
+                ++totalStripped;
+                strippedBytes += section->size;
+            }
+        }
+    }
+
+    if (g_keptSections == NULL) {
+        fprintf(fileHandle, "Smart linking not enabled, kept all %u sections (%u bytes)\n", totalKept, keptBytes);
+        writeFoldedSections(fileHandle, totalFolded, foldedBytes);
+        return;
+    }
+
+    fprintf(fileHandle, "Kept %u sections (%u bytes), stripped %u sections (%u bytes)\n",
+            totalKept, keptBytes, totalStripped, strippedBytes);
+
+    fprintf(fileHandle, "\nKept sections:\n");
+    for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
+        if (section->used && !sect_IsEquSection(section))
+            writeKeptReason(fileHandle, section);
+    }
+
+    fprintf(fileHandle, "\nStripped sections:\n");
+    for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
+        if (!section->used && section->foldedInto == NULL && !sect_IsEquSection(section))
+            fprintf(fileHandle, "    %s \"%s\", %u bytes\n", group_Name(section->group), section->name, section->size);
+    }
+
+    writeFoldedSections(fileHandle, totalFolded, foldedBytes);
+}
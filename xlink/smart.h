@@ -19,8 +19,34 @@
 #ifndef XLINK_SMART_H_INCLUDED_
 #define XLINK_SMART_H_INCLUDED_
 
+#include <stdio.h>
+
+#include "types.h"
+
+struct Section;
+
+typedef enum {
+    KEPT_NONE,
+    KEPT_ENTRY,
+    KEPT_ROOT,
+    KEPT_REFERENCED
+} EKeptReason;
+
 extern void
 smart_Process(const char* name);
 
+extern void
+smart_WriteReport(FILE* fileHandle);
+
+// Returns true if unused sections were stripped
+extern bool
+smart_Enabled(void);
+
+/* Returns why a section was kept. For KEPT_ENTRY outThrough is the entry symbol, for
+ * KEPT_REFERENCED it is the symbol that was referenced by section outBy.
+ */
+extern EKeptReason
+smart_KeptReason(const struct Section* section, const char** outThrough, const struct Section** outBy);
+
 #endif
 
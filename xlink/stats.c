@@ -0,0 +1,184 @@
+/*  Copyright 2008-2022 Carsten Elton Sorensen and contributors
+
+    This file is part of ASMotor.
+
+    ASMotor is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ASMotor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Link statistics for option -v. Phases are timed with a monotonic wall clock and are consecutive,
+ * starting a phase ends the previous one. Counts of sections, symbols and patches are taken from
+ * the section list when the statistics are written.
+ */
+
+#include "file.h"
+
+#include "merge.h"
+#include "section.h"
+#include "stats.h"
+#include "timing.h"
+#include "xlink.h"
+
+#define MAX_PHASES 32
+
+typedef struct {
+    const char* name;
+    double start;
+    double end;
+} SPhase;
+
+static bool g_enabled = false;
+static const char* g_traceFilename = NULL;
+
+static double g_startTime;
+static SPhase g_phases[MAX_PHASES];
+static uint32_t g_totalPhases = 0;
+static bool g_inPhase = false;
+
+static uint64_t g_statistics[STAT_TOTAL];
+
+static void
+endPhase(void) {
+    if (g_inPhase) {
+        g_phases[g_totalPhases - 1].end = timing_Now();
+        g_inPhase = false;
+    }
+}
+
+typedef struct {
+    uint32_t totalSections;
+    uint32_t usedSections;
+    uint32_t totalSymbols;
+    uint32_t totalPatches;
+} SCounts;
+
+static void
+countSections(SCounts* counts) {
+    counts->totalSections = 0;
+    counts->usedSections = 0;
+    counts->totalSymbols = 0;
+    counts->totalPatches = 0;
+
+    for (SSection* section = sect_Sections; section != NULL; section = section->nextSection) {
+        ++counts->totalSections;
+        counts->totalSymbols += section->totalSymbols;
+        if (section->used) {
+            ++counts->usedSections;
+            if (section->patches != NULL)
+                counts->totalPatches += section->patches->totalPatches;
+        }
+    }
+}
+
+static void
+writeTrace(const char* name, const SCounts* counts, double total) {
+    FILE* fileHandle = fopen(name, "wt");
+    if (fileHandle == NULL)
+        error("Unable to open file \"%s\" for writing", name);
+
+    fprintf(fileHandle, "{\"traceEvents\":[\n");
+    for (uint32_t i = 0; i < g_totalPhases; ++i) {
+        SPhase* phase = &g_phases[i];
+        fprintf(fileHandle, "{\"name\":\"%s\",\"cat\":\"xlink\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1},\n",
+                phase->name, phase->start - g_startTime, phase->end - phase->start);
+    }
+    fprintf(fileHandle, "{\"name\":\"link\",\"cat\":\"xlink\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{"
+                        "\"modules\":%llu,\"sections\":%u,\"usedSections\":%u,\"symbols\":%u,\"patches\":%u,"
+                        "\"bytesRead\":%llu,\"bytesWritten\":%llu,\"mergedBytes\":%u,\"peakMemoryKiB\":%llu}},\n",
+            total, (unsigned long long) g_statistics[STAT_MODULES], counts->totalSections, counts->usedSections,
+            counts->totalSymbols, counts->totalPatches, (unsigned long long) g_statistics[STAT_BYTES_READ],
+            (unsigned long long) g_statistics[STAT_BYTES_WRITTEN], merge_BytesSaved(), (unsigned long long) timing_PeakMemory());
+    fprintf(fileHandle, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"xlink\"}}\n");
+    fprintf(fileHandle, "],\"displayTimeUnit\":\"ms\"}\n");
+
+    fclose(fileHandle);
+}
+
+
+/* Exported functions */
+
+extern void
+stats_Enable(const char* traceFilename) {
+    g_enabled = true;
+    g_traceFilename = traceFilename;
+    g_startTime = timing_Now();
+}
+
+extern void
+stats_Phase(const char* name) {
+    if (!g_enabled)
+        return;
+
+    endPhase();
+
+    if (g_totalPhases == MAX_PHASES)
+        return;
+
+    SPhase* phase = &g_phases[g_totalPhases++];
+    phase->name = name;
+    phase->start = timing_Now();
+    phase->end = phase->start;
+    g_inPhase = true;
+}
+
+extern void
+stats_Add(EStatistic statistic, uint64_t value) {
+    g_statistics[statistic] += value;
+}
+
+extern void
+stats_AddOutputFile(const char* name) {
+    if (!g_enabled)
+        return;
+
+    FILE* fileHandle = fopen(name, "rb");
+    if (fileHandle != NULL) {
+        stats_Add(STAT_BYTES_WRITTEN, fsize(fileHandle));
+        fclose(fileHandle);
+    }
+}
+
+extern void
+stats_Write(FILE* fileHandle) {
+    if (!g_enabled)
+        return;
+
+    endPhase();
+
+    double total = timing_Now() - g_startTime;
+
+    SCounts counts;
+    countSections(&counts);
+
+    fprintf(fileHandle, "Link phases:\n");
+    for (uint32_t i = 0; i < g_totalPhases; ++i) {
+        SPhase* phase = &g_phases[i];
+        fprintf(fileHandle, "    %-20s %10.3f ms\n", phase->name, (phase->end - phase->start) / 1000.0);
+    }
+    fprintf(fileHandle, "    %-20s %10.3f ms\n", "total", total / 1000.0);
+
+    fprintf(fileHandle, "%u modules, %u sections (%u used), %u symbols, %u patches\n",
+            (uint32_t) g_statistics[STAT_MODULES], counts.totalSections, counts.usedSections, counts.totalSymbols, counts.totalPatches);
+    fprintf(fileHandle, "%llu bytes read, %llu bytes written\n",
+            (unsigned long long) g_statistics[STAT_BYTES_READ], (unsigned long long) g_statistics[STAT_BYTES_WRITTEN]);
+    if (merge_TotalFolded() != 0)
+        fprintf(fileHandle, "%u sections folded into identical sections, %u bytes saved\n", merge_TotalFolded(), merge_BytesSaved());
+
+    uint64_t peak = timing_PeakMemory();
+    if (peak != 0)
+        fprintf(fileHandle, "Peak memory %llu KiB\n", (unsigned long long) peak);
+
+    if (g_traceFilename != NULL)
+        writeTrace(g_traceFilename, &counts, total);
+}
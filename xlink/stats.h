@@ -0,0 +1,52 @@
+/*  Copyright 2008-2022 Carsten Elton Sorensen and contributors
+
+    This file is part of ASMotor.
+
+    ASMotor is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ASMotor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef XLINK_STATS_H_INCLUDED_
+#define XLINK_STATS_H_INCLUDED_
+
+#include <stdio.h>
+
+#include "types.h"
+
+typedef enum {
+    STAT_MODULES,
+    STAT_BYTES_READ,
+    STAT_BYTES_WRITTEN,
+    STAT_TOTAL
+} EStatistic;
+
+// Enables statistics, and a Chrome trace event file if traceFilename isn't NULL
+extern void
+stats_Enable(const char* traceFilename);
+
+// Ends the current phase, if any, and starts timing a new one
+extern void
+stats_Phase(const char* name);
+
+extern void
+stats_Add(EStatistic statistic, uint64_t value);
+
+// Adds the size of a file that was written to the bytes written
+extern void
+stats_AddOutputFile(const char* name);
+
+// Ends the current phase and writes the statistics, and the trace file if requested
+extern void
+stats_Write(FILE* fileHandle);
+
+#endif
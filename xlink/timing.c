@@ -0,0 +1,70 @@
+/*  Copyright 2008-2022 Carsten Elton Sorensen and contributors
+
+    This file is part of ASMotor.
+
+    ASMotor is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ASMotor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ASMotor.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Wall clock time and peak memory use for xlink's statistics and xasm's profile, which is built
+ * from this file too. A monotonic clock and getrusage are used where the build found them.
+ */
+
+#include <time.h>
+
+#if defined(_WIN32)
+#   include <windows.h>
+#   include <psapi.h>
+#elif defined(HAVE_GETRUSAGE)
+#   include <sys/resource.h>
+#endif
+
+#include "timing.h"
+
+extern double
+timing_Now(void) {
+#if defined(_WIN32)
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double) counter.QuadPart * 1000000.0 / (double) frequency.QuadPart;
+#elif defined(HAVE_CLOCK_MONOTONIC)
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double) time.tv_sec * 1000000.0 + (double) time.tv_nsec / 1000.0;
+#else
+    return (double) clock() * 1000000.0 / CLOCKS_PER_SEC;
+#endif
+}
+
+extern uint64_t
+timing_PeakMemory(void) {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize / 1024;
+    return 0;
+#elif defined(HAVE_GETRUSAGE)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#   if defined(__APPLE__)
+    return (uint64_t) usage.ru_maxrss / 1024;
+#   else
+    return (uint64_t) usage.ru_maxrss;
+#   endif
+#else
+    return 0;
+#endif
+}